@@ -0,0 +1,462 @@
+#include <njones/a2m/async_converter.h>
+#include <njones/a2m/converter.h>
+#include <njones/a2m/converter_pool.h>
+#include <njones/a2m/fixed_converter.h>
+#include <njones/a2m/multi_channel_converter.h>
+#include <njones/lib/ring_buffer.h>
+#include <algorithm>
+#include <memory>
+#include <span>
+#include <thread>
+#include <vector>
+#include "signals.h"
+#include "suites.h"
+
+namespace {
+const unsigned int samplerates[] = {44100, 48000, 96000, 192000};
+const unsigned int block_sizes[] = {256, 512, 1024, 2048, 4096, 8192, 16384};
+// Converters cycle through this many distinct blocks so every call sees fresh input.
+const size_t nblocks = 16;
+
+void bench_convert(njones::bench::Harness& harness,
+                   const unsigned int samplerate,
+                   const unsigned int block_size,
+                   const njones::bench::Signal signal,
+                   const std::vector<unsigned int>& pitch_set,
+                   const unsigned int note_count) {
+    auto samples = njones::bench::generate_signal<double>(signal, samplerate, block_size * nblocks);
+    auto converter = njones::audio::a2m::Converter(samplerate, block_size, 0.0, pitch_set, {0, 127}, note_count);
+    std::array<njones::audio::a2m::Note, 128> notes;
+
+    size_t block = 0;
+    harness.run("convert",
+                {{"samplerate", std::to_string(samplerate)},
+                 {"block_size", std::to_string(block_size)},
+                 {"signal", njones::bench::signal_name(signal)},
+                 {"pitch_set", std::to_string(pitch_set.size())},
+                 {"note_count", std::to_string(note_count)}},
+                block_size, samplerate, [&]() {
+                    converter.convert(samples.data() + block * block_size, notes);
+                    block = (block + 1) % nblocks;
+                });
+}
+
+/**
+ * Feeds the same host float buffer through RingBuffer<float, double> into a Converter and through
+ * RingBuffer<float, float> into a FloatConverter; how often both agree is reported as a parameter.
+ */
+void bench_precision(njones::bench::Harness& harness, const unsigned int samplerate, const unsigned int block_size) {
+    if (!harness.enabled("precision"))
+        return;
+
+    auto input = njones::bench::generate_signal<float>(njones::bench::Signal::Chord, samplerate, block_size * nblocks);
+    float* channels[] = {input.data()};
+
+    auto double_converter = njones::audio::a2m::Converter(samplerate, block_size, 0.1);
+    auto float_converter = njones::audio::a2m::FloatConverter(samplerate, block_size, 0.1);
+    std::array<njones::audio::a2m::Note, 128> double_notes;
+    std::array<njones::audio::a2m::Note, 128> float_notes;
+    size_t double_count = 0;
+    size_t float_count = 0;
+
+    auto double_buffer = njones::audio::RingBuffer<float, double>(
+        [&](const int, double* samples, const int) { double_count = double_converter.convert(samples, double_notes); },
+        1, block_size);
+    auto float_buffer = njones::audio::RingBuffer<float, float>(
+        [&](const int, float* samples, const int) { float_count = float_converter.convert(samples, float_notes); }, 1,
+        block_size);
+
+    size_t matching = 0;
+    for (size_t i = 0; i < nblocks; ++i) {
+        float* block[] = {input.data() + i * block_size};
+        double_buffer.add(block, block_size);
+        float_buffer.add(block, block_size);
+        matching += std::equal(double_notes.begin(), double_notes.begin() + double_count, float_notes.begin(),
+                               float_notes.begin() + float_count, [](const auto& a, const auto& b) {
+                                   return a.pitch == b.pitch && a.velocity == b.velocity;
+                               });
+    }
+
+    const auto parameters = njones::bench::Parameters{{"samplerate", std::to_string(samplerate)},
+                                                      {"block_size", std::to_string(block_size)},
+                                                      {"matching_blocks", std::to_string(matching)},
+                                                      {"blocks", std::to_string(nblocks)}};
+    harness.run("precision/double", parameters, input.size(), samplerate,
+                [&]() { double_buffer.add(channels, input.size()); });
+    harness.run("precision/float", parameters, input.size(), samplerate,
+                [&]() { float_buffer.add(channels, input.size()); });
+}
+
+/**
+ * Converts the same multi-channel signal with one MultiChannelConverter and with one Converter per channel.
+ */
+void bench_multi_channel(njones::bench::Harness& harness,
+                         const unsigned int samplerate,
+                         const unsigned int block_size,
+                         const unsigned int nchannels) {
+    if (!harness.enabled("multi_channel"))
+        return;
+
+    auto samples = njones::bench::generate_signal<double>(njones::bench::Signal::Chord, samplerate, block_size);
+    auto channels = std::vector<double*>(nchannels, samples.data());
+
+    auto converters = std::vector<std::unique_ptr<njones::audio::a2m::Converter>>();
+    for (unsigned int channel = 0; channel < nchannels; ++channel)
+        converters.push_back(std::make_unique<njones::audio::a2m::Converter>(samplerate, block_size));
+    auto multi_converter = njones::audio::a2m::MultiChannelConverter(nchannels, samplerate, block_size);
+
+    auto notes = std::vector<njones::audio::a2m::Note>(128 * nchannels);
+    auto counts = std::vector<size_t>(nchannels);
+
+    const auto parameters = njones::bench::Parameters{{"samplerate", std::to_string(samplerate)},
+                                                      {"block_size", std::to_string(block_size)},
+                                                      {"channels", std::to_string(nchannels)}};
+    harness.run("multi_channel/independent", parameters, block_size, samplerate, [&]() {
+        for (unsigned int channel = 0; channel < nchannels; ++channel)
+            converters[channel]->convert(channels[channel], std::span(notes).subspan(channel * 128, 128));
+    });
+    harness.run("multi_channel/batched", parameters, block_size, samplerate,
+                [&]() { multi_converter.convert(channels.data(), notes, counts); });
+}
+
+/**
+ * Converts many streams on a ConverterPool, from one thread up to one per core. The real-time factor
+ * is the aggregate over all streams.
+ */
+void bench_pool(njones::bench::Harness& harness,
+                const unsigned int samplerate,
+                const unsigned int block_size,
+                const unsigned int nstreams) {
+    if (!harness.enabled("pool"))
+        return;
+
+    auto samples = njones::bench::generate_signal<double>(njones::bench::Signal::Chord, samplerate, block_size);
+
+    const unsigned int max_threads = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned int nthreads = 1; nthreads <= max_threads; nthreads *= 2) {
+        auto pool = njones::audio::a2m::ConverterPool(nthreads);
+        auto ids = std::vector<njones::audio::a2m::ConverterPool::StreamId>();
+        for (unsigned int stream = 0; stream < nstreams; ++stream)
+            ids.push_back(pool.add_stream([](const size_t, std::span<const njones::audio::a2m::Note>) {}, samplerate,
+                                          block_size));
+
+        harness.run("pool",
+                    {{"samplerate", std::to_string(samplerate)},
+                     {"block_size", std::to_string(block_size)},
+                     {"streams", std::to_string(nstreams)},
+                     {"threads", std::to_string(nthreads)}},
+                    static_cast<size_t>(block_size) * nblocks * nstreams, samplerate, [&]() {
+                        for (size_t i = 0; i < nblocks; ++i)
+                            for (auto id : ids)
+                                pool.submit(id, samples.data(), samples.size());
+                        pool.wait();
+                    });
+    }
+}
+
+/**
+ * Resolves the same lowest octave two ways, producing a note frame every hop_size samples: with octave
+ * levels over hop_size blocks, and with a single FFT as long as the last level hopping by hop_size.
+ */
+void bench_octave_levels(njones::bench::Harness& harness,
+                         const unsigned int samplerate,
+                         const unsigned int hop_size,
+                         const unsigned int levels) {
+    if (!harness.enabled("octave_levels"))
+        return;
+
+    const unsigned int long_block_size = hop_size << (levels - 1);
+    auto samples = njones::bench::generate_signal<double>(njones::bench::Signal::Chord, samplerate, hop_size * nblocks);
+    auto cascade = njones::audio::a2m::Converter(samplerate, hop_size);
+    cascade.set_octave_levels(levels);
+    auto single = njones::audio::a2m::Converter(samplerate, long_block_size);
+    single.set_hop_size(hop_size);
+    std::array<njones::audio::a2m::Note, 128> notes;
+
+    const auto parameters = njones::bench::Parameters{{"samplerate", std::to_string(samplerate)},
+                                                      {"hop_size", std::to_string(hop_size)},
+                                                      {"levels", std::to_string(levels)},
+                                                      {"long_block_size", std::to_string(long_block_size)}};
+    size_t block = 0;
+    harness.run("octave_levels/cascade", parameters, hop_size, samplerate, [&]() {
+        cascade.convert(samples.data() + block * hop_size, notes);
+        block = (block + 1) % nblocks;
+    });
+    harness.run("octave_levels/single", parameters, hop_size, samplerate, [&]() {
+        single.convert(samples.data() + block * hop_size, notes);
+        block = (block + 1) % nblocks;
+    });
+}
+
+/**
+ * Places notes as accurately two ways: peak refinement over blocks of block_size / 4, and bin centres over
+ * blocks of block_size.
+ */
+void bench_refinement(njones::bench::Harness& harness, const unsigned int samplerate, const unsigned int block_size) {
+    if (!harness.enabled("refinement"))
+        return;
+
+    const unsigned int short_block_size = block_size / 4;
+    auto samples =
+        njones::bench::generate_signal<double>(njones::bench::Signal::Chord, samplerate, block_size * nblocks);
+    auto peaks = njones::audio::a2m::Converter(samplerate, short_block_size, 0.1);
+    peaks.set_refinement(njones::audio::a2m::Refinement::Peaks);
+    auto bins = njones::audio::a2m::Converter(samplerate, block_size, 0.1);
+    std::array<njones::audio::a2m::Note, 128> notes;
+
+    const auto parameters = njones::bench::Parameters{{"samplerate", std::to_string(samplerate)},
+                                                      {"block_size", std::to_string(block_size)},
+                                                      {"short_block_size", std::to_string(short_block_size)}};
+    size_t block = 0;
+    harness.run("refinement/peaks", parameters, short_block_size, samplerate, [&]() {
+        peaks.convert(samples.data() + block * short_block_size, notes);
+        block = (block + 1) % (nblocks * 4);
+    });
+    block = 0;
+    harness.run("refinement/bins", parameters, block_size, samplerate, [&]() {
+        bins.convert(samples.data() + block * block_size, notes);
+        block = (block + 1) % nblocks;
+    });
+}
+
+/**
+ * Converts silence and a held chord with and without the gates, hopping by hop_size.
+ */
+void bench_gate(njones::bench::Harness& harness,
+                const unsigned int samplerate,
+                const unsigned int block_size,
+                const unsigned int hop_size) {
+    if (!harness.enabled("gate"))
+        return;
+
+    std::array<njones::audio::a2m::Note, 128> notes;
+    for (const auto signal : {njones::bench::Signal::Silence, njones::bench::Signal::Chord}) {
+        auto samples = njones::bench::generate_signal<double>(signal, samplerate, hop_size * nblocks);
+        auto plain = njones::audio::a2m::Converter(samplerate, block_size, 0.1);
+        auto gated = njones::audio::a2m::Converter(samplerate, block_size, 0.1);
+        for (auto converter : {&plain, &gated})
+            converter->set_hop_size(hop_size);
+        gated.set_silence_gate(true);
+        gated.set_stationarity(0.05, 8);
+
+        const auto parameters = njones::bench::Parameters{{"samplerate", std::to_string(samplerate)},
+                                                          {"block_size", std::to_string(block_size)},
+                                                          {"hop_size", std::to_string(hop_size)},
+                                                          {"signal", njones::bench::signal_name(signal)}};
+        size_t block = 0;
+        harness.run("gate/off", parameters, hop_size, samplerate, [&]() {
+            plain.convert(samples.data() + block * hop_size, notes);
+            block = (block + 1) % nblocks;
+        });
+        harness.run("gate/on", parameters, hop_size, samplerate, [&]() {
+            gated.convert(samples.data() + block * hop_size, notes);
+            block = (block + 1) % nblocks;
+        });
+    }
+}
+
+/**
+ * Converts with a narrow pitch range through the FFT and through the Goertzel bank, hopping by hop_size.
+ */
+void bench_detector(njones::bench::Harness& harness,
+                    const unsigned int samplerate,
+                    const unsigned int block_size,
+                    const unsigned int hop_size,
+                    const std::array<unsigned int, 2> pitch_range) {
+    if (!harness.enabled("detector"))
+        return;
+
+    auto samples = njones::bench::generate_signal<double>(njones::bench::Signal::Chord, samplerate, hop_size * nblocks);
+    std::array<njones::audio::a2m::Note, 128> notes;
+
+    const std::pair<const char*, njones::audio::a2m::Detector> detectors[] = {
+        {"detector/fft", njones::audio::a2m::Detector::Fft},
+        {"detector/goertzel", njones::audio::a2m::Detector::Goertzel}};
+    for (const auto& [name, detector] : detectors) {
+        auto converter = njones::audio::a2m::Converter(samplerate, block_size, 0.0, {}, pitch_range);
+        converter.set_detector(detector);
+        converter.set_hop_size(hop_size);
+
+        size_t block = 0;
+        harness.run(name,
+                    {{"samplerate", std::to_string(samplerate)},
+                     {"block_size", std::to_string(block_size)},
+                     {"hop_size", std::to_string(hop_size)},
+                     {"pitch_range", std::to_string(pitch_range[0]) + "-" + std::to_string(pitch_range[1])}},
+                    hop_size, samplerate, [&]() {
+                        converter.convert(samples.data() + block * hop_size, notes);
+                        block = (block + 1) % nblocks;
+                    });
+    }
+}
+
+/**
+ * Converts the same chord with a FixedConverter and with an equally configured Converter.
+ */
+template <unsigned int SampleRate, unsigned int BlockSize>
+void bench_fixed(njones::bench::Harness& harness) {
+    if (!harness.enabled("fixed"))
+        return;
+
+    auto samples =
+        njones::bench::generate_signal<double>(njones::bench::Signal::Chord, SampleRate, BlockSize * nblocks);
+    auto fixed = std::make_unique<njones::audio::a2m::FixedConverter<SampleRate, BlockSize>>();
+    auto dynamic = njones::audio::a2m::Converter(SampleRate, BlockSize);
+    dynamic.set_detector(njones::audio::a2m::Detector::Fft);
+    std::array<njones::audio::a2m::Note, 128> notes;
+
+    const auto parameters = njones::bench::Parameters{{"samplerate", std::to_string(SampleRate)},
+                                                      {"block_size", std::to_string(BlockSize)}};
+    size_t block = 0;
+    harness.run("fixed/fixed", parameters, BlockSize, SampleRate, [&]() {
+        fixed->convert(samples.data() + block * BlockSize, notes);
+        block = (block + 1) % nblocks;
+    });
+    harness.run("fixed/dynamic", parameters, BlockSize, SampleRate, [&]() {
+        dynamic.convert(samples.data() + block * BlockSize, notes);
+        block = (block + 1) % nblocks;
+    });
+}
+/**
+ * Measures what a hop costs the audio thread: converting it in place, or only handing it to an
+ * AsyncConverter and collecting finished frames. Iterations run faster than real time, so the
+ * analysis thread overruns and the async figure is the hand-off alone.
+ */
+void bench_async(njones::bench::Harness& harness,
+                 const unsigned int samplerate,
+                 const unsigned int block_size,
+                 const unsigned int hop_size) {
+    if (!harness.enabled("async"))
+        return;
+
+    auto samples = njones::bench::generate_signal<double>(njones::bench::Signal::Chord, samplerate, hop_size * nblocks);
+    const auto parameters = njones::bench::Parameters{{"samplerate", std::to_string(samplerate)},
+                                                      {"block_size", std::to_string(block_size)},
+                                                      {"hop_size", std::to_string(hop_size)}};
+
+    auto converter = njones::audio::a2m::Converter(samplerate, block_size);
+    converter.set_hop_size(hop_size);
+    std::array<njones::audio::a2m::Note, 128> notes;
+    size_t block = 0;
+    harness.run("async/synchronous", parameters, hop_size, samplerate, [&]() {
+        converter.convert(samples.data() + block * hop_size, notes);
+        block = (block + 1) % nblocks;
+    });
+
+    auto async = njones::audio::a2m::AsyncConverter(samplerate, block_size, hop_size);
+    size_t frames = 0;
+    harness.run("async/audio_thread", parameters, hop_size, samplerate, [&]() {
+        async.push(samples.data() + block * hop_size, hop_size);
+        frames += async.poll([](const njones::audio::a2m::AsyncConverter::Frame&) {});
+        block = (block + 1) % nblocks;
+    });
+}
+/**
+ * Converts a long signal offline into a reused sink, once through convert_blocks() and once with the
+ * per-block loop of vector returning convert() calls it replaces.
+ */
+void bench_batch(njones::bench::Harness& harness, const unsigned int samplerate, const unsigned int block_size) {
+    if (!harness.enabled("batch"))
+        return;
+
+    const size_t nbatch = 256;
+    auto samples =
+        njones::bench::generate_signal<double>(njones::bench::Signal::Chord, samplerate, block_size * nbatch);
+    const auto parameters = njones::bench::Parameters{{"samplerate", std::to_string(samplerate)},
+                                                      {"block_size", std::to_string(block_size)},
+                                                      {"blocks", std::to_string(nbatch)}};
+
+    auto converter = njones::audio::a2m::Converter(samplerate, block_size, 0.1);
+    auto sink = njones::audio::a2m::NoteSink();
+    harness.run("batch/convert_blocks", parameters, samples.size(), samplerate, [&]() {
+        sink.clear();
+        converter.convert_blocks(samples.data(), nbatch, sink);
+    });
+    harness.run("batch/convert_loop", parameters, samples.size(), samplerate, [&]() {
+        sink.clear();
+        for (size_t block = 0; block < nbatch; ++block)
+            for (auto& note : converter.convert(samples.data() + block * block_size))
+                sink.push_back(njones::audio::a2m::BlockNote{block, note});
+    });
+}
+/**
+ * Keeps many identically configured converters alive, as a host running one per track or voice does,
+ * and reports the memory each one costs.
+ */
+void bench_memory(njones::bench::Harness& harness, const unsigned int samplerate, const unsigned int block_size) {
+    const size_t instances = 256;
+    const auto parameters = njones::bench::Parameters{{"samplerate", std::to_string(samplerate)},
+                                                      {"block_size", std::to_string(block_size)}};
+
+    harness.measure_memory("memory/converter", parameters, instances, [&]() {
+        return std::make_shared<njones::audio::a2m::Converter>(samplerate, block_size, 0.1);
+    });
+    harness.measure_memory("memory/float_converter", parameters, instances, [&]() {
+        return std::make_shared<njones::audio::a2m::FloatConverter>(samplerate, block_size, 0.1);
+    });
+    harness.measure_memory("memory/hann_hop", parameters, instances, [&]() {
+        auto converter = std::make_shared<njones::audio::a2m::Converter>(samplerate, block_size, 0.1);
+        converter->set_window(njones::audio::a2m::Window::Hann);
+        converter->set_hop_size(block_size / 4);
+        return converter;
+    });
+    harness.measure_memory("memory/octave_levels", parameters, instances, [&]() {
+        auto converter = std::make_shared<njones::audio::a2m::Converter>(samplerate, block_size, 0.1);
+        converter->set_octave_levels(4);
+        return converter;
+    });
+}
+}  // namespace
+
+void njones::bench::bench_converter(Harness& harness) {
+    if (harness.enabled("convert")) {
+        for (unsigned int samplerate : samplerates)
+            for (unsigned int block_size : block_sizes) {
+                bench_convert(harness, samplerate, block_size, Signal::Chord, {}, 0);
+                bench_convert(harness, samplerate, block_size, Signal::Chord, {0, 2, 4, 5, 7, 9, 11}, 0);
+                bench_convert(harness, samplerate, block_size, Signal::Chord, {}, 4);
+                bench_convert(harness, samplerate, block_size, Signal::Chord, {0, 2, 4, 5, 7, 9, 11}, 4);
+                bench_convert(harness, samplerate, block_size, Signal::Silence, {}, 0);
+                // Sparse and dense spectra, with and without top-N selection.
+                bench_convert(harness, samplerate, block_size, Signal::Sine, {}, 0);
+                bench_convert(harness, samplerate, block_size, Signal::Sine, {}, 4);
+                bench_convert(harness, samplerate, block_size, Signal::Noise, {}, 0);
+                bench_convert(harness, samplerate, block_size, Signal::Noise, {}, 4);
+            }
+    }
+
+    for (unsigned int block_size : {512, 1024, 2048, 4096}) {
+        bench_precision(harness, 48000, block_size);
+        bench_multi_channel(harness, 48000, block_size, 8);
+        bench_multi_channel(harness, 48000, block_size, 32);
+        bench_pool(harness, 48000, block_size, 64);
+    }
+
+    for (unsigned int levels : {4, 6, 8})
+        bench_octave_levels(harness, 48000, 512, levels);
+
+    for (unsigned int block_size : {2048, 4096, 8192})
+        bench_refinement(harness, 48000, block_size);
+
+    for (unsigned int block_size : {1024, 4096})
+        bench_gate(harness, 48000, block_size, block_size / 4);
+
+    // One note, one key's worth of notes and one octave.
+    for (unsigned int block_size : {1024, 4096})
+        for (auto pitch_range : {std::array<unsigned int, 2>{69, 69}, {60, 64}, {57, 68}})
+            bench_detector(harness, 48000, block_size, 256, pitch_range);
+
+    bench_fixed<44100, 512>(harness);
+    bench_fixed<44100, 1024>(harness);
+    bench_fixed<44100, 2048>(harness);
+    bench_fixed<48000, 512>(harness);
+    bench_fixed<48000, 1024>(harness);
+    bench_fixed<48000, 2048>(harness);
+    for (unsigned int block_size : {1024, 4096})
+        bench_async(harness, 48000, block_size, 256);
+    for (unsigned int block_size : {512, 1024, 2048, 4096})
+        bench_batch(harness, 48000, block_size);
+
+    for (unsigned int block_size : {1024, 4096})
+        bench_memory(harness, 48000, block_size);
+}
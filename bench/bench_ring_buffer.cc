@@ -0,0 +1,83 @@
+#include <njones/a2m/notes.h>
+#include <njones/lib/ring_buffer.h>
+#include <limits>
+#include <type_traits>
+#include <vector>
+#include "signals.h"
+#include "suites.h"
+
+namespace {
+/**
+ * Streams host sized buffers through a RingBuffer with a processor that does nothing, so only the
+ * buffering and sample conversion are measured.
+ */
+template <class SampleType, class ConversionType>
+void bench_add(njones::bench::Harness& harness,
+               const std::string& name,
+               const unsigned int nchannels,
+               const unsigned int block_size,
+               const unsigned int host_size) {
+    const unsigned int samplerate = 48000;
+    auto input = njones::bench::generate_signal<SampleType>(njones::bench::Signal::Sine, samplerate, host_size);
+    auto channels = std::vector<SampleType*>(nchannels, input.data());
+
+    size_t processed = 0;
+    auto buffer = njones::audio::RingBuffer<SampleType, ConversionType>(
+        [&](const int, ConversionType*, const int) { ++processed; }, nchannels, block_size);
+
+    harness.run(name,
+                {{"channels", std::to_string(nchannels)},
+                 {"block_size", std::to_string(block_size)},
+                 {"host_size", std::to_string(host_size)}},
+                host_size, samplerate, [&]() { buffer.add(channels.data(), host_size); });
+}
+
+/**
+ * Streams interleaved host buffers through a RingBuffer, measuring de-interleaving and sample conversion.
+ */
+template <class SampleType, class ConversionType>
+void bench_add_interleaved(njones::bench::Harness& harness,
+                           const std::string& name,
+                           const unsigned int nchannels,
+                           const unsigned int block_size,
+                           const unsigned int host_size) {
+    const unsigned int samplerate = 48000;
+    auto signal = njones::bench::generate_signal<double>(njones::bench::Signal::Sine, samplerate, host_size);
+    auto input = std::vector<SampleType>(host_size * nchannels);
+    for (size_t i = 0; i < input.size(); ++i) {
+        if constexpr (std::is_integral_v<SampleType>)
+            input[i] = static_cast<SampleType>(signal[i / nchannels] * std::numeric_limits<SampleType>::max());
+        else
+            input[i] = static_cast<SampleType>(signal[i / nchannels]);
+    }
+
+    size_t processed = 0;
+    auto buffer = njones::audio::RingBuffer<SampleType, ConversionType>(
+        [&](const int, ConversionType*, const int) { ++processed; }, nchannels, block_size);
+
+    harness.run(name,
+                {{"channels", std::to_string(nchannels)},
+                 {"block_size", std::to_string(block_size)},
+                 {"host_size", std::to_string(host_size)}},
+                host_size, samplerate, [&]() { buffer.add_interleaved(input.data(), host_size); });
+}
+}  // namespace
+
+void njones::bench::bench_ring_buffer(Harness& harness) {
+    for (unsigned int host_size : {64, 256, 1024, 4096}) {
+        bench_add<double, double>(harness, "ring_buffer/same_type", 2, 1024, host_size);
+        bench_add<float, float>(harness, "ring_buffer/same_type_float", 2, 1024, host_size);
+        bench_add<float, double>(harness, "ring_buffer/converting", 2, 1024, host_size);
+        bench_add<int16_t, double>(harness, "ring_buffer/int16", 2, 1024, host_size);
+        bench_add_interleaved<float, double>(harness, "ring_buffer/interleaved", 2, 1024, host_size);
+        bench_add_interleaved<float, float>(harness, "ring_buffer/interleaved_float", 2, 1024, host_size);
+        bench_add_interleaved<int16_t, double>(harness, "ring_buffer/interleaved_int16", 2, 1024, host_size);
+    }
+}
+
+void njones::bench::bench_notes(Harness& harness) {
+    harness.run("notes/generate_notes", {}, 0, 0, []() {
+        auto notes = njones::audio::a2m::generate_notes();
+        (void)notes;
+    });
+}
@@ -0,0 +1,148 @@
+#include "harness.h"
+#include <alloc_hook.h>
+#include <iostream>
+#include <stdexcept>
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+#include <malloc.h>
+#define A2M_BENCH_HEAP_USAGE
+#endif
+
+// The bytes currently allocated from the heap, including large blocks served by mmap.
+static size_t heap_in_use() {
+#if defined(A2M_BENCH_HEAP_USAGE)
+    const auto info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+#else
+    return 0;
+#endif
+}
+
+njones::bench::Harness::Harness(int argc, char** argv)
+    : format(Format::Text), min_time(std::chrono::milliseconds(100)), header_written(false) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--format=text")
+            format = Format::Text;
+        else if (arg == "--format=csv")
+            format = Format::Csv;
+        else if (arg == "--format=json")
+            format = Format::Json;
+        else if (arg.rfind("--filter=", 0) == 0)
+            filter = arg.substr(9);
+        else if (arg.rfind("--min-time=", 0) == 0)
+            min_time = std::chrono::nanoseconds(static_cast<long long>(std::stod(arg.substr(11)) * 1e9));
+        else
+            throw std::invalid_argument("Unknown option " + arg +
+                                        ". Use --format=text|csv|json, --filter=<substring> or --min-time=<seconds>.");
+    }
+}
+
+bool njones::bench::Harness::enabled(const std::string& name) const {
+    return name.find(filter) != std::string::npos;
+}
+
+void njones::bench::Harness::run(const std::string& name,
+                                 const Parameters& parameters,
+                                 const size_t frames,
+                                 const unsigned int samplerate,
+                                 const std::function<void()>& iteration) {
+    if (!enabled(name))
+        return;
+
+    iteration();
+
+    size_t iterations = 0;
+    const size_t allocations = njones::test::allocation_count();
+    const auto start = std::chrono::steady_clock::now();
+    auto elapsed = std::chrono::nanoseconds(0);
+    while (elapsed < min_time || iterations < 3) {
+        iteration();
+        ++iterations;
+        elapsed = std::chrono::steady_clock::now() - start;
+    }
+
+    const double allocations_per_iteration =
+        static_cast<double>(njones::test::allocation_count() - allocations) / iterations;
+    const double ns = static_cast<double>(elapsed.count()) / iterations;
+    const double audio_ns = samplerate > 0 ? frames * 1e9 / samplerate : 0.0;
+    report(Measurement{name, parameters, iterations, ns, allocations_per_iteration, audio_ns / ns, 0.0});
+}
+
+void njones::bench::Harness::measure_memory(const std::string& name,
+                                            const Parameters& parameters,
+                                            const size_t instances,
+                                            const std::function<std::shared_ptr<void>()>& create) {
+#if defined(A2M_BENCH_HEAP_USAGE)
+    if (!enabled(name) || instances == 0)
+        return;
+
+    // The vector is sized up front so only the objects themselves are counted. Anything created on the
+    // first use of a process-wide cache, such as FFT plans, is counted too, as it would be in a host.
+    std::vector<std::shared_ptr<void>> objects;
+    objects.reserve(instances);
+    const size_t allocations = njones::test::allocation_count();
+    const size_t before = heap_in_use();
+    for (size_t i = 0; i < instances; ++i)
+        objects.push_back(create());
+    const size_t after = heap_in_use();
+
+    const double allocations_per_instance =
+        static_cast<double>(njones::test::allocation_count() - allocations) / instances;
+    const double bytes_per_instance = after > before ? static_cast<double>(after - before) / instances : 0.0;
+    report(Measurement{name, parameters, instances, 0.0, allocations_per_instance, 0.0, bytes_per_instance});
+#else
+    (void)name;
+    (void)parameters;
+    (void)instances;
+    (void)create;
+#endif
+}
+
+void njones::bench::Harness::report(const Measurement& measurement) {
+    switch (format) {
+        case Format::Text:
+            std::cout << measurement.name;
+            for (const auto& [key, value] : measurement.parameters)
+                std::cout << " " << key << "=" << value;
+            if (measurement.bytes_per_instance > 0) {
+                std::cout << " bytes/instance=" << static_cast<long long>(measurement.bytes_per_instance)
+                          << " allocs/instance=" << measurement.allocations_per_iteration
+                          << " instances=" << measurement.iterations << std::endl;
+                break;
+            }
+            std::cout << " ns/iter=" << static_cast<long long>(measurement.ns_per_iteration)
+                      << " allocs/iter=" << measurement.allocations_per_iteration
+                      << " realtime=" << measurement.realtime_factor << "x iterations=" << measurement.iterations
+                      << std::endl;
+            break;
+
+        case Format::Csv:
+            // Parameters vary between benchmarks, so they share one key=value;... column.
+            if (!header_written) {
+                std::cout << "name,parameters,iterations,ns_per_iteration,allocations_per_iteration,realtime_factor,"
+                             "bytes_per_instance"
+                          << std::endl;
+                header_written = true;
+            }
+            std::cout << measurement.name << ",";
+            for (size_t i = 0; i < measurement.parameters.size(); ++i)
+                std::cout << (i > 0 ? ";" : "") << measurement.parameters[i].first << "="
+                          << measurement.parameters[i].second;
+            std::cout << "," << measurement.iterations << "," << measurement.ns_per_iteration << ","
+                      << measurement.allocations_per_iteration << "," << measurement.realtime_factor << ","
+                      << measurement.bytes_per_instance << std::endl;
+            break;
+
+        case Format::Json:
+            std::cout << "{\"name\":\"" << measurement.name << "\",\"parameters\":{";
+            for (size_t i = 0; i < measurement.parameters.size(); ++i)
+                std::cout << (i > 0 ? "," : "") << "\"" << measurement.parameters[i].first << "\":\""
+                          << measurement.parameters[i].second << "\"";
+            std::cout << "},\"iterations\":" << measurement.iterations
+                      << ",\"ns_per_iteration\":" << measurement.ns_per_iteration
+                      << ",\"allocations_per_iteration\":" << measurement.allocations_per_iteration
+                      << ",\"realtime_factor\":" << measurement.realtime_factor
+                      << ",\"bytes_per_instance\":" << measurement.bytes_per_instance << "}" << std::endl;
+            break;
+    }
+}
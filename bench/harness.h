@@ -0,0 +1,81 @@
+#pragma once
+#include <stddef.h>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace njones {
+namespace bench {
+typedef std::vector<std::pair<std::string, std::string>> Parameters;
+
+/**
+ * @brief The result of one benchmark, normalised per iteration.
+ */
+struct Measurement {
+    std::string name;
+    Parameters parameters;
+    size_t iterations;
+    double ns_per_iteration;
+    double allocations_per_iteration;
+    // Seconds of audio processed per second of wall time; 0 when the benchmark processes no audio.
+    double realtime_factor;
+    // The heap memory held per object by a memory benchmark, otherwise 0.
+    double bytes_per_instance;
+};
+
+/**
+ * @brief Runs benchmarks selected on the command line and reports them as they finish.
+ * Options:
+ *   --format=text|csv|json  text for people, csv or JSON Lines for tracking results over time
+ *   --filter=<substring>    only run benchmarks whose name contains the substring
+ *   --min-time=<seconds>    the minimum time spent measuring each benchmark
+ */
+class Harness {
+   public:
+    Harness(int argc, char** argv);
+
+    bool enabled(const std::string& name) const;
+
+    /**
+     * @brief Repeats an iteration until the minimum time has passed, after one untimed warm up.
+     * @param name
+     * @param parameters Reported alongside the measurement.
+     * @param frames The number of sample frames processed per iteration, used for the real-time factor.
+     * @param samplerate
+     * @param iteration
+     */
+    void run(const std::string& name,
+             const Parameters& parameters,
+             const size_t frames,
+             const unsigned int samplerate,
+             const std::function<void()>& iteration);
+
+    /**
+     * @brief Keeps instances objects alive at once and reports the heap memory they hold, per object.
+     * Counts everything allocated through malloc, FFTW's buffers included, so it is only reported with
+     * glibc, whose allocator can be queried.
+     * @param name
+     * @param parameters Reported alongside the measurement.
+     * @param instances
+     * @param create Creates one object, which is released when the returned pointer is.
+     */
+    void measure_memory(const std::string& name,
+                        const Parameters& parameters,
+                        const size_t instances,
+                        const std::function<std::shared_ptr<void>()>& create);
+
+   private:
+    enum class Format { Text, Csv, Json };
+
+    void report(const Measurement& measurement);
+
+    Format format;
+    std::string filter;
+    std::chrono::nanoseconds min_time;
+    bool header_written;
+};
+}  // namespace bench
+}  // namespace njones
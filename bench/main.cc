@@ -0,0 +1,16 @@
+#include <iostream>
+#include <stdexcept>
+#include "suites.h"
+
+int main(int argc, char** argv) {
+    try {
+        auto harness = njones::bench::Harness(argc, argv);
+        njones::bench::bench_converter(harness);
+        njones::bench::bench_ring_buffer(harness);
+        njones::bench::bench_notes(harness);
+    } catch (const std::exception& error) {
+        std::cerr << "bench-a2m: " << error.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
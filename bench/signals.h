@@ -0,0 +1,64 @@
+#pragma once
+#include <math.h>
+#include <stddef.h>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace njones {
+namespace bench {
+/**
+ * @brief The synthetic inputs benchmarks run on. They exercise different amounts of downstream work:
+ * silence detects nothing, a sine one note, a chord a few and noise as many as the converter allows.
+ */
+enum class Signal { Silence, Sine, Chord, Noise };
+
+inline std::string signal_name(const Signal signal) {
+    switch (signal) {
+        case Signal::Silence:
+            return "silence";
+        case Signal::Sine:
+            return "sine";
+        case Signal::Chord:
+            return "chord";
+        case Signal::Noise:
+            return "noise";
+    }
+    return "";
+}
+
+template <class SampleType>
+std::vector<SampleType> generate_signal(const Signal signal, const unsigned int samplerate, const size_t nsamples) {
+    static const double chord[] = {261.63, 329.63, 392.00};
+    auto samples = std::vector<SampleType>(nsamples);
+    switch (signal) {
+        case Signal::Silence:
+            break;
+
+        case Signal::Sine:
+            for (size_t i = 0; i < nsamples; ++i)
+                samples[i] = static_cast<SampleType>(sin(2.0 * M_PI * 440.0 * i / samplerate));
+            break;
+
+        case Signal::Chord:
+            for (size_t i = 0; i < nsamples; ++i) {
+                double sample = 0.0;
+                for (auto freq : chord)
+                    sample += sin(2.0 * M_PI * freq * i / samplerate) / 3.0;
+                samples[i] = static_cast<SampleType>(sample);
+            }
+            break;
+
+        case Signal::Noise: {
+            // Seeded so every run measures the same input.
+            auto engine = std::mt19937(42);
+            auto distribution = std::uniform_real_distribution<double>(-1.0, 1.0);
+            for (size_t i = 0; i < nsamples; ++i)
+                samples[i] = static_cast<SampleType>(distribution(engine));
+            break;
+        }
+    }
+    return samples;
+}
+}  // namespace bench
+}  // namespace njones
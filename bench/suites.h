@@ -0,0 +1,10 @@
+#pragma once
+#include "harness.h"
+
+namespace njones {
+namespace bench {
+void bench_converter(Harness& harness);
+void bench_ring_buffer(Harness& harness);
+void bench_notes(Harness& harness);
+}  // namespace bench
+}  // namespace njones
@@ -0,0 +1,132 @@
+#include "async_converter.h"
+
+#include <algorithm>
+
+template <class SampleType>
+njones::audio::a2m::BasicAsyncConverter<SampleType>::BasicAsyncConverter(const unsigned int samplerate,
+                                                                         const unsigned int block_size,
+                                                                         const unsigned int hop_size,
+                                                                         const unsigned int max_latency_blocks,
+                                                                         const double activation_level,
+                                                                         const std::vector<unsigned int> pitch_set,
+                                                                         const std::array<unsigned int, 2> pitch_range,
+                                                                         const unsigned int note_count,
+                                                                         const int transpose,
+                                                                         const double ceiling)
+    : converter(samplerate, block_size, activation_level, pitch_set, pitch_range, note_count, transpose, ceiling),
+      block_samples(hop_size == 0 ? block_size : std::min(hop_size, block_size)),
+      window_samples(block_size),
+      blocks(max_latency_blocks, Block{0, std::vector<SampleType>(block_samples)}),
+      frames(max_latency_blocks, Frame{}),
+      pending(nullptr),
+      filled(0),
+      position(0),
+      published(0),
+      stopping(false),
+      overruns(0),
+      dropped_frames(0) {
+    if (hop_size != 0)
+        converter.set_hop_size(hop_size);
+    worker = std::thread([this]() { run(); });
+}
+
+template <class SampleType>
+njones::audio::a2m::BasicAsyncConverter<SampleType>::~BasicAsyncConverter() {
+    stopping.store(true, std::memory_order_release);
+    published.fetch_add(1, std::memory_order_release);
+    published.notify_one();
+    worker.join();
+}
+
+template <class SampleType>
+void njones::audio::a2m::BasicAsyncConverter<SampleType>::push(const SampleType* samples,
+                                                               const size_t nsamples) noexcept {
+    size_t offset = 0;
+    while (offset < nsamples) {
+        // A block whose slot cannot be claimed up front is dropped as a whole, so every block that is
+        // analysed is contiguous within itself; run() marks the frames whose history spans the gap.
+        if (filled == 0) {
+            pending = blocks.claim();
+            if (pending != nullptr)
+                pending->position = position;
+            else
+                overruns.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        const size_t count = std::min(nsamples - offset, block_samples - filled);
+        if (pending != nullptr)
+            std::copy_n(samples + offset, count, pending->samples.data() + filled);
+        filled += count;
+        offset += count;
+        position += count;
+
+        if (filled == block_samples) {
+            if (pending != nullptr) {
+                blocks.push();
+                published.fetch_add(1, std::memory_order_release);
+                published.notify_one();
+            }
+            pending = nullptr;
+            filled = 0;
+        }
+    }
+}
+
+template <class SampleType>
+void njones::audio::a2m::BasicAsyncConverter<SampleType>::run() {
+    std::array<Note, 128> discarded;
+    // The position the next block starts at when none were dropped, and the first position after the
+    // most recent gap.
+    uint64_t expected = 0;
+    uint64_t resumed = 0;
+    while (true) {
+        const uint32_t seen = published.load(std::memory_order_acquire);
+        Block* block = blocks.front();
+        if (block == nullptr) {
+            if (stopping.load(std::memory_order_acquire))
+                return;
+            published.wait(seen, std::memory_order_acquire);
+            continue;
+        }
+
+        if (block->position != expected)
+            resumed = block->position;
+        expected = block->position + block_samples;
+
+        // The converter keeps its history even when the frame cannot be delivered.
+        Frame* frame = frames.claim();
+        if (frame != nullptr) {
+            frame->position = block->position;
+            frame->discontinuous = resumed > 0 && expected < resumed + window_samples;
+            frame->count = converter.convert(block->samples.data(), frame->notes);
+            frames.push();
+        } else {
+            converter.convert(block->samples.data(), discarded);
+            dropped_frames.fetch_add(1, std::memory_order_relaxed);
+        }
+        blocks.pop();
+    }
+}
+
+template <class SampleType>
+njones::audio::a2m::BasicConverter<SampleType>& njones::audio::a2m::BasicAsyncConverter<SampleType>::get_converter() {
+    return converter;
+}
+
+template <class SampleType>
+uint64_t njones::audio::a2m::BasicAsyncConverter<SampleType>::get_overruns() const {
+    return overruns.load(std::memory_order_relaxed);
+}
+
+template <class SampleType>
+uint64_t njones::audio::a2m::BasicAsyncConverter<SampleType>::get_dropped_frames() const {
+    return dropped_frames.load(std::memory_order_relaxed);
+}
+
+template <class SampleType>
+uint64_t njones::audio::a2m::BasicAsyncConverter<SampleType>::get_max_latency() const {
+    return static_cast<uint64_t>(blocks.capacity()) * block_samples;
+}
+
+template class njones::audio::a2m::BasicAsyncConverter<double>;
+template class njones::audio::a2m::BasicAsyncConverter<float>;
@@ -0,0 +1,136 @@
+#pragma once
+#include <njones/a2m/converter.h>
+#include <njones/lib/spsc_queue.h>
+#include <stdint.h>
+#include <array>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace njones {
+namespace audio {
+namespace a2m {
+/**
+ * @brief Runs a converter on a dedicated analysis thread so its cost stays off the audio callback.
+ * The audio thread only copies samples in with push() and takes finished frames out with poll(); both
+ * are wait-free and never allocate. Blocks travel to the analysis thread and note frames back through
+ * two SPSCQueues of max_latency_blocks slots each, which bounds how far analysis can fall behind.
+ * When it falls further behind, new blocks are dropped and counted as overruns instead of delaying
+ * the audio thread. Dropped blocks are never partly analysed, but with a hop size the history the
+ * converter keeps is no longer contiguous after one, so frames analysed across the gap are marked
+ * Frame::discontinuous.
+ * @tparam SampleType The sample and FFT precision, either float or double.
+ */
+template <class SampleType>
+class BasicAsyncConverter {
+   public:
+    /**
+     * @brief The notes of one block, stamped with the stream position of the block's first sample.
+     */
+    struct Frame {
+        uint64_t position;
+        // Set when the block_size samples analysed for the frame span a gap left by blocks dropped as
+        // overruns. The analysis then joined audio from either side of the gap, so its notes may be wrong.
+        bool discontinuous;
+        size_t count;
+        std::array<Note, 128> notes;
+    };
+
+    /**
+     * @param samplerate The samplerate of the audio data passed into push.
+     * @param block_size The number of samples each analysis covers.
+     * @param hop_size The number of new samples per analysis, or 0 for non-overlapping blocks.
+     * @param max_latency_blocks The number of completed blocks which may wait for or undergo analysis
+     * at once, and the number of frames which may wait for poll().
+     * @see BasicConverter::BasicConverter
+     */
+    BasicAsyncConverter(const unsigned int samplerate,
+                        const unsigned int block_size,
+                        const unsigned int hop_size = 0,
+                        const unsigned int max_latency_blocks = 4,
+                        const double activation_level = 0.0,
+                        const std::vector<unsigned int> pitch_set = std::vector<unsigned int>{},
+                        const std::array<unsigned int, 2> pitch_range = std::array<unsigned int, 2>{0, 127},
+                        const unsigned int note_count = 0,
+                        const int transpose = 0,
+                        const double ceiling = 1.0);
+    /**
+     * @brief Converts every block already pushed, then stops the analysis thread.
+     */
+    ~BasicAsyncConverter();
+
+    /**
+     * @brief Copies any number of samples towards the next blocks. Call from the audio thread only.
+     */
+    void push(const SampleType* samples, const size_t nsamples) noexcept;
+
+    /**
+     * @brief Passes every finished frame to drain, oldest first. Call from the audio thread only.
+     * @return The number of frames drained.
+     */
+    template <class Drain>
+    size_t poll(Drain&& drain) noexcept {
+        size_t count = 0;
+        while (frames.try_pop([&](const Frame& frame) { drain(frame); }))
+            ++count;
+        return count;
+    }
+
+    /**
+     * @brief The converter running on the analysis thread. Its setters may be called from any thread,
+     * except set_block_size() and set_hop_size(), which must match the constructor.
+     */
+    BasicConverter<SampleType>& get_converter();
+
+    /**
+     * @brief The number of blocks dropped because the analysis thread was max_latency_blocks behind.
+     */
+    uint64_t get_overruns() const;
+    /**
+     * @brief The number of frames dropped because poll() was not called often enough to take them.
+     */
+    uint64_t get_dropped_frames() const;
+    /**
+     * @brief The most audio in samples which may be queued ahead of the analysis thread, max_latency_blocks
+     * hops. Beyond it new blocks are dropped as overruns.
+     */
+    uint64_t get_max_latency() const;
+
+   private:
+    BasicAsyncConverter(const BasicAsyncConverter&) = delete;
+    BasicAsyncConverter(BasicAsyncConverter&&) = delete;
+
+    struct Block {
+        uint64_t position;
+        std::vector<SampleType> samples;
+    };
+
+    void run();
+
+    BasicConverter<SampleType> converter;
+    size_t block_samples;
+    size_t window_samples;
+    SPSCQueue<Block> blocks;
+    SPSCQueue<Frame> frames;
+
+    // Owned by the audio thread: the block being filled, or null while its samples are being dropped.
+    Block* pending;
+    size_t filled;
+    uint64_t position;
+
+    // Counts published blocks so the analysis thread can sleep on it with atomic wait and notify, which
+    // only enter the kernel when the analysis thread is actually asleep.
+    std::atomic<uint32_t> published;
+    std::atomic<bool> stopping;
+    std::atomic<uint64_t> overruns;
+    std::atomic<uint64_t> dropped_frames;
+
+    // Declared last so it starts after, and is joined before, everything it uses.
+    std::thread worker;
+};
+
+typedef BasicAsyncConverter<double> AsyncConverter;
+typedef BasicAsyncConverter<float> FloatAsyncConverter;
+}  // namespace a2m
+}  // namespace audio
+}  // namespace njones
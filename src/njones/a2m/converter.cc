@@ -2,277 +2,1083 @@
 
 #include <math.h>
 #include <algorithm>
+#include <bit>
+#include <complex>
+#include <mutex>
 #include <string>
+#include <tuple>
 #include <fmt/format.h>
+#include "shared_tables.h"
 
-njones::audio::a2m::Note::Note() : pitch(0), velocity(0), count(0) {}
+template <class SampleType>
+njones::audio::a2m::BasicConverter<SampleType>::BasicConverter(const unsigned int samplerate,
+                                                               const unsigned int block_size,
+                                                               const double activation_level,
+                                                               const std::vector<unsigned int> pitch_set,
+                                                               const std::array<unsigned int, 2> pitch_range,
+                                                               const unsigned int note_count,
+                                                               const int transpose,
+                                                               const double ceiling)
+    : BasicConverter(Channels{1},
+                     samplerate,
+                     block_size,
+                     activation_level,
+                     pitch_set,
+                     pitch_range,
+                     note_count,
+                     transpose,
+                     ceiling) {}
 
-njones::audio::a2m::Note::Note(const unsigned int pitch, const unsigned int raw_pitch, const unsigned int velocity)
-    : pitch(pitch), raw_pitch(raw_pitch), velocity(velocity), count(0) {}
-
-bool njones::audio::a2m::Note::operator<(const njones::audio::a2m::Note& rhs) const {
-    return velocity < rhs.velocity;
-}
-
-bool njones::audio::a2m::Note::operator>(const njones::audio::a2m::Note& rhs) const {
-    return velocity > rhs.velocity;
+template <class SampleType>
+njones::audio::a2m::BasicConverter<SampleType>::BasicConverter(const Channels channels,
+                                                               const unsigned int samplerate,
+                                                               const unsigned int block_size,
+                                                               const double activation_level,
+                                                               const std::vector<unsigned int>& pitch_set,
+                                                               const std::array<unsigned int, 2>& pitch_range,
+                                                               const unsigned int note_count,
+                                                               const int transpose,
+                                                               const double ceiling)
+    : analysis_channels(std::max(1u, channels.count)),
+      notes(njones::audio::a2m::equal_temperament),
+      logger([](const std::string&) {}),
+      magnitude_kernel(njones::audio::a2m::magnitude_kernel<SampleType>()),
+      gate_state{0, {0.0, 0.0, 0.0}, 0, 0, false},
+      gated_blocks(0),
+      silent_blocks(0),
+      stationary_blocks(0),
+      active(nullptr),
+      pending(nullptr),
+      retired(nullptr) {
+    staged.note_count = note_count;
+    staged.pitch_set = pitch_set;
+    staged.pitch_range = pitch_range;
+    staged.hop_size = 0;
+    staged.octave_levels = 1;
+    staged.detector = Detector::Auto;
+    staged.refinement = Refinement::None;
+    staged.silence_gate = false;
+    staged.stationarity = 0.0;
+    staged.max_reused_blocks = 0;
+    staged.window = Window::Rectangular;
+    staged.retired_next = nullptr;
+    stage_activation_level(activation_level);
+    stage_transpose(transpose);
+    stage_ceiling(ceiling);
+    determine_ranges(samplerate, block_size);
+    active = new Settings(staged);
+    reset(accumulator);
 }
 
-bool njones::audio::a2m::Note::operator==(const njones::audio::a2m::Note& rhs) const {
-    return pitch == rhs.pitch;
+template <class SampleType>
+njones::audio::a2m::BasicConverter<SampleType>::~BasicConverter() {
+    reclaim();
+    delete pending.exchange(nullptr);
+    delete active;
 }
 
-njones::audio::a2m::Converter::Converter(const unsigned int samplerate,
+njones::audio::a2m::BinLayout::BinLayout(const double samplerate,
                                          const unsigned int block_size,
-                                         const double activation_level,
-                                         const std::vector<unsigned int> pitch_set,
-                                         const std::array<unsigned int, 2> pitch_range,
-                                         const unsigned int note_count,
-                                         const int transpose,
-                                         const double ceiling)
+                                         const njones::audio::a2m::note_table& notes)
     : samplerate(samplerate),
-      block_size(block_size),
-      bins(0),
-      time_window(0),
-      velocity_limit(0),
+      time_window(static_cast<int>(block_size / (samplerate / 1000))),
       min_freq(0.0),
       max_freq(0.0),
       min_bin(0),
       max_bin(0),
-      activation_level(activation_level),
-      pitch_set(pitch_set),
-      pitch_range(pitch_range),
-      note_count(note_count),
-      notes(njones::audio::a2m::generate_notes()),
-      fft_output(nullptr),
+      bin_freqs(block_size / 2) {
+    const unsigned int bins = bin_freqs.size();
+    max_freq = std::min(notes.at(127).high, samplerate / 2);
+    min_freq = std::max(notes.at(0).low, static_cast<double>(1000 / time_window.count()));
+
+    for (size_t i = 0; i < bins; ++i)
+        bin_freqs[i] = i * samplerate / block_size;
+
+    min_bin = 0;
+    for (unsigned int i = 0; i < bins; ++i)
+        if (bin_freqs[i] >= min_freq) {
+            min_bin = i;
+            break;
+        }
+
+    max_bin = bins - 1;
+    for (unsigned int i = 0; i < bins; ++i)
+        if (bin_freqs[i] >= max_freq) {
+            max_bin = i - 1;
+            break;
+        }
+}
+
+std::shared_ptr<const njones::audio::a2m::BinLayout> njones::audio::a2m::BinLayout::shared(
+    const double samplerate,
+    const unsigned int block_size,
+    const njones::audio::a2m::note_table& notes) {
+    static SharedTables<std::tuple<double, unsigned int, const note_table*>, BinLayout> layouts;
+    return layouts.get({samplerate, block_size, &notes}, [&]() { return BinLayout(samplerate, block_size, notes); });
+}
+
+template <class SampleType>
+njones::audio::a2m::BasicConverter<SampleType>::Level::Level(std::shared_ptr<const BinLayout> layout)
+    : layout(std::move(layout)), history_position(0), ndecimated(0) {}
+
+template <class SampleType>
+njones::audio::a2m::BasicConverter<SampleType>::Analysis::Analysis(const unsigned int samplerate,
+                                                                   const unsigned int block_size,
+                                                                   const unsigned int nchannels,
+                                                                   const unsigned int nlevels,
+                                                                   const bool hopping,
+                                                                   const njones::audio::a2m::note_table& notes)
+    : samplerate(samplerate),
+      block_size(block_size),
+      nchannels(nchannels),
+      output_stride(block_size / 2 + 1),
+      bins(0),
       fft_input(nullptr),
-      logger([](const std::string&){}) {
-    set_activation_level(activation_level);
-    set_transpose(transpose);
-    set_ceiling(ceiling);
-    fft_plan = fftw_plan_dft_r2c_1d(0, nullptr, nullptr, FFTW_ESTIMATE);
-    determine_ranges();
+      fft_output(nullptr) {
+    const auto time_window =
+        std::chrono::milliseconds(static_cast<int>(block_size / (static_cast<double>(samplerate) / 1000)));
+    if (time_window.count() > 0) {
+        bins = block_size / 2;
+        for (unsigned int level = 0; level < nlevels; ++level) {
+            levels.emplace_back(BinLayout::shared(static_cast<double>(samplerate) / (1u << level), block_size, notes));
+            if (level > 0) {
+                levels.back().decimated = std::vector<SampleType>(block_size / (1u << level) + 2);
+                // Each decimator is fed at most what the level above produced, half as much per level.
+                for (unsigned int channel = 0; channel < nchannels; ++channel)
+                    decimators.emplace_back(block_size / (1u << (level - 1)) + 1);
+            }
+        }
 
-    for (unsigned int i = 0; i < 128; ++i) {
-        accumulator[i].pitch = i;
-        accumulator[i].amplitude = 0.0;
-        accumulator[i].count = 0;
+        const size_t transforms = nchannels * levels.size();
+        if (hopping || levels.size() > 1)
+            history = std::vector<SampleType>(block_size * transforms);
+        fft_output = (Complex*)FFT<SampleType>::malloc(output_stride * transforms * sizeof(Complex));
+        fft_input = (SampleType*)FFT<SampleType>::malloc(block_size * transforms * sizeof(SampleType));
+        if (fft_output == nullptr || fft_input == nullptr) {
+            FFT<SampleType>::free(fft_output);
+            FFT<SampleType>::free(fft_input);
+            throw std::runtime_error("Failed to allocate FFT buffers.");
+        }
+
+        try {
+            fft_plan = PlanCache::instance().plan<SampleType>(block_size, transforms, fft_input, fft_output);
+        } catch (...) {
+            FFT<SampleType>::free(fft_output);
+            FFT<SampleType>::free(fft_input);
+            throw;
+        }
+    }
+}
+
+template <class SampleType>
+njones::audio::a2m::BasicConverter<SampleType>::Analysis::~Analysis() {
+    FFT<SampleType>::free(fft_output);
+    FFT<SampleType>::free(fft_input);
+}
+
+template <class SampleType>
+void njones::audio::a2m::BasicConverter<SampleType>::set_samplerate(const unsigned int samplerate) {
+    std::lock_guard<std::mutex> guard(lock);
+    if (staged.analysis->samplerate != samplerate) {
+        determine_ranges(samplerate, staged.analysis->block_size);
+        publish();
+    }
+}
+template <class SampleType>
+void njones::audio::a2m::BasicConverter<SampleType>::set_block_size(const unsigned int block_size) {
+    std::lock_guard<std::mutex> guard(lock);
+    if (staged.analysis->block_size != block_size) {
+        determine_ranges(staged.analysis->samplerate, block_size);
+        publish();
+    }
+}
+template <class SampleType>
+void njones::audio::a2m::BasicConverter<SampleType>::set_activation_level(const double activation_level) {
+    std::lock_guard<std::mutex> guard(lock);
+    stage_activation_level(activation_level);
+    publish();
+}
+template <class SampleType>
+void njones::audio::a2m::BasicConverter<SampleType>::set_pitch_set(const std::vector<unsigned int>& pitch_set) {
+    std::lock_guard<std::mutex> guard(lock);
+    staged.pitch_set = pitch_set;
+    determine_pitches();
+    publish();
+}
+template <class SampleType>
+void njones::audio::a2m::BasicConverter<SampleType>::set_pitch_range(const std::array<unsigned int, 2>& pitch_range) {
+    std::lock_guard<std::mutex> guard(lock);
+    staged.pitch_range = pitch_range;
+    determine_pitches();
+    publish();
+}
+template <class SampleType>
+void njones::audio::a2m::BasicConverter<SampleType>::set_note_count(const int note_count) {
+    std::lock_guard<std::mutex> guard(lock);
+    staged.note_count = note_count;
+    publish();
+}
+template <class SampleType>
+void njones::audio::a2m::BasicConverter<SampleType>::set_transpose(const int transpose) {
+    std::lock_guard<std::mutex> guard(lock);
+    stage_transpose(transpose);
+    determine_pitches();
+    publish();
+}
+template <class SampleType>
+void njones::audio::a2m::BasicConverter<SampleType>::set_ceiling(const double ceiling) {
+    std::lock_guard<std::mutex> guard(lock);
+    stage_ceiling(ceiling);
+    publish();
+}
+
+template <class SampleType>
+void njones::audio::a2m::BasicConverter<SampleType>::set_hop_size(const unsigned int hop_size) {
+    std::lock_guard<std::mutex> guard(lock);
+    staged.hop_size = hop_size;
+    // Block by block analysis of a single level leaves out the history, which hopping needs.
+    if (hopping() && staged.analysis->history.empty())
+        determine_ranges(staged.analysis->samplerate, staged.analysis->block_size);
+    publish();
+}
+template <class SampleType>
+void njones::audio::a2m::BasicConverter<SampleType>::set_window(const njones::audio::a2m::Window window) {
+    std::lock_guard<std::mutex> guard(lock);
+    if (staged.window != window) {
+        staged.window = window;
+        if (hopping() && staged.analysis->history.empty())
+            determine_ranges(staged.analysis->samplerate, staged.analysis->block_size);
+        else
+            determine_window();
+        publish();
     }
 }
 
-njones::audio::a2m::Converter::~Converter() {
-    if (fft_output != nullptr)
-        free(fft_output);
-    if (fft_input != nullptr)
-        free(fft_input);
-    fftw_destroy_plan(fft_plan);
+template <class SampleType>
+void njones::audio::a2m::BasicConverter<SampleType>::set_octave_levels(const unsigned int levels) {
+    std::lock_guard<std::mutex> guard(lock);
+    const unsigned int octave_levels = std::clamp(levels, 1u, max_octave_levels);
+    if (staged.octave_levels != octave_levels) {
+        staged.octave_levels = octave_levels;
+        determine_ranges(staged.analysis->samplerate, staged.analysis->block_size);
+        publish();
+    }
 }
 
-void njones::audio::a2m::Converter::set_samplerate(const unsigned int samplerate) {
-    std::lock_guard<std::recursive_mutex> guard(lock);
-    if (this->samplerate != samplerate) {
-        this->samplerate = samplerate;
-        determine_ranges();
+template <class SampleType>
+void njones::audio::a2m::BasicConverter<SampleType>::set_detector(const njones::audio::a2m::Detector detector) {
+    std::lock_guard<std::mutex> guard(lock);
+    if (staged.detector != detector) {
+        staged.detector = detector;
+        determine_pitches();
+        publish();
     }
 }
-void njones::audio::a2m::Converter::set_block_size(const unsigned int block_size) {
-    std::lock_guard<std::recursive_mutex> guard(lock);
-    if (this->block_size != block_size) {
-        this->block_size = block_size;
-        determine_ranges();
+
+template <class SampleType>
+void njones::audio::a2m::BasicConverter<SampleType>::set_refinement(const njones::audio::a2m::Refinement refinement) {
+    std::lock_guard<std::mutex> guard(lock);
+    if (staged.refinement != refinement) {
+        staged.refinement = refinement;
+        determine_pitches();
+        publish();
     }
 }
-void njones::audio::a2m::Converter::set_activation_level(const double activation_level) {
-    std::lock_guard<std::recursive_mutex> guard(lock);
-    this->activation_level = activation_level;
+
+template <class SampleType>
+void njones::audio::a2m::BasicConverter<SampleType>::set_silence_gate(const bool enabled) {
+    std::lock_guard<std::mutex> guard(lock);
+    staged.silence_gate = enabled;
+    publish();
+}
+
+template <class SampleType>
+void njones::audio::a2m::BasicConverter<SampleType>::set_stationarity(const double tolerance,
+                                                                      const unsigned int max_reused_blocks) {
+    std::lock_guard<std::mutex> guard(lock);
+    staged.stationarity = std::clamp(tolerance, 0.0, 1.0);
+    staged.max_reused_blocks = max_reused_blocks;
+    if (staged.stationarity > 0.0 && staged.reused_frame == nullptr)
+        staged.reused_frame = std::make_shared<std::array<njones::audio::a2m::Note, 128>>();
+    publish();
+}
+
+template <class SampleType>
+njones::audio::a2m::GateCounters njones::audio::a2m::BasicConverter<SampleType>::get_gate_counters() const {
+    return GateCounters{gated_blocks.load(std::memory_order_relaxed), silent_blocks.load(std::memory_order_relaxed),
+                        stationary_blocks.load(std::memory_order_relaxed)};
+}
+
+template <class SampleType>
+njones::audio::a2m::InstrumentationSnapshot njones::audio::a2m::BasicConverter<SampleType>::get_instrumentation()
+    const {
+    return instrumentation.snapshot();
+}
+
+template <class SampleType>
+void njones::audio::a2m::BasicConverter<SampleType>::stage_activation_level(const double activation_level) {
+    staged.activation_level = activation_level;
     if (activation_level != 0.0)
-        velocity_limit = static_cast<unsigned int>(127 * activation_level);
+        staged.velocity_limit = static_cast<unsigned int>(127 * activation_level);
     else
-        velocity_limit = 1;
+        staged.velocity_limit = 1;
 }
-void njones::audio::a2m::Converter::set_pitch_set(const std::vector<unsigned int>& pitch_set) {
-    std::lock_guard<std::recursive_mutex> guard(lock);
-    this->pitch_set = pitch_set;
+template <class SampleType>
+void njones::audio::a2m::BasicConverter<SampleType>::stage_transpose(const int transpose) {
+    staged.transpose = std::max(-127, transpose);
+    staged.transpose = std::min(127, staged.transpose);
 }
-void njones::audio::a2m::Converter::set_pitch_range(const std::array<unsigned int, 2>& pitch_range) {
-    std::lock_guard<std::recursive_mutex> guard(lock);
-    this->pitch_range = pitch_range;
+template <class SampleType>
+void njones::audio::a2m::BasicConverter<SampleType>::stage_ceiling(const double ceiling) {
+    staged.ceiling = std::max(0.0, ceiling);
+    staged.ceiling = std::min(1.0, staged.ceiling);
 }
-void njones::audio::a2m::Converter::set_note_count(const int note_count) {
-    std::lock_guard<std::recursive_mutex> guard(lock);
-    this->note_count = note_count;
+
+template <class SampleType>
+void njones::audio::a2m::BasicConverter<SampleType>::determine_ranges(const unsigned int samplerate,
+                                                                      const unsigned int block_size) {
+    staged.analysis = std::make_shared<Analysis>(samplerate, block_size, analysis_channels, staged.octave_levels,
+                                                 hopping(), notes);
+    determine_pitches();
+    determine_window();
 }
-void njones::audio::a2m::Converter::set_transpose(const int transpose) {
-    std::lock_guard<std::recursive_mutex> guard(lock);
-    this->transpose = std::max(-127, transpose);
-    this->transpose = std::min(127, this->transpose);
+
+template <class SampleType>
+void njones::audio::a2m::BasicConverter<SampleType>::determine_window() {
+    static SharedTables<std::tuple<Window, unsigned int>, std::vector<SampleType>> windows;
+    const auto window = staged.window;
+    const auto block_size = staged.analysis->block_size;
+    staged.window_coefficients = windows.get({window, block_size}, [&]() {
+        const auto coefficients = njones::audio::a2m::generate_window(window, block_size);
+        return std::vector<SampleType>(coefficients.begin(), coefficients.end());
+    });
 }
-void njones::audio::a2m::Converter::set_ceiling(const double ceiling) {
-    std::lock_guard<std::recursive_mutex> guard(lock);
-    this->ceiling = std::max(0.0, ceiling);
-    this->ceiling = std::min(1.0, this->ceiling);
+
+template <class SampleType>
+bool njones::audio::a2m::BasicConverter<SampleType>::hopping() const {
+    return staged.hop_size != 0 || staged.window != Window::Rectangular;
 }
 
-void njones::audio::a2m::Converter::determine_ranges() {
-    time_window = std::chrono::milliseconds(static_cast<int>(block_size / (static_cast<double>(samplerate) / 1000)));
-    if (time_window.count() > 0) {
-        max_freq = std::min(notes[127].high, static_cast<double>(samplerate) / 2);
-        min_freq = std::max(notes[0].low, static_cast<double>(1000 / time_window.count()));
-        bins = block_size / 2;
-        bin_freqs = std::vector<double>(bins);
+template <class SampleType>
+void njones::audio::a2m::BasicConverter<SampleType>::publish() {
+    reclaim();
+    auto settings = new Settings(staged);
+    settings->retired_next = nullptr;
 
-        for (size_t i = 0; i < bins; ++i)
-            bin_freqs[i] = static_cast<double>(i * samplerate) / block_size;
+    // A snapshot which convert() never picked up can be deleted straight away.
+    delete pending.exchange(settings, std::memory_order_acq_rel);
+}
 
-        min_bin = 0;
-        for (unsigned int i = 0; i < bins; ++i)
-            if (bin_freqs[i] >= min_freq) {
-                min_bin = i;
-                break;
+template <class SampleType>
+void njones::audio::a2m::BasicConverter<SampleType>::acquire() noexcept {
+    if (pending.load(std::memory_order_relaxed) == nullptr) [[likely]]
+        return;
+
+    auto settings = pending.exchange(nullptr, std::memory_order_acq_rel);
+    if (settings == nullptr)
+        return;
+
+    // The previous snapshot is pushed onto the retired list for the setters to delete,
+    // so the converting thread never frees memory or waits on another thread.
+    active->retired_next = retired.load(std::memory_order_relaxed);
+    while (!retired.compare_exchange_weak(active->retired_next, active, std::memory_order_release,
+                                          std::memory_order_relaxed)) {
+    }
+    active = settings;
+}
+
+template <class SampleType>
+void njones::audio::a2m::BasicConverter<SampleType>::reclaim() {
+    auto settings = retired.exchange(nullptr, std::memory_order_acquire);
+    while (settings != nullptr) {
+        auto next = settings->retired_next;
+        delete settings;
+        settings = next;
+    }
+}
+
+template <class SampleType>
+unsigned int njones::audio::a2m::BasicConverter<SampleType>::snap_to_key(unsigned int pitch) {
+    return njones::audio::a2m::snap_to_key(pitch, staged.pitch_set);
+}
+
+template <class SampleType>
+void njones::audio::a2m::BasicConverter<SampleType>::set_logger(std::function<void(const std::string&)> cb) {
+    logger = cb;
+}
+
+template <class SampleType>
+void njones::audio::a2m::BasicConverter<SampleType>::log(const std::string& msg) {
+    logger(msg);
+}
+
+template <class SampleType>
+void njones::audio::a2m::BasicConverter<SampleType>::determine_pitches() {
+    // samplerate, block size, levels, pitch set and note table
+    typedef std::tuple<unsigned int, unsigned int, size_t, std::vector<unsigned int>, const note_table*> Key;
+    static SharedTables<Key, std::vector<njones::audio::a2m::PitchSegment>> shared_segments;
+
+    const auto& analysis = *staged.analysis;
+    const Key key(analysis.samplerate, analysis.block_size, analysis.levels.size(), staged.pitch_set, &notes);
+    determine_detector(shared_segments.get(key, [&]() {
+        std::vector<njones::audio::a2m::PitchSegment> segments;
+
+        const auto note_levels = determine_note_levels(analysis);
+
+        // Both bin_freqs and notes are ascending, so a single merge walk per level maps every analysed bin
+        // to its note and consecutive bins of the same note collapse into one segment.
+        for (unsigned int level = 0; level < analysis.levels.size(); ++level) {
+            const auto& layout = *analysis.levels[level].layout;
+            int raw_pitch = 0;
+            for (unsigned int i = layout.min_bin; i < layout.max_bin; ++i) {
+                const double freq = layout.bin_freqs[i];
+                while (raw_pitch < 128 && notes[raw_pitch].high < freq)
+                    ++raw_pitch;
+
+                if (raw_pitch >= 128 || freq < notes[raw_pitch].low || note_levels[raw_pitch] != level)
+                    continue;
+
+                if (!segments.empty() && segments.back().raw_pitch == raw_pitch && segments.back().end == i &&
+                    segments.back().level == level)
+                    segments.back().end = i + 1;
+                else
+                    segments.push_back(
+                        PitchSegment{i, i + 1, static_cast<int>(snap_to_key(raw_pitch)), raw_pitch, level});
             }
+        }
+        return segments;
+    }));
+    determine_peaks();
+}
 
-        max_bin = bins - 1;
-        for (unsigned int i = 0; i < bins; ++i)
-            if (bin_freqs[i] >= max_freq) {
-                max_bin = i - 1;
+template <class SampleType>
+std::array<unsigned int, 128> njones::audio::a2m::BasicConverter<SampleType>::determine_note_levels(
+    const Analysis& analysis) const {
+    // Each note is analysed by the first level whose bins are no wider than the note, leaving the remaining
+    // low notes to the last level. With a single level every note is analysed by level 0.
+    const unsigned int last = analysis.levels.empty() ? 0 : analysis.levels.size() - 1;
+    std::array<unsigned int, 128> note_levels;
+    for (int pitch = 0; pitch < 128; ++pitch) {
+        note_levels[pitch] = last;
+        for (unsigned int level = 0; level < last; ++level)
+            if (notes[pitch].high - notes[pitch].low >=
+                analysis.levels[level].layout->samplerate / analysis.block_size) {
+                note_levels[pitch] = level;
                 break;
             }
+    }
+    return note_levels;
+}
 
-        frequencies.resize(max_bin - min_bin);
+template <class SampleType>
+void njones::audio::a2m::BasicConverter<SampleType>::determine_peaks() {
+    const auto& analysis = *staged.analysis;
+    if (staged.refinement != Refinement::Peaks || analysis.levels.empty()) {
+        staged.peaks = nullptr;
+        return;
+    }
 
-        if (fft_output != nullptr)
-            free(fft_output);
+    // Unlike the segments, which only hold notes with a bin centre inside them, a level searches the bins
+    // around every note it is responsible for, however narrow the note.
+    auto peaks = std::make_shared<PeakMap>();
+    const auto note_levels = determine_note_levels(analysis);
+    for (unsigned int level = 0; level < analysis.levels.size(); ++level) {
+        const auto& layout = *analysis.levels[level].layout;
+        const double bin_width = layout.samplerate / analysis.block_size;
+        auto range = typename PeakMap::Range{0, 0, bin_width, {0, 0}};
+        double low = layout.max_freq;
+        double high = layout.min_freq;
+        for (unsigned int pitch = 0; pitch < 128; ++pitch)
+            if (note_levels[pitch] == level && notes[pitch].high > layout.min_freq &&
+                notes[pitch].low < layout.max_freq) {
+                range.pitches[pitch >> 6] |= uint64_t(1) << (pitch & 63);
+                low = std::min(low, notes[pitch].low);
+                high = std::max(high, notes[pitch].high);
+            }
 
-        if (fft_input != nullptr)
-            free(fft_input);
+        // A peak needs both neighbours, so the search stays within [1, bins).
+        if (low < high) {
+            const unsigned int first = std::max(layout.min_bin, static_cast<unsigned int>(low / bin_width));
+            const unsigned int last = std::min(layout.max_bin, static_cast<unsigned int>(high / bin_width));
+            range.begin = std::max(2u, first) - 1;
+            range.end = std::min(analysis.bins, last + 2);
+        }
+        peaks->levels.push_back(range);
+    }
+    for (unsigned int pitch = 0; pitch < 128; ++pitch)
+        peaks->snapped[pitch] = static_cast<int>(snap_to_key(pitch));
+    staged.peaks = peaks;
+}
 
-        fft_output = (fftw_complex*)malloc(block_size * sizeof(fftw_complex));
-        if (fft_output == nullptr)
-            throw std::runtime_error("Failed to allocate FFT output buffer.");
+template <class SampleType>
+void njones::audio::a2m::BasicConverter<SampleType>::determine_detector(
+    std::shared_ptr<const std::vector<njones::audio::a2m::PitchSegment>> segments) {
+    const auto& analysis = *staged.analysis;
 
-        fft_input = (double*)malloc(block_size * sizeof(double));
-        if (fft_input == nullptr)
-            throw std::runtime_error("Failed to allocate FFT input buffer.");
+    // The Goertzel bank only evaluates the segments of notes which can pass the pitch range.
+    auto wanted = std::make_shared<std::vector<njones::audio::a2m::PitchSegment>>();
+    size_t nbins = 0;
+    for (const auto& segment : *segments) {
+        const int pitch = segment.pitch + staged.transpose;
+        if (pitch >= static_cast<int>(staged.pitch_range[0]) && pitch <= static_cast<int>(staged.pitch_range[1])) {
+            wanted->push_back(segment);
+            nbins += segment.end - segment.begin;
+        }
+    }
 
-        fftw_destroy_plan(fft_plan);
-        fft_plan = fftw_plan_dft_r2c_1d(block_size, fft_input, fft_output, FFTW_ESTIMATE);
+    // A Goertzel filter takes a multiply and two additions per sample for one bin, a real FFT roughly
+    // log2(block_size) of them per sample for every bin, so that is where Auto switches over.
+    const size_t budget = analysis.levels.size() * (std::bit_width(analysis.block_size) - 1);
+    const bool use_goertzel =
+        staged.refinement == Refinement::None &&
+        (staged.detector == Detector::Goertzel || (staged.detector == Detector::Auto && nbins <= budget));
+    if (!use_goertzel || analysis.levels.empty()) {
+        staged.segments = segments;
+        staged.goertzel_bins = nullptr;
+        return;
     }
+
+    auto bins = std::make_shared<std::vector<std::vector<njones::audio::a2m::GoertzelBin>>>(analysis.levels.size());
+    for (const auto& segment : *wanted)
+        for (unsigned int bin = segment.begin; bin < segment.end; ++bin)
+            (*bins)[segment.level].emplace_back(bin, analysis.block_size);
+    staged.segments = wanted;
+    staged.goertzel_bins = bins;
 }
 
-template <class T, class C>
-static T nearest_value(T val, C arr) {
-    auto copy = arr;
-    std::sort(copy.begin(), copy.end());
+template <class SampleType>
+unsigned int njones::audio::a2m::BasicConverter<SampleType>::amplitude_to_velocity(const Settings& settings,
+                                                                                  const double amplitude) {
+    return std::min(127, static_cast<int>(127 * (amplitude / (settings.analysis->bins * settings.ceiling))));
+}
 
-    auto lower = std::lower_bound(copy.begin(), copy.end(), val);
-    auto upper = std::upper_bound(copy.begin(), copy.end(), val);
+template <class SampleType>
+void njones::audio::a2m::BasicConverter<SampleType>::reset(Accumulator& accumulator) {
+    for (unsigned int i = 0; i < 128; ++i) {
+        accumulator.notes[i].pitch = i;
+        accumulator.notes[i].amplitude = 0.0;
+        accumulator.notes[i].count = 0;
+    }
+    accumulator.active.fill(0);
+}
 
-    if (lower == copy.end() && upper == copy.end())
-        return arr.back();
-    else if (upper == copy.end())
-        return *lower;
-    else if (lower == copy.end())
-        return *upper;
-    else {
-        auto lower_diff = val - *lower;
-        auto upper_diff = *upper - val;
+template <class SampleType>
+void njones::audio::a2m::BasicConverter<SampleType>::accumulate(const Settings& settings,
+                                                                const Analysis& analysis,
+                                                                const unsigned int channel,
+                                                                Accumulator& accumulator) noexcept {
+    const auto time = instrumentation.start();
+    if (settings.peaks != nullptr) {
+        accumulate_peaks(settings, analysis, channel, accumulator);
+        instrumentation.stop(Stage::Accumulate, time);
+        return;
+    }
 
-        if (lower_diff < upper_diff)
-            return *lower;
-        return *upper;
+    for (const auto& segment : *settings.segments) {
+        const auto spectrum = reinterpret_cast<const SampleType*>(
+            analysis.fft_output + (segment.level * analysis.nchannels + channel) * analysis.output_stride);
+        const auto sum = magnitude_kernel(spectrum, segment.begin, segment.end);
+        if (sum.count > 0) [[likely]] {
+            auto& note = accumulator.notes[segment.pitch];
+            note.raw_pitch = segment.raw_pitch;
+            note.amplitude += sum.amplitude;
+            note.count += sum.count;
+            accumulator.active[segment.pitch >> 6] |= uint64_t(1) << (segment.pitch & 63);
+        }
     }
+    instrumentation.stop(Stage::Accumulate, time);
 }
 
-unsigned int njones::audio::a2m::Converter::snap_to_key(unsigned int pitch) {
-    if (pitch_set.size() > 0) {
-        unsigned int mod = pitch % 12;
-        pitch = (12 * (pitch / 12)) + nearest_value(mod, pitch_set);
+template <class SampleType>
+void njones::audio::a2m::BasicConverter<SampleType>::accumulate_peaks(const Settings& settings,
+                                                                      const Analysis& analysis,
+                                                                      const unsigned int channel,
+                                                                      Accumulator& accumulator) noexcept {
+    const auto& peaks = *settings.peaks;
+    const bool rectangular = settings.window == Window::Rectangular;
+
+    // A note takes the strongest of its peaks in this spectrum, so side lobes and split peaks which fall
+    // on the same note do not dilute its amplitude.
+    std::array<double, 128> strongest;
+    std::array<uint64_t, 2> seen{0, 0};
+
+    for (unsigned int level = 0; level < peaks.levels.size(); ++level) {
+        const auto& range = peaks.levels[level];
+        if (range.begin >= range.end)
+            continue;
+
+        const Complex* spectrum = analysis.fft_output + (level * analysis.nchannels + channel) * analysis.output_stride;
+        const auto power = [&](const unsigned int bin) {
+            return static_cast<double>(spectrum[bin][0]) * spectrum[bin][0] +
+                   static_cast<double>(spectrum[bin][1]) * spectrum[bin][1];
+        };
+
+        double previous = power(range.begin - 1);
+        double current = power(range.begin);
+        for (unsigned int bin = range.begin; bin < range.end; ++bin) {
+            const double next = power(bin + 1);
+            if (current > previous && current >= next) {
+                double offset = 0.0;
+                if (rectangular) {
+                    // Jacobsen's estimator, Re((X[k-1] - X[k+1]) / (2X[k] - X[k-1] - X[k+1])).
+                    const std::complex<double> a(spectrum[bin - 1][0], spectrum[bin - 1][1]);
+                    const std::complex<double> b(spectrum[bin][0], spectrum[bin][1]);
+                    const std::complex<double> c(spectrum[bin + 1][0], spectrum[bin + 1][1]);
+                    offset = std::real((a - c) / (2.0 * b - a - c));
+                } else if (previous > 0.0 && next > 0.0) {
+                    // A parabola through the log magnitudes, exact for a Gaussian shaped main lobe. The powers'
+                    // logs are twice the magnitudes', which cancels out.
+                    const double la = std::log(previous);
+                    const double lb = std::log(current);
+                    const double lc = std::log(next);
+                    offset = 0.5 * (la - lc) / (la - 2.0 * lb + lc);
+                }
+
+                const int raw_pitch = pitch_of((bin + std::clamp(offset, -1.0, 1.0)) * range.bin_width);
+                if (raw_pitch >= 0 && (range.pitches[raw_pitch >> 6] >> (raw_pitch & 63) & 1) != 0) {
+                    const int pitch = peaks.snapped[raw_pitch];
+                    const uint64_t bit = uint64_t(1) << (pitch & 63);
+                    const double amplitude = std::sqrt(current);
+                    auto& note = accumulator.notes[pitch];
+                    if ((seen[pitch >> 6] & bit) == 0) {
+                        seen[pitch >> 6] |= bit;
+                        strongest[pitch] = amplitude;
+                        note.raw_pitch = raw_pitch;
+                        note.amplitude += amplitude;
+                        note.count += 1;
+                        accumulator.active[pitch >> 6] |= bit;
+                    } else if (amplitude > strongest[pitch]) {
+                        note.raw_pitch = raw_pitch;
+                        note.amplitude += amplitude - strongest[pitch];
+                        strongest[pitch] = amplitude;
+                    }
+                }
+            }
+            previous = current;
+            current = next;
+        }
     }
-    int ret = pitch;
-    ret = std::min(ret, 127);
-    return std::max(0, ret);
 }
 
-namespace njones {
-namespace audio {
-namespace a2m {
-static struct Pitch { int pitch, raw_pitch; };
-}  // namespace a2m
-}  // namespace audio
-}  // namespace njones
+template <class SampleType>
+int njones::audio::a2m::BasicConverter<SampleType>::pitch_of(const double freq) const noexcept {
+    if (!(freq >= notes[0].low && freq < notes[127].high))
+        return -1;
 
-void njones::audio::a2m::Converter::set_logger(std::function<void(const std::string&)> cb) {
-    logger = cb;
+    // The nearest equal tempered pitch, corrected against the note table's bounds.
+    int pitch = std::clamp(static_cast<int>(std::lround(12.0 * std::log2(freq / notes[0].mid))), 0, 127);
+    if (freq < notes[pitch].low)
+        --pitch;
+    else if (freq >= notes[pitch].high)
+        ++pitch;
+    return pitch;
 }
 
-void njones::audio::a2m::Converter::log(const std::string& msg) {
-    logger(msg);
-}
+template <class SampleType>
+size_t njones::audio::a2m::BasicConverter<SampleType>::emit(const Settings& settings,
+                                                            Accumulator& accumulator,
+                                                            std::span<njones::audio::a2m::Note> notes) noexcept {
+    const auto time = instrumentation.start();
+    size_t limit = notes.size();
+    if (settings.note_count > 0)
+        limit = std::min(limit, static_cast<size_t>(settings.note_count));
 
-njones::audio::a2m::Pitch njones::audio::a2m::Converter::freq_to_pitch(const double freq) {
-    int pitch = 128;
-    int raw_pitch = 128;
-    for (auto& note : notes) {
-        if (note.second.low <= freq && freq <= note.second.high) {
-            raw_pitch = note.first;
-            pitch = snap_to_key(note.first);
-            break;
+    // Detected notes are written straight into the output in pitch order and the loudest are selected in
+    // place afterwards. Should the output be too small to hold every note it becomes a min-heap on velocity,
+    // so each further note only displaces the quietest one kept so far.
+    size_t count = 0;
+    size_t below_activation = 0;
+    size_t out_of_range = 0;
+    size_t detected = 0;
+    bool heap = false;
+
+    // Output stores may alias settings, so the fields read per note are loaded once up front.
+    const int transpose = settings.transpose;
+    const int low = static_cast<int>(settings.pitch_range[0]);
+    const int high = static_cast<int>(settings.pitch_range[1]);
+    const unsigned int velocity_limit = settings.velocity_limit;
+
+    for (unsigned int word = 0; word < accumulator.active.size(); ++word) {
+        uint64_t bits = accumulator.active[word];
+        uint64_t kept = 0;
+        while (bits != 0) {
+            const unsigned int bit = std::countr_zero(bits);
+            bits &= bits - 1;
+
+            auto& note = accumulator.notes[word * 64 + bit];
+            const int new_pitch = note.pitch + transpose;
+            if (new_pitch < low || new_pitch > high) {
+                kept |= uint64_t(1) << bit;
+                ++out_of_range;
+                continue;
+            }
+
+            const unsigned int velocity = amplitude_to_velocity(settings, note.amplitude / note.count);
+            const auto new_note = njones::audio::a2m::Note(new_pitch, note.raw_pitch + transpose, velocity);
+            note.count = 0;
+            note.amplitude = 0.0;
+
+            if (new_note.velocity <= velocity_limit) {
+                ++below_activation;
+                continue;
+            }
+
+            ++detected;
+            if (count < notes.size()) {
+                notes[count++] = new_note;
+            } else if (count > 0) {
+                if (!heap) {
+                    std::make_heap(notes.begin(), notes.end(), std::greater<>());
+                    heap = true;
+                }
+                if (new_note > notes.front()) {
+                    std::pop_heap(notes.begin(), notes.end(), std::greater<>());
+                    notes.back() = new_note;
+                    std::push_heap(notes.begin(), notes.end(), std::greater<>());
+                }
+            }
         }
+        accumulator.active[word] = kept;
+    }
+
+    // Notes are ordered by velocity whenever the output is limited, keeping the loudest ones.
+    if (count > limit) {
+        std::nth_element(notes.begin(), notes.begin() + limit, notes.begin() + count, std::greater<>());
+        count = limit;
     }
-    return Pitch{pitch, raw_pitch};
+    if (settings.note_count > 0 || heap)
+        std::sort(notes.begin(), notes.begin() + count, std::greater<>());
+
+    instrumentation.stop(Stage::Select, time);
+    instrumentation.notes(count, below_activation, out_of_range, detected - count);
+    return count;
 }
 
-unsigned int njones::audio::a2m::Converter::amplitude_to_velocity(const double amplitude) {
-    return std::min(127, static_cast<int>(127 * (amplitude / (bins * ceiling))));
+// Writes one hop of src into a circular channel buffer starting at position, scaled by gain
+// and either replacing or adding to what is already there.
+template <class SampleType>
+static void load_hop(SampleType* dest,
+                     const size_t position,
+                     const size_t head,
+                     const SampleType* src,
+                     const size_t hop_size,
+                     const SampleType gain,
+                     const bool add) {
+    if (!add && gain == 1) {
+        memcpy(dest + position, src, sizeof(SampleType) * head);
+        memcpy(dest, src + head, sizeof(SampleType) * (hop_size - head));
+    } else if (!add) {
+        for (size_t i = 0; i < head; ++i)
+            dest[position + i] = gain * src[i];
+        for (size_t i = head; i < hop_size; ++i)
+            dest[i - head] = gain * src[i];
+    } else {
+        for (size_t i = 0; i < head; ++i)
+            dest[position + i] += gain * src[i];
+        for (size_t i = head; i < hop_size; ++i)
+            dest[i - head] += gain * src[i];
+    }
 }
 
-std::vector<njones::audio::a2m::Note> njones::audio::a2m::Converter::freqs_to_notes() {
-    std::vector<njones::audio::a2m::Note> ret;
+// Unrolls a circular buffer into input in time order, starting at its oldest sample, and applies the window.
+template <class SampleType>
+static void unroll_history(SampleType* input,
+                           const SampleType* history,
+                           const size_t oldest,
+                           const SampleType* window,
+                           const size_t block_size) {
+    const size_t tail = block_size - oldest;
+    for (size_t i = 0; i < tail; ++i)
+        input[i] = window[i] * history[oldest + i];
+    for (size_t i = tail; i < block_size; ++i)
+        input[i] = window[i] * history[i - tail];
+}
 
-    for (const auto& freq : frequencies) {
-        if (freq.second > 0.0) [[likely]] {
-            auto pitch = freq_to_pitch(freq.first);
-            auto& note = accumulator[pitch.pitch];
-            note.raw_pitch = pitch.raw_pitch;
-            note.amplitude += freq.second;
-            note.count += 1;
+template <class SampleType>
+void njones::audio::a2m::BasicConverter<SampleType>::samples_to_freqs(const Settings& settings,
+                                                                      SampleType* const* channels,
+                                                                      const size_t nchannels,
+                                                                      const bool mix,
+                                                                      const bool transform) noexcept {
+    auto& analysis = *settings.analysis;
+    if (analysis.fft_plan == nullptr)
+        return;
+
+    auto time = instrumentation.start();
+    const size_t block_size = analysis.block_size;
+    const size_t hop_size = settings.hop_size == 0 ? block_size : std::min<size_t>(settings.hop_size, block_size);
+    const size_t outputs = mix ? 1 : std::min<size_t>(nchannels, analysis.nchannels);
+    const SampleType gain = mix ? SampleType(1) / nchannels : SampleType(1);
+    const auto window = settings.window_coefficients->data();
+    auto& top = analysis.levels[0];
+
+    // The newest hop of every channel as one or two runs of contiguous samples, which feed the next level.
+    const size_t position = top.history_position;
+    const bool direct = hop_size == block_size && settings.window == Window::Rectangular;
+    const size_t head = direct ? block_size : std::min(hop_size, block_size - position);
+    const size_t nlevels = analysis.levels.size();
+    if (!transform && direct && nlevels == 1)
+        return;
+
+    if (direct) {
+        for (size_t channel = 0; channel < outputs; ++channel) {
+            auto dest = analysis.fft_input + channel * block_size;
+            if (mix)
+                for (size_t source = 0; source < nchannels; ++source)
+                    load_hop(dest, 0, block_size, channels[source], block_size, gain, source > 0);
+            else
+                load_hop(dest, 0, block_size, channels[channel], block_size, gain, false);
         }
+    } else {
+        // The newest hop overwrites the oldest samples in place and the window is applied while
+        // unrolling the circular history into the FFT input, so the history is never shifted.
+        for (size_t channel = 0; channel < outputs; ++channel) {
+            auto history = analysis.history.data() + channel * block_size;
+            if (mix)
+                for (size_t source = 0; source < nchannels; ++source)
+                    load_hop(history, position, head, channels[source], hop_size, gain, source > 0);
+            else
+                load_hop(history, position, head, channels[channel], hop_size, gain, false);
+        }
+        top.history_position = (position + hop_size) % block_size;
+
+        for (size_t channel = 0; channel < outputs; ++channel)
+            unroll_history(analysis.fft_input + channel * block_size, analysis.history.data() + channel * block_size,
+                           top.history_position, window, block_size);
     }
 
-    for (auto& note : accumulator) {
-        const int new_pitch = note.pitch + transpose;
-        if (note.count > 0 && new_pitch >= pitch_range[0] && new_pitch <= pitch_range[1]) {
-            auto new_note = njones::audio::a2m::Note(new_pitch, note.raw_pitch + transpose,
-                                                     amplitude_to_velocity(note.amplitude / note.count));
-            if (new_note.velocity > velocity_limit) {
-                ret.push_back(new_note);
+    // Each further level low pass filters and decimates what the level above received this block into its
+    // own circular history, which is unrolled like that of level 0.
+    for (size_t channel = 0; channel < outputs && nlevels > 1; ++channel) {
+        const SampleType* hop = direct ? analysis.fft_input + channel * block_size
+                                       : analysis.history.data() + channel * block_size + position;
+        const SampleType* wrapped = analysis.history.data() + channel * block_size;
+
+        for (size_t index = 1; index < nlevels; ++index) {
+            auto& level = analysis.levels[index];
+            auto& decimator = analysis.decimators[(index - 1) * analysis.nchannels + channel];
+            if (index == 1) {
+                level.ndecimated = decimator.process(hop, head, level.decimated.data());
+                level.ndecimated +=
+                    decimator.process(wrapped, hop_size - head, level.decimated.data() + level.ndecimated);
+            } else {
+                const auto& above = analysis.levels[index - 1];
+                level.ndecimated = decimator.process(above.decimated.data(), above.ndecimated, level.decimated.data());
             }
-            note.count = 0;
-            note.amplitude = 0.0;
+
+            auto history = analysis.history.data() + (index * analysis.nchannels + channel) * block_size;
+            load_hop(history, level.history_position, std::min(level.ndecimated, block_size - level.history_position),
+                     level.decimated.data(), level.ndecimated, SampleType(1), false);
+        }
+    }
+    for (size_t index = 1; index < nlevels; ++index) {
+        auto& level = analysis.levels[index];
+        level.history_position = (level.history_position + level.ndecimated) % block_size;
+        for (size_t channel = 0; channel < outputs; ++channel) {
+            const size_t offset = (index * analysis.nchannels + channel) * block_size;
+            unroll_history(analysis.fft_input + offset, analysis.history.data() + offset, level.history_position,
+                           window, block_size);
         }
     }
 
-    if (note_count > 0) {
-        std::sort(ret.begin(), ret.end(), std::greater<>());
-        std::vector<njones::audio::a2m::Note> slice;
-        if (ret.size() >= note_count)
-            std::copy(ret.begin(), ret.begin() + note_count, std::back_inserter(slice));
-        else
-            slice = ret;
-        return slice;
+    time = instrumentation.stop(Stage::Load, time);
+    if (!transform)
+        return;
+
+    if (settings.goertzel_bins != nullptr) {
+        const auto& bins = *settings.goertzel_bins;
+        for (size_t index = 0; index < nlevels; ++index)
+            for (size_t channel = 0; channel < outputs; ++channel) {
+                const size_t slot = index * analysis.nchannels + channel;
+                njones::audio::a2m::goertzel<SampleType>(
+                    analysis.fft_input + slot * block_size, block_size, bins[index],
+                    reinterpret_cast<SampleType*>(analysis.fft_output + slot * analysis.output_stride));
+            }
     } else
-        return ret;
+        analysis.fft_plan->execute(analysis.fft_input, analysis.fft_output);
+    instrumentation.stop(Stage::Fft, time);
+}
+
+// Counts one event on a counter which only the converting thread writes, without a locked instruction.
+static void count_block(std::atomic<uint64_t>& counter) {
+    counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+// Whether two levels differ by no more than tolerance relative to the larger.
+static bool within(const double a, const double b, const double tolerance) {
+    return fabs(a - b) <= tolerance * std::max(a, b);
+}
+
+template <class SampleType>
+typename njones::audio::a2m::BasicConverter<SampleType>::Gated njones::audio::a2m::BasicConverter<SampleType>::gate(
+    const Settings& settings,
+    SampleType* const* channels,
+    const size_t nchannels,
+    const bool stationarity) noexcept {
+    count_block(gated_blocks);
+    const bool reuse = stationarity && settings.stationarity > 0.0 && settings.reused_frame != nullptr;
+    const auto& analysis = *settings.analysis;
+    if ((!settings.silence_gate && !reuse) || analysis.fft_plan == nullptr)
+        return Gated::Analyse;
+
+    const size_t block_size = analysis.block_size;
+    const size_t hop_size = settings.hop_size == 0 ? block_size : std::min<size_t>(settings.hop_size, block_size);
+    auto levels = BlockLevels{0.0, 0.0, 0.0};
+    for (size_t channel = 0; channel < nchannels; ++channel) {
+        const auto measured = njones::audio::a2m::measure_block(channels[channel], hop_size);
+        levels.peak = std::max(levels.peak, measured.peak);
+        levels.energy += measured.energy;
+        levels.slope_energy += measured.slope_energy;
+    }
+
+    if (settings.silence_gate) {
+        // A bin of a block of n samples, windowed or not, has a magnitude of at most n times the block's peak
+        // sample, and a note's velocity is 127 times its mean magnitude over n / 2 times the ceiling. Each
+        // decimation can raise the peak by the sum of the half-band filter's coefficient magnitudes, 1.44.
+        // Mixing channels averages them, which never raises the peak.
+        const size_t nlevels = analysis.levels.size();
+        double floor = settings.velocity_limit * settings.ceiling / 254.0;
+        size_t span = block_size;
+        for (size_t level = 1; level < nlevels; ++level) {
+            floor /= 1.5;
+            span = 2 * span + HalfBandDecimator<SampleType>::taps;
+        }
+
+        gate_state.quiet_run = levels.peak < floor ? gate_state.quiet_run + hop_size : 0;
+        if (gate_state.quiet_run >= span) {
+            count_block(silent_blocks);
+            gate_state.reusable = reuse;
+            gate_state.reused = 0;
+            gate_state.reference = levels;
+            return Gated::Silent;
+        }
+    }
+
+    if (reuse) {
+        const auto& reference = gate_state.reference;
+        if (gate_state.reusable && gate_state.reused < settings.max_reused_blocks &&
+            within(levels.energy, reference.energy, settings.stationarity) &&
+            within(levels.slope_energy, reference.slope_energy, settings.stationarity)) {
+            ++gate_state.reused;
+            count_block(stationary_blocks);
+            return Gated::Stationary;
+        }
+    }
+
+    gate_state.reusable = reuse;
+    gate_state.reused = 0;
+    gate_state.reference = levels;
+    return Gated::Analyse;
+}
+
+template <class SampleType>
+std::vector<njones::audio::a2m::Note> njones::audio::a2m::BasicConverter<SampleType>::convert(SampleType* samples) {
+    std::array<njones::audio::a2m::Note, 128> notes;
+    const size_t count = convert(samples, notes);
+    return std::vector<njones::audio::a2m::Note>(notes.begin(), notes.begin() + count);
 }
 
-void njones::audio::a2m::Converter::samples_to_freqs(double* samples) {
-    memcpy(fft_input, samples, sizeof(double) * block_size);
-    fftw_execute(fft_plan);
-    for (size_t i = min_bin; i < max_bin; ++i)
-        frequencies[i - min_bin] = {bin_freqs[i], sqrt(pow(fft_output[i][0], 2) + pow(fft_output[i][1], 2))};
+template <class SampleType>
+size_t njones::audio::a2m::BasicConverter<SampleType>::convert(SampleType* samples,
+                                                               std::span<njones::audio::a2m::Note> notes) noexcept {
+    const auto start = instrumentation.start();
+    acquire();
+    const Settings& settings = *active;
+    const Gated gated = gate(settings, &samples, 1, true);
+    samples_to_freqs(settings, &samples, 1, false, gated == Gated::Analyse);
+    const size_t count = reduce(settings, gated, *settings.analysis, 0, notes);
+    instrumentation.block(start);
+    return count;
+}
+
+template <class SampleType>
+size_t njones::audio::a2m::BasicConverter<SampleType>::reduce(const Settings& settings,
+                                                              const Gated gated,
+                                                              const Analysis& analysis,
+                                                              const unsigned int channel,
+                                                              std::span<njones::audio::a2m::Note> notes) noexcept {
+    size_t count = 0;
+    if (gated == Gated::Analyse) {
+        accumulate(settings, analysis, channel, accumulator);
+        count = emit(settings, accumulator, notes);
+    } else if (gated == Gated::Stationary) {
+        count = std::min(gate_state.reused_count, notes.size());
+        std::copy_n(settings.reused_frame->begin(), count, notes.begin());
+    }
+
+    if (settings.reused_frame != nullptr && gated != Gated::Stationary) {
+        gate_state.reused_count = count;
+        std::copy_n(notes.begin(), count, settings.reused_frame->begin());
+    }
+    return count;
 }
 
-std::vector<njones::audio::a2m::Note> njones::audio::a2m::Converter::convert(double* samples) {
-    std::lock_guard<std::recursive_mutex> guard(lock);
-    samples_to_freqs(samples);
-    return freqs_to_notes();
+// The input and output of one tile of convert_blocks() are kept within a typical L2 cache.
+static constexpr size_t batch_bytes = 256 * 1024;
+
+template <class SampleType>
+size_t njones::audio::a2m::BasicConverter<SampleType>::convert_blocks(const SampleType* samples,
+                                                                      const size_t nblocks,
+                                                                      njones::audio::a2m::NoteSink& sink) {
+    const size_t first = sink.size();
+    std::array<njones::audio::a2m::Note, 128> found;
+    size_t block = 0;
+
+    acquire();
+    const Settings& settings = *active;
+    const auto& analysis = *settings.analysis;
+    const size_t block_size = analysis.block_size;
+    const size_t hop_size = settings.hop_size == 0 ? block_size : std::min<size_t>(settings.hop_size, block_size);
+
+    // Blocks only depend on their own samples without a hop or octave levels, so they may be transformed
+    // together. Each block is one channel of the batch analysis.
+    if (analysis.fft_plan != nullptr && hop_size == block_size && analysis.levels.size() == 1 &&
+        settings.goertzel_bins == nullptr) {
+        const size_t tile = std::max<size_t>(1, batch_bytes / (2 * block_size * sizeof(SampleType)));
+        if (batch == nullptr || batch->samplerate != analysis.samplerate || batch->block_size != block_size ||
+            batch->nchannels != tile)
+            batch = std::make_unique<Analysis>(analysis.samplerate, block_size, tile, 1, false, notes);
+
+        const auto window = settings.window_coefficients->data();
+        for (; block + tile <= nblocks; block += tile) {
+            const auto tile_start = instrumentation.start();
+            auto time = tile_start;
+            const SampleType* src = samples + block * block_size;
+            if (settings.window == Window::Rectangular)
+                std::copy_n(src, tile * block_size, batch->fft_input);
+            else
+                for (size_t j = 0; j < tile; ++j)
+                    for (size_t i = 0; i < block_size; ++i)
+                        batch->fft_input[j * block_size + i] = window[i] * src[j * block_size + i];
+            time = instrumentation.stop(Stage::Load, time);
+            batch->fft_plan->execute(batch->fft_input, batch->fft_output);
+            time = instrumentation.stop(Stage::Fft, time);
+
+            // Each block's latency is its own reduction plus an even share of the tile's load and transform.
+            const int64_t shared_ns = (time.ns - tile_start.ns) / static_cast<int64_t>(tile);
+            // Blocks the gates skip are transformed with the rest of the tile but never reduced. Without a
+            // hop or octave levels there is no history for them to feed.
+            for (size_t j = 0; j < tile; ++j) {
+                const auto start = instrumentation.start();
+                SampleType* channel = const_cast<SampleType*>(src + j * block_size);
+                const Gated gated = gate(settings, &channel, 1, true);
+                const size_t count = reduce(settings, gated, *batch, j, found);
+                for (size_t i = 0; i < count; ++i)
+                    sink.push_back(njones::audio::a2m::BlockNote{block + j, found[i]});
+                instrumentation.block(Instrumentation::Timestamp{start.ns - shared_ns, start.cycles});
+            }
+        }
+    }
+
+    // convert() may retire settings, so only the hop size computed above is used from here on.
+    // It never writes to samples.
+    for (; block < nblocks; ++block) {
+        const size_t count = convert(const_cast<SampleType*>(samples + block * hop_size), found);
+        for (size_t i = 0; i < count; ++i)
+            sink.push_back(njones::audio::a2m::BlockNote{block, found[i]});
+    }
+    return sink.size() - first;
 }
+
+template class njones::audio::a2m::BasicConverter<double>;
+template class njones::audio::a2m::BasicConverter<float>;
@@ -1,10 +1,21 @@
-#include <fftw3.h>
+#pragma once
+#include <njones/a2m/decimator.h>
+#include <njones/a2m/fft.h>
+#include <njones/a2m/gate.h>
+#include <njones/a2m/goertzel.h>
+#include <njones/a2m/instrumentation.h>
+#include <njones/a2m/magnitude.h>
 #include <njones/a2m/notes.h>
+#include <njones/a2m/plan_cache.h>
+#include <njones/a2m/window.h>
 #include <stddef.h>
 #include <array>
+#include <atomic>
 #include <chrono>
 #include <functional>
+#include <memory>
 #include <mutex>
+#include <span>
 #include <vector>
 
 namespace njones {
@@ -14,30 +25,110 @@ namespace a2m {
  * @brief A MIDI note event representation containing the pitch and velocity.
  */
 struct Note {
-    Note();
-    Note(const unsigned int pitch, const unsigned int raw_pitch, const unsigned int velocity);
+    // Defined inline so header-only converters and the sorts over notes do not pay a call per note.
+    Note() : pitch(0), velocity(0), count(0) {}
+    Note(const unsigned int pitch, const unsigned int raw_pitch, const unsigned int velocity)
+        : pitch(pitch), raw_pitch(raw_pitch), velocity(velocity), count(0) {}
     Note(const Note& rhs) = default;
     Note(Note&& rhs) = default;
 
     Note& operator=(const Note& rhs) = default;
     Note& operator=(Note&& rhs) = default;
-    bool operator<(const Note& rhs) const;
-    bool operator>(const Note& rhs) const;
-    bool operator==(const Note& rhs) const;
+    bool operator<(const Note& rhs) const { return velocity < rhs.velocity; }
+    bool operator>(const Note& rhs) const { return velocity > rhs.velocity; }
+    bool operator==(const Note& rhs) const { return pitch == rhs.pitch; }
 
     unsigned int pitch;
     unsigned int raw_pitch;
     unsigned int velocity;
     unsigned int count;
 };
-struct Pitch;
+
+/**
+ * @brief A note found by BasicConverter::convert_blocks(), tagged with the index of its block in the batch.
+ */
+struct BlockNote {
+    size_t block;
+    Note note;
+};
+
+/**
+ * @brief The flat output of BasicConverter::convert_blocks(), ordered by block. A sink reused across
+ * batches stops allocating once it has grown to hold the largest one.
+ */
+typedef std::vector<BlockNote> NoteSink;
+
+/**
+ * @brief A run of consecutive FFT bins [begin, end) of one octave level which all map to the same snapped
+ * and unsnapped MIDI pitch.
+ */
+struct PitchSegment {
+    unsigned int begin;
+    unsigned int end;
+    int pitch;
+    int raw_pitch;
+    unsigned int level;
+};
+
+/**
+ * @brief The bin frequencies and analysable bin range of one samplerate and block size. Immutable and
+ * shared by every converter, and every octave level, with the same layout.
+ */
+struct BinLayout {
+    BinLayout(const double samplerate, const unsigned int block_size, const note_table& notes);
+
+    /**
+     * @brief Returns the layout shared by every converter analysing samplerate and block_size right now,
+     * building it if there is none.
+     */
+    static std::shared_ptr<const BinLayout> shared(const double samplerate,
+                                                   const unsigned int block_size,
+                                                   const note_table& notes);
+
+    double samplerate;
+    std::chrono::milliseconds time_window;
+    double min_freq;
+    double max_freq;
+    unsigned int min_bin;
+    unsigned int max_bin;
+    std::vector<double> bin_freqs;
+};
+
+/**
+ * @brief How a converter measures the spectrum of a block.
+ */
+enum class Detector {
+    // Goertzel whenever the notes allowed by pitch_range need few enough bins to beat the FFT.
+    Auto,
+    // A real FFT of every block, evaluating all bins.
+    Fft,
+    // A bank of Goertzel filters evaluating only the bins of notes allowed by pitch_range.
+    Goertzel
+};
+
+/**
+ * @brief How a converter maps the spectrum of a block to pitches.
+ */
+enum class Refinement {
+    // Every bin counts towards the note whose range holds the bin's centre frequency, so pitch accuracy is
+    // bounded by the bin width of samplerate / block_size.
+    None,
+    // Every spectral peak counts towards the note holding its frequency, estimated between bins from the
+    // peak's neighbours. The estimate is exact for a single tone through a rectangular window (Jacobsen's
+    // estimator) and within a few hundredths of a bin for the other windows (Gaussian interpolation).
+    Peaks
+};
 
 /**
  * @brief An FFT to MIDI note converter that analyzes a block of samples
  * and maps the frequency data to the 12 tone equal temperment scale.
- * Time related parameter setting is supported and is thread safe.
+ * Parameters may be changed from any thread while convert() runs on another. Each change is
+ * published as an immutable snapshot which convert() picks up at the next block boundary without
+ * taking a lock, so expensive work such as FFT planning never stalls the audio thread.
+ * @tparam SampleType The sample and FFT precision, either float or double.
  */
-class Converter {
+template <class SampleType>
+class BasicConverter {
    public:
     /**
      * @param samplerate The samplerate of the audio data passed into convert.
@@ -50,22 +141,46 @@ class Converter {
      * @param transpose The constant integer by which generated notes should be transposed in the range [-127, 127].
      * @param ceiling The amplitude ceiling for generated notes in the range [0, 1].
      */
-    Converter(const unsigned int samplerate,
-              const unsigned int block_size,
-              const double activation_level = 0.0,
-              const std::vector<unsigned int> pitch_set = std::vector<unsigned int>{},
-              const std::array<unsigned int, 2> pitch_range = std::array<unsigned int, 2>{0, 127},
-              const unsigned int note_count = 0,
-              const int transpose = 0,
-              const double ceiling = 1.0);
-    ~Converter();
+    BasicConverter(const unsigned int samplerate,
+                   const unsigned int block_size,
+                   const double activation_level = 0.0,
+                   const std::vector<unsigned int> pitch_set = std::vector<unsigned int>{},
+                   const std::array<unsigned int, 2> pitch_range = std::array<unsigned int, 2>{0, 127},
+                   const unsigned int note_count = 0,
+                   const int transpose = 0,
+                   const double ceiling = 1.0);
+    ~BasicConverter();
 
     /**
      * @brief Converts a block of samples into a2m::Note instances.
-     * @param samples
+     * @param samples block_size samples, or hop_size samples once a hop size has been set.
      * @return
      */
-    std::vector<Note> convert(double* samples);
+    std::vector<Note> convert(SampleType* samples);
+
+    /**
+     * @brief Converts a block of samples into a2m::Note instances written to a caller owned buffer.
+     * Performs no heap allocation, never blocks and never throws, so it is safe to call from an
+     * audio callback. Must not be called from more than one thread at a time.
+     * @param samples block_size samples, or hop_size samples once a hop size has been set.
+     * @param notes The destination buffer. When it is smaller than the number of detected notes
+     * the notes with the highest velocities are kept.
+     * @return The number of notes written to the front of notes.
+     */
+    size_t convert(SampleType* samples, std::span<Note> notes) noexcept;
+
+    /**
+     * @brief Converts nblocks consecutive blocks for offline work, producing the notes convert() would
+     * for each in turn. Without a hop, octave levels or the Goertzel detector, whole tiles of blocks
+     * sized to stay in cache are transformed by one batched FFT and then reduced to notes block by
+     * block; the blocks left over and every other configuration go through convert(). The gates judge
+     * each block as convert() would, though a tile's skipped blocks are still transformed. Parameter
+     * changes take effect at the next call. May allocate, so it is not meant for an audio callback.
+     * @param samples nblocks * block_size samples, or nblocks * hop_size once a hop size has been set.
+     * @param sink Receives the notes of every block, appended in block order.
+     * @return The number of notes appended.
+     */
+    size_t convert_blocks(const SampleType* samples, const size_t nblocks, NoteSink& sink);
 
     void set_logger(std::function<void(const std::string&)> cb);
     void set_samplerate(const unsigned int samplerate);
@@ -76,54 +191,303 @@ class Converter {
     void set_note_count(const int note_count);
     void set_transpose(const int transpose);
     void set_ceiling(const double ceiling);
+    /**
+     * @brief Enables overlapping analysis. Each call to convert() then consumes hop_size new samples
+     * and analyses the most recent block_size samples, producing a note frame every hop_size samples.
+     * @param hop_size The number of samples per call in the range [1, block_size], or 0 for
+     * non-overlapping blocks.
+     */
+    void set_hop_size(const unsigned int hop_size);
+    void set_window(const Window window);
+    /**
+     * @brief Analyses the lower octaves at a finer frequency resolution without growing the FFT.
+     * Level 0 transforms the input as before and every further level transforms the input low pass
+     * filtered and decimated by another factor of two, using the same block size. Each note is taken
+     * from the first level whose bins are no wider than the note, so the low notes resolve with
+     * levels transforms of block_size rather than one of block_size * 2^(levels - 1), although the
+     * last level still spans as much time as that larger block.
+     * @param levels The number of levels in the range [1, max_octave_levels], 1 for a single FFT.
+     */
+    void set_octave_levels(const unsigned int levels);
+    /**
+     * @brief Selects how the spectrum is measured. The Goertzel bank produces the same magnitudes as
+     * the FFT but costs time in proportion to the number of bins it evaluates, so it pays off for a
+     * narrow pitch_range and makes small hop sizes cheap. Detector::Auto, the default, switches
+     * between the two whenever the pitch range, transpose, block size or levels change.
+     */
+    void set_detector(const Detector detector);
+    /**
+     * @brief Selects how bins map to pitches. Refinement::Peaks identifies a tone's note accurately from
+     * bins several semitones wide, so blocks can be a fraction of the size otherwise needed to place low
+     * notes, cutting latency and FFT cost alike. Tones closer together than about two bins still merge
+     * into one peak, and within two bins of DC a tone's mirror image at the negative frequency skews the
+     * estimate. Peaks are found in the full FFT, so the Goertzel detector is not used.
+     */
+    void set_refinement(const Refinement refinement);
+    /**
+     * @brief Skips the FFT and note mapping of blocks too quiet to produce a note. A block is skipped once
+     * every sample the analysis covers, on every octave level, is below the level at which even a bin
+     * holding all of the block's energy stays at or below activation_level, so the gate never changes the
+     * notes produced. The samples are still taken into the history, and a skipped block produces no notes.
+     */
+    void set_silence_gate(const bool enabled);
+    /**
+     * @brief Repeats the previous frame's notes for blocks whose energy and slope energy are within
+     * tolerance of those of the last block analysed in full, for at most max_reused_blocks blocks in a
+     * row. Unlike the silence gate this is a heuristic: a change of notes which keeps the loudness and
+     * brightness of the block is only picked up by the next full analysis. Multi-channel converters only
+     * use the silence gate.
+     * @param tolerance The relative change in [0.0, 1.0] still considered stationary, 0.0 to disable.
+     */
+    void set_stationarity(const double tolerance, const unsigned int max_reused_blocks = 8);
+    /**
+     * @brief Counts the blocks converted and the blocks the gates spared a full analysis. May be called
+     * from any thread.
+     */
+    GateCounters get_gate_counters() const;
+
+    static constexpr unsigned int max_octave_levels = 16;
+
+    /**
+     * @brief Reads the per-stage timings, block latency histogram and note counters.
+     * May be called from any thread. All zeros unless built with A2M_INSTRUMENTATION.
+     */
+    InstrumentationSnapshot get_instrumentation() const;
 
    protected:
+    typedef typename FFT<SampleType>::complex Complex;
+
     struct AccummulatedNote {
         unsigned int pitch;
         unsigned int raw_pitch;
         double amplitude;
         size_t count;
     };
+    /**
+     * @brief Per-pitch sums plus a 128 bit mask of the pitches holding a non zero count, so emitting
+     * and clearing cost scales with the number of active pitches rather than all 128.
+     */
+    struct Accumulator {
+        std::array<AccummulatedNote, 128> notes;
+        std::array<uint64_t, 2> active;
+    };
+
+    /**
+     * @brief Selects how many signals a converter transforms per block.
+     */
+    struct Channels {
+        unsigned int count;
+    };
 
-    std::array<AccummulatedNote, 128> accumulator;
-    std::vector<std::pair<double, double>> frequencies;
-    double* fft_input;
-    fftw_complex* fft_output;
-    fftw_plan fft_plan;
+    /**
+     * @brief The bin layout and decimation state of one octave level. Level 0 analyses the input as is,
+     * every further level the output of one more half-band decimator, so its bins are half as wide and
+     * its blocks span twice as much time as those of the level above.
+     */
+    struct Level {
+        Level(std::shared_ptr<const BinLayout> layout);
 
-    unsigned int samplerate;
-    unsigned int block_size;
-    unsigned int bins;
-    std::chrono::milliseconds time_window;
-    double activation_level;
-    unsigned int note_count;
-    unsigned int velocity_limit;
-    double ceiling;
-    int transpose;
-    std::vector<unsigned int> pitch_set;
-    std::array<unsigned int, 2> pitch_range;
-    note_map notes;
-    double min_freq;
-    double max_freq;
-    unsigned int min_bin;
-    unsigned int max_bin;
-    std::vector<double> bin_freqs;
+        std::shared_ptr<const BinLayout> layout;
+        size_t history_position;
+        // The samples the level's decimator produced from the last block of one channel.
+        std::vector<SampleType> decimated;
+        size_t ndecimated;
+    };
+
+    /**
+     * @brief The FFT plan, buffers and bin layout for one samplerate, block size and level count.
+     * Built by the parameter setters; the buffers are only touched by the thread calling convert().
+     * Every level of every channel is stored level-major, then channel-major, and transformed by a
+     * single batched plan. The plan and bin layouts are shared with other converters, the buffers are
+     * sized to what the configuration reads.
+     */
+    struct Analysis {
+        /**
+         * @param hopping Whether level 0 keeps a history for overlapping or windowed analysis.
+         */
+        Analysis(const unsigned int samplerate,
+                 const unsigned int block_size,
+                 const unsigned int nchannels,
+                 const unsigned int nlevels,
+                 const bool hopping,
+                 const note_table& notes);
+        ~Analysis();
+
+        unsigned int samplerate;
+        unsigned int block_size;
+        unsigned int nchannels;
+        unsigned int output_stride;
+        unsigned int bins;
+        std::vector<Level> levels;
+        SampleType* fft_input;
+        Complex* fft_output;
+        std::shared_ptr<const Plan<SampleType>> fft_plan;
+        // A circular buffer of the most recent block_size samples per level and channel. Level 0 only uses
+        // it when hopping or windowing, so it is empty for a single level analysed block by block.
+        std::vector<SampleType> history;
+        // One decimator per channel for each level after the first.
+        std::vector<HalfBandDecimator<SampleType>> decimators;
+
+       private:
+        Analysis(const Analysis&) = delete;
+        Analysis(Analysis&&) = delete;
+    };
+
+    /**
+     * @brief The bins peak refinement searches on each level, the pitches each level is responsible for
+     * and the snapped pitch of every raw pitch.
+     */
+    struct PeakMap {
+        struct Range {
+            unsigned int begin;
+            unsigned int end;
+            double bin_width;
+            std::array<uint64_t, 2> pitches;
+        };
+
+        std::vector<Range> levels;
+        std::array<int, 128> snapped;
+    };
+
+    /**
+     * @brief What the gates know about the blocks before this one. Owned by the converting thread.
+     */
+    struct GateState {
+        // The number of consecutive samples up to the last block below the silence floor.
+        size_t quiet_run;
+        // The levels of the last block analysed in full, which later blocks are compared with.
+        BlockLevels reference;
+        unsigned int reused;
+        // The number of notes in the reused frame, or none when there is no frame to reuse yet.
+        size_t reused_count;
+        bool reusable;
+    };
+
+    enum class Gated { Analyse, Silent, Stationary };
+
+    /**
+     * @brief An immutable snapshot of every conversion parameter.
+     */
+    struct Settings {
+        double activation_level;
+        unsigned int velocity_limit;
+        unsigned int note_count;
+        double ceiling;
+        int transpose;
+        std::vector<unsigned int> pitch_set;
+        std::array<unsigned int, 2> pitch_range;
+        unsigned int hop_size;
+        unsigned int octave_levels;
+        Detector detector;
+        Refinement refinement;
+        Window window;
+        std::shared_ptr<const std::vector<SampleType>> window_coefficients;
+        std::shared_ptr<Analysis> analysis;
+        std::shared_ptr<const std::vector<PitchSegment>> segments;
+        // The bins evaluated per level when the Goertzel bank replaces the FFT, otherwise null.
+        std::shared_ptr<const std::vector<std::vector<GoertzelBin>>> goertzel_bins;
+        // Where peak refinement searches each level, null unless refinement is Refinement::Peaks.
+        std::shared_ptr<const PeakMap> peaks;
+        bool silence_gate;
+        double stationarity;
+        unsigned int max_reused_blocks;
+        // The notes of the last frame analysed in full, which stationary blocks repeat. Null unless
+        // stationarity is enabled, and only touched by the converting thread.
+        std::shared_ptr<std::array<Note, 128>> reused_frame;
+        Settings* retired_next;
+    };
+
+    unsigned int analysis_channels;
+    Accumulator accumulator;
+    const note_table& notes;
     std::function<void(const std::string&)> logger;
+    MagnitudeKernel<SampleType> magnitude_kernel;
+    [[no_unique_address]] Instrumentation instrumentation;
+    GateState gate_state;
+    std::atomic<uint64_t> gated_blocks;
+    std::atomic<uint64_t> silent_blocks;
+    std::atomic<uint64_t> stationary_blocks;
+
+    // The snapshot used by convert(), owned by the converting thread.
+    Settings* active;
+    // A snapshot published by a setter which convert() has not picked up yet.
+    std::atomic<Settings*> pending;
+    // Snapshots released by convert(), deleted by the setters.
+    std::atomic<Settings*> retired;
+    // The parameters being edited by the setters, guarded by lock.
+    Settings staged;
+    // The buffers and plan convert_blocks() transforms a tile of blocks with, one block per channel.
+    // Owned by the converting thread and built on first use.
+    std::unique_ptr<Analysis> batch;
 
-    void samples_to_freqs(double* samples);
-    std::vector<Note> freqs_to_notes();
-    Pitch freq_to_pitch(const double freq);
-    unsigned int amplitude_to_velocity(const double amplitude);
+    BasicConverter(const Channels channels,
+                   const unsigned int samplerate,
+                   const unsigned int block_size,
+                   const double activation_level,
+                   const std::vector<unsigned int>& pitch_set,
+                   const std::array<unsigned int, 2>& pitch_range,
+                   const unsigned int note_count,
+                   const int transpose,
+                   const double ceiling);
+
+    /**
+     * @param transform false to only take the samples into the history, for blocks the gates skip.
+     */
+    void samples_to_freqs(const Settings& settings,
+                          SampleType* const* channels,
+                          const size_t nchannels,
+                          const bool mix,
+                          const bool transform = true) noexcept;
+    Gated gate(const Settings& settings,
+               SampleType* const* channels,
+               const size_t nchannels,
+               const bool stationarity) noexcept;
+    void accumulate(const Settings& settings,
+                    const Analysis& analysis,
+                    const unsigned int channel,
+                    Accumulator& accumulator) noexcept;
+    void accumulate_peaks(const Settings& settings,
+                          const Analysis& analysis,
+                          const unsigned int channel,
+                          Accumulator& accumulator) noexcept;
+    int pitch_of(const double freq) const noexcept;
+    size_t emit(const Settings& settings, Accumulator& accumulator, std::span<Note> notes) noexcept;
+    /**
+     * @brief Finds the notes of a transformed channel, or repeats or skips them as the gates decided, and
+     * keeps the frame stationary blocks repeat.
+     */
+    size_t reduce(const Settings& settings,
+                  const Gated gated,
+                  const Analysis& analysis,
+                  const unsigned int channel,
+                  std::span<Note> notes) noexcept;
+    static void reset(Accumulator& accumulator);
+    unsigned int amplitude_to_velocity(const Settings& settings, const double amplitude);
     unsigned int snap_to_key(unsigned int pitch);
-    void determine_ranges();
+    void determine_ranges(const unsigned int samplerate, const unsigned int block_size);
+    void determine_pitches();
+    std::array<unsigned int, 128> determine_note_levels(const Analysis& analysis) const;
+    void determine_peaks();
+    void determine_detector(std::shared_ptr<const std::vector<PitchSegment>> segments);
+    void determine_window();
+    bool hopping() const;
+    void stage_activation_level(const double activation_level);
+    void stage_transpose(const int transpose);
+    void stage_ceiling(const double ceiling);
+    void publish();
+    void acquire() noexcept;
+    void reclaim();
     void log(const std::string& msg);
 
    private:
-    Converter(const Converter&) = delete;
-    Converter(Converter&&) = delete;
+    BasicConverter(const BasicConverter&) = delete;
+    BasicConverter(BasicConverter&&) = delete;
 
-    std::recursive_mutex lock;
+    std::mutex lock;
 };
+
+typedef BasicConverter<double> Converter;
+typedef BasicConverter<float> FloatConverter;
 }  // namespace a2m
 }  // namespace audio
 }  // namespace njones
\ No newline at end of file
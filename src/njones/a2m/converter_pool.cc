@@ -0,0 +1,144 @@
+#include "converter_pool.h"
+
+template <class SampleType>
+njones::audio::a2m::BasicConverterPool<SampleType>::BasicConverterPool(const unsigned int nthreads,
+                                                                       const unsigned int batch)
+    : batch(std::max(1u, batch)), next_stream(0), outstanding(0), pool(nthreads) {}
+
+template <class SampleType>
+njones::audio::a2m::BasicConverterPool<SampleType>::~BasicConverterPool() {
+    wait();
+}
+
+template <class SampleType>
+typename njones::audio::a2m::BasicConverterPool<SampleType>::StreamId
+njones::audio::a2m::BasicConverterPool<SampleType>::add_stream(Callback callback,
+                                                               const unsigned int samplerate,
+                                                               const unsigned int block_size,
+                                                               const double activation_level,
+                                                               const std::vector<unsigned int> pitch_set,
+                                                               const std::array<unsigned int, 2> pitch_range,
+                                                               const unsigned int note_count,
+                                                               const int transpose,
+                                                               const double ceiling) {
+    auto stream = std::make_unique<Stream>(callback, samplerate, block_size, activation_level, pitch_set, pitch_range,
+                                           note_count, transpose, ceiling);
+
+    std::unique_lock<std::shared_mutex> guard(streams_lock);
+    const StreamId id = next_stream++;
+    streams.emplace(id, std::move(stream));
+    return id;
+}
+
+template <class SampleType>
+void njones::audio::a2m::BasicConverterPool<SampleType>::remove_stream(const StreamId id) {
+    std::unique_ptr<Stream> stream;
+    {
+        std::unique_lock<std::shared_mutex> guard(streams_lock);
+        auto found = streams.find(id);
+        if (found == streams.end())
+            return;
+        stream = std::move(found->second);
+        streams.erase(found);
+    }
+
+    std::unique_lock<std::mutex> guard(stream->lock);
+    stream->idle.wait(guard, [&]() { return !stream->scheduled; });
+}
+
+template <class SampleType>
+typename njones::audio::a2m::BasicConverterPool<SampleType>::Stream*
+njones::audio::a2m::BasicConverterPool<SampleType>::find(const StreamId id) {
+    std::shared_lock<std::shared_mutex> guard(streams_lock);
+    return streams.at(id).get();
+}
+
+template <class SampleType>
+njones::audio::a2m::BasicConverter<SampleType>& njones::audio::a2m::BasicConverterPool<SampleType>::get_converter(
+    const StreamId id) {
+    return find(id)->converter;
+}
+
+template <class SampleType>
+void njones::audio::a2m::BasicConverterPool<SampleType>::submit(const StreamId id,
+                                                                const SampleType* samples,
+                                                                const size_t nsamples) {
+    auto stream = find(id);
+    {
+        std::lock_guard<std::mutex> guard(outstanding_lock);
+        ++outstanding;
+    }
+
+    bool schedule = false;
+    {
+        std::lock_guard<std::mutex> guard(stream->lock);
+        std::vector<SampleType> block;
+        if (!stream->spare.empty()) {
+            block = std::move(stream->spare.back());
+            stream->spare.pop_back();
+        }
+        block.assign(samples, samples + nsamples);
+        stream->blocks.push_back(std::move(block));
+
+        if (!stream->scheduled) {
+            stream->scheduled = true;
+            schedule = true;
+        }
+    }
+
+    // Only one drain task exists per stream at a time, which keeps its blocks in order.
+    if (schedule)
+        pool.submit([this, stream]() { drain(stream); });
+}
+
+template <class SampleType>
+void njones::audio::a2m::BasicConverterPool<SampleType>::drain(Stream* stream) {
+    static thread_local std::array<njones::audio::a2m::Note, 128> notes;
+
+    for (unsigned int converted = 0; converted < batch; ++converted) {
+        std::vector<SampleType> block;
+        size_t index;
+        {
+            std::lock_guard<std::mutex> guard(stream->lock);
+            if (stream->blocks.empty()) {
+                stream->scheduled = false;
+                stream->idle.notify_all();
+                return;
+            }
+            block = std::move(stream->blocks.front());
+            stream->blocks.pop_front();
+            index = stream->next_block++;
+        }
+
+        const size_t count = stream->converter.convert(block.data(), notes);
+        stream->callback(index, std::span<const njones::audio::a2m::Note>(notes.data(), count));
+
+        {
+            std::lock_guard<std::mutex> guard(stream->lock);
+            stream->spare.push_back(std::move(block));
+        }
+        {
+            std::lock_guard<std::mutex> guard(outstanding_lock);
+            if (--outstanding == 0)
+                outstanding_done.notify_all();
+        }
+    }
+
+    // Yield to the streams already queued on this worker; the stream stays scheduled so no second drain
+    // task can start.
+    pool.defer([this, stream]() { drain(stream); });
+}
+
+template <class SampleType>
+void njones::audio::a2m::BasicConverterPool<SampleType>::wait() {
+    std::unique_lock<std::mutex> guard(outstanding_lock);
+    outstanding_done.wait(guard, [this]() { return outstanding == 0; });
+}
+
+template <class SampleType>
+unsigned int njones::audio::a2m::BasicConverterPool<SampleType>::get_nthreads() const {
+    return pool.get_nthreads();
+}
+
+template class njones::audio::a2m::BasicConverterPool<double>;
+template class njones::audio::a2m::BasicConverterPool<float>;
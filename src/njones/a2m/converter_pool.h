@@ -0,0 +1,120 @@
+#pragma once
+#include <njones/a2m/converter.h>
+#include <njones/lib/thread_pool.h>
+#include <condition_variable>
+#include <deque>
+#include <shared_mutex>
+#include <unordered_map>
+
+namespace njones {
+namespace audio {
+namespace a2m {
+/**
+ * @brief Converts blocks from many independent audio streams on a shared work-stealing thread pool.
+ * Each stream owns a converter, so its analysis state and buffers are never shared, while FFT plans
+ * come from the process-wide PlanCache and run concurrently. Blocks of one stream are converted one
+ * at a time in submission order; blocks of different streams run in parallel.
+ * @tparam SampleType The sample and FFT precision, either float or double.
+ */
+template <class SampleType>
+class BasicConverterPool {
+   public:
+    typedef size_t StreamId;
+    /**
+     * @brief Receives the notes of one block, on a pool thread.
+     * @param block_index The zero based index of the block within its stream.
+     */
+    typedef std::function<void(const size_t block_index, std::span<const Note> notes)> Callback;
+
+    /**
+     * @param nthreads The number of worker threads.
+     * @param batch The maximum number of consecutive blocks of one stream a worker converts before
+     * yielding to other streams.
+     */
+    BasicConverterPool(const unsigned int nthreads = std::thread::hardware_concurrency(), const unsigned int batch = 8);
+    /**
+     * @brief Converts every block already submitted before returning.
+     */
+    ~BasicConverterPool();
+
+    /**
+     * @brief Adds a stream converted with the given parameters.
+     * @see BasicConverter::BasicConverter
+     */
+    StreamId add_stream(Callback callback,
+                        const unsigned int samplerate,
+                        const unsigned int block_size,
+                        const double activation_level = 0.0,
+                        const std::vector<unsigned int> pitch_set = std::vector<unsigned int>{},
+                        const std::array<unsigned int, 2> pitch_range = std::array<unsigned int, 2>{0, 127},
+                        const unsigned int note_count = 0,
+                        const int transpose = 0,
+                        const double ceiling = 1.0);
+
+    /**
+     * @brief Waits for the blocks already submitted to the stream, then removes it.
+     * Must not run concurrently with submit() or get_converter() for the same stream.
+     */
+    void remove_stream(const StreamId stream);
+
+    /**
+     * @brief The converter of a stream, whose setters may be called at any time.
+     */
+    BasicConverter<SampleType>& get_converter(const StreamId stream);
+
+    /**
+     * @brief Queues a copy of one block for conversion. Streams may be submitted to from different
+     * threads, but the stream must not be removed while the call runs.
+     * @param samples
+     * @param nsamples The number of samples the stream's converter consumes per call.
+     */
+    void submit(const StreamId stream, const SampleType* samples, const size_t nsamples);
+
+    /**
+     * @brief Blocks until every submitted block has been converted.
+     */
+    void wait();
+
+    unsigned int get_nthreads() const;
+
+   private:
+    BasicConverterPool(const BasicConverterPool&) = delete;
+    BasicConverterPool(BasicConverterPool&&) = delete;
+
+    struct Stream {
+        template <class... Args>
+        Stream(Callback callback, Args... args)
+            : converter(args...), callback(callback), next_block(0), scheduled(false) {}
+
+        BasicConverter<SampleType> converter;
+        Callback callback;
+        std::mutex lock;
+        std::condition_variable idle;
+        std::deque<std::vector<SampleType>> blocks;
+        // Block buffers already converted, reused by submit() to avoid allocating in steady state.
+        std::vector<std::vector<SampleType>> spare;
+        size_t next_block;
+        bool scheduled;
+    };
+
+    void drain(Stream* stream);
+    Stream* find(const StreamId stream);
+
+    unsigned int batch;
+    std::shared_mutex streams_lock;
+    std::unordered_map<StreamId, std::unique_ptr<Stream>> streams;
+    StreamId next_stream;
+
+    std::mutex outstanding_lock;
+    std::condition_variable outstanding_done;
+    size_t outstanding;
+
+    // Declared last so the workers are joined before the streams they convert are destroyed.
+    ThreadPool pool;
+};
+
+typedef BasicConverterPool<double> ConverterPool;
+typedef BasicConverterPool<float> FloatConverterPool;
+}  // namespace a2m
+}  // namespace audio
+}  // namespace njones
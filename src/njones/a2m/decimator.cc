@@ -0,0 +1,57 @@
+#include "decimator.h"
+
+#include <math.h>
+#include <algorithm>
+
+template <class SampleType>
+njones::audio::a2m::HalfBandDecimator<SampleType>::HalfBandDecimator(const size_t block_size)
+    : buffer(order + std::max<size_t>(1, block_size)), block_size(std::max<size_t>(1, block_size)), phase(0) {
+    // A Blackman windowed sinc with its cutoff at a quarter of the samplerate, scaled to unity gain at DC.
+    std::array<double, (center + 1) / 2> sinc;
+    double sum = 0.5;
+    for (size_t i = 0; i < sinc.size(); ++i) {
+        const size_t offset = 2 * i + 1;
+        const double angle = 2.0 * M_PI * (center + offset) / order;
+        const double window = 0.42 - 0.5 * cos(angle) + 0.08 * cos(2.0 * angle);
+        sinc[i] = window * sin(M_PI * offset / 2) / (M_PI * offset);
+        sum += 2 * sinc[i];
+    }
+
+    center_coefficient = static_cast<SampleType>(0.5 / sum);
+    for (size_t i = 0; i < sinc.size(); ++i)
+        coefficients[i] = static_cast<SampleType>(sinc[i] / sum);
+}
+
+template <class SampleType>
+size_t njones::audio::a2m::HalfBandDecimator<SampleType>::process(const SampleType* input,
+                                                                  size_t n,
+                                                                  SampleType* output) noexcept {
+    size_t count = 0;
+    while (n > 0) {
+        const size_t chunk = std::min(n, block_size);
+        std::copy_n(input, chunk, buffer.data() + order);
+
+        for (size_t i = phase; i < chunk; i += 2) {
+            const SampleType* middle = buffer.data() + i + center;
+            SampleType sum = center_coefficient * middle[0];
+            for (size_t j = 0; j < coefficients.size(); ++j)
+                sum += coefficients[j] * (middle[-static_cast<ptrdiff_t>(2 * j + 1)] + middle[2 * j + 1]);
+            output[count++] = sum;
+        }
+
+        phase = (phase + chunk) & 1;
+        std::copy(buffer.begin() + chunk, buffer.begin() + chunk + order, buffer.begin());
+        input += chunk;
+        n -= chunk;
+    }
+    return count;
+}
+
+template <class SampleType>
+void njones::audio::a2m::HalfBandDecimator<SampleType>::reset() {
+    std::fill(buffer.begin(), buffer.end(), SampleType(0));
+    phase = 0;
+}
+
+template class njones::audio::a2m::HalfBandDecimator<double>;
+template class njones::audio::a2m::HalfBandDecimator<float>;
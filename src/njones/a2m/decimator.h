@@ -0,0 +1,54 @@
+#pragma once
+#include <stddef.h>
+#include <array>
+#include <vector>
+
+namespace njones {
+namespace audio {
+namespace a2m {
+/**
+ * @brief Halves the samplerate of a stream of samples with a linear phase half-band FIR low pass filter.
+ * Every other coefficient of a half-band filter is zero, so each output sample costs taps / 4 multiplies.
+ * The filter is flat to within 0.1 dB up to 0.07 of the input samplerate and attenuates everything from
+ * 0.4 upwards by over 80 dB, so only content far above the band a cascade stage analyses folds back.
+ * Keeps its state between calls, so a stream may be fed in blocks of any size.
+ * @tparam SampleType float or double.
+ */
+template <class SampleType>
+class HalfBandDecimator {
+   public:
+    static constexpr size_t taps = 31;
+
+    /**
+     * @param block_size The number of input samples filtered at a time. Larger inputs are processed in pieces.
+     */
+    explicit HalfBandDecimator(const size_t block_size);
+
+    /**
+     * @brief Filters n input samples and writes every second output sample. Never allocates.
+     * @param output Room for (n + 1) / 2 samples.
+     * @return The number of samples written, which alternates between floor and ceil of n / 2 for odd n.
+     */
+    size_t process(const SampleType* input, size_t n, SampleType* output) noexcept;
+
+    /**
+     * @brief Clears the filter history.
+     */
+    void reset();
+
+   private:
+    static constexpr size_t order = taps - 1;
+    static constexpr size_t center = order / 2;
+
+    SampleType center_coefficient;
+    // The odd offset coefficients h[1], h[3], ..., h[center], mirrored on both sides of the center tap.
+    std::array<SampleType, (center + 1) / 2> coefficients;
+    // The last order input samples followed by room for block_size new ones.
+    std::vector<SampleType> buffer;
+    size_t block_size;
+    // The index within the next input of the first sample to produce an output for, 0 or 1.
+    size_t phase;
+};
+}  // namespace a2m
+}  // namespace audio
+}  // namespace njones
@@ -0,0 +1,59 @@
+#pragma once
+#include <fftw3.h>
+#include <stddef.h>
+
+namespace njones {
+namespace audio {
+namespace a2m {
+/**
+ * @brief Maps a sample type onto the FFTW interface of the matching precision.
+ */
+template <class SampleType>
+struct FFT;
+
+template <>
+struct FFT<double> {
+    typedef fftw_complex complex;
+    typedef fftw_plan plan;
+
+    static plan plan_r2c(const int n, double* in, complex* out, const unsigned int flags) {
+        return fftw_plan_dft_r2c_1d(n, in, out, flags);
+    }
+    static plan plan_many_r2c(int n, const int howmany, double* in, const int idist, complex* out, const int odist,
+                              const unsigned int flags) {
+        return fftw_plan_many_dft_r2c(1, &n, howmany, in, nullptr, 1, idist, out, nullptr, 1, odist, flags);
+    }
+    static void execute(const plan p) { fftw_execute(p); }
+    static void execute_r2c(const plan p, double* in, complex* out) { fftw_execute_dft_r2c(p, in, out); }
+    static void destroy(plan p) { fftw_destroy_plan(p); }
+    static void* malloc(const size_t n) { return fftw_malloc(n); }
+    static void free(void* p) { fftw_free(p); }
+    static int alignment_of(double* p) { return fftw_alignment_of(p); }
+    static bool import_wisdom(const char* path) { return fftw_import_wisdom_from_filename(path) != 0; }
+    static bool export_wisdom(const char* path) { return fftw_export_wisdom_to_filename(path) != 0; }
+};
+
+template <>
+struct FFT<float> {
+    typedef fftwf_complex complex;
+    typedef fftwf_plan plan;
+
+    static plan plan_r2c(const int n, float* in, complex* out, const unsigned int flags) {
+        return fftwf_plan_dft_r2c_1d(n, in, out, flags);
+    }
+    static plan plan_many_r2c(int n, const int howmany, float* in, const int idist, complex* out, const int odist,
+                              const unsigned int flags) {
+        return fftwf_plan_many_dft_r2c(1, &n, howmany, in, nullptr, 1, idist, out, nullptr, 1, odist, flags);
+    }
+    static void execute(const plan p) { fftwf_execute(p); }
+    static void execute_r2c(const plan p, float* in, complex* out) { fftwf_execute_dft_r2c(p, in, out); }
+    static void destroy(plan p) { fftwf_destroy_plan(p); }
+    static void* malloc(const size_t n) { return fftwf_malloc(n); }
+    static void free(void* p) { fftwf_free(p); }
+    static int alignment_of(float* p) { return fftwf_alignment_of(p); }
+    static bool import_wisdom(const char* path) { return fftwf_import_wisdom_from_filename(path) != 0; }
+    static bool export_wisdom(const char* path) { return fftwf_export_wisdom_to_filename(path) != 0; }
+};
+}  // namespace a2m
+}  // namespace audio
+}  // namespace njones
@@ -0,0 +1,77 @@
+#include "file_converter.h"
+#include <algorithm>
+
+template <class SampleType>
+njones::audio::a2m::FileConversionStats njones::audio::a2m::convert_file(PcmFile& input,
+                                                                         MidiFileWriter& output,
+                                                                         const FileConversionOptions& options) {
+    const unsigned int samplerate = input.get_format().samplerate;
+    const size_t nframes = input.get_nframes();
+    auto converter = BasicConverter<SampleType>(samplerate, options.block_size, options.activation_level,
+                                                options.pitch_set, options.pitch_range, options.note_count,
+                                                options.transpose, options.ceiling);
+    converter.set_window(options.window);
+    converter.set_hop_size(options.hop_size);
+    converter.set_octave_levels(options.octave_levels);
+    converter.set_detector(options.detector);
+
+    const size_t step = options.hop_size > 0 ? options.hop_size : options.block_size;
+    const size_t chunk_frames = std::max<size_t>(1, (options.chunk_frames + step - 1) / step) * step;
+    auto chunk = std::vector<SampleType>(chunk_frames);
+    std::array<Note, 128> notes;
+    std::array<NoteEvent, 128> events;
+    auto tracker = NoteTracker(
+        static_cast<unsigned int>(127 * std::max(options.on_level, options.activation_level)) + 1, 1,
+        options.release_blocks, static_cast<uint64_t>(options.min_duration * samplerate), options.velocity_threshold);
+
+    auto stats = FileConversionStats{nframes, 0, 0, 0, static_cast<double>(nframes) / samplerate};
+    auto write = [&](const size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            const auto& event = events[i];
+            const double seconds = static_cast<double>(event.offset) / samplerate;
+            switch (event.type) {
+                case NoteEvent::Type::On:
+                    output.note_on(seconds, event.pitch, event.velocity);
+                    ++stats.nnotes;
+                    break;
+                case NoteEvent::Type::Off:
+                    output.note_off(seconds, event.pitch);
+                    break;
+                case NoteEvent::Type::Velocity:
+                    output.aftertouch(seconds, event.pitch, event.velocity);
+                    break;
+            }
+        }
+        stats.nevents += count;
+    };
+
+    for (size_t frame = 0; frame < nframes; frame += chunk_frames) {
+        const size_t read = input.read_mono(frame, chunk.data(), chunk_frames);
+        const size_t used = (read + step - 1) / step * step;
+        std::fill(chunk.begin() + read, chunk.begin() + used, SampleType(0));
+
+        for (size_t offset = 0; offset < used; offset += step) {
+            const size_t count = converter.convert(chunk.data() + offset, notes);
+            ++stats.nblocks;
+
+            // Position the events at the start of the block_size samples that were analysed.
+            const size_t end = frame + offset + step;
+            const size_t start = end > options.block_size ? end - options.block_size : 0;
+            write(tracker.update(std::span<const Note>(notes.data(), count), start, events));
+        }
+
+        input.release(frame + read);
+    }
+
+    write(tracker.flush(nframes, events));
+    return stats;
+}
+
+template njones::audio::a2m::FileConversionStats njones::audio::a2m::convert_file<double>(
+    PcmFile&,
+    MidiFileWriter&,
+    const FileConversionOptions&);
+template njones::audio::a2m::FileConversionStats njones::audio::a2m::convert_file<float>(
+    PcmFile&,
+    MidiFileWriter&,
+    const FileConversionOptions&);
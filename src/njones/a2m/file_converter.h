@@ -0,0 +1,60 @@
+#pragma once
+#include <njones/a2m/converter.h>
+#include <njones/a2m/midi_file.h>
+#include <njones/a2m/note_tracker.h>
+#include <njones/a2m/pcm_file.h>
+
+namespace njones {
+namespace audio {
+namespace a2m {
+/**
+ * @brief The converter and note tracking parameters used by convert_file().
+ * @see BasicConverter::BasicConverter
+ * @see NoteTracker::NoteTracker
+ */
+struct FileConversionOptions {
+    unsigned int block_size = 4096;
+    unsigned int hop_size = 0;
+    Window window = Window::Rectangular;
+    // Octave levels analysed, see BasicConverter::set_octave_levels.
+    unsigned int octave_levels = 1;
+    Detector detector = Detector::Auto;
+    double activation_level = 0.0;
+    std::vector<unsigned int> pitch_set;
+    std::array<unsigned int, 2> pitch_range{0, 127};
+    unsigned int note_count = 0;
+    int transpose = 0;
+    double ceiling = 1.0;
+    // The level a note must exceed to start; it keeps sounding down to activation_level.
+    double on_level = 0.0;
+    // Blocks a sounding note may be missing for before it ends.
+    unsigned int release_blocks = 0;
+    // Seconds a note must be present for before it starts.
+    double min_duration = 0.0;
+    // The velocity change written as polyphonic aftertouch, or 0 for none.
+    unsigned int velocity_threshold = 0;
+    // The number of frames decoded from the file at a time, rounded up to whole blocks.
+    size_t chunk_frames = 1 << 16;
+};
+
+struct FileConversionStats {
+    size_t nframes;
+    size_t nblocks;
+    size_t nnotes;
+    size_t nevents;
+    // The duration of the audio in seconds.
+    double duration;
+};
+
+/**
+ * @brief Transcribes a PCM file into a MIDI file, one block at a time.
+ * Frames are mixed down to mono and decoded chunk by chunk straight into the converter input, and
+ * pages already read are released, so memory use is constant regardless of the length of the file.
+ * Notes are turned into MIDI events by a NoteTracker, positioned at the start of the analysed block.
+ * The final partial block is zero padded.
+ */
+template <class SampleType>
+FileConversionStats convert_file(PcmFile& input, MidiFileWriter& output, const FileConversionOptions& options);
+}  // namespace a2m
+}  // namespace audio
+}  // namespace njones
@@ -0,0 +1,250 @@
+#pragma once
+#include <njones/a2m/converter.h>
+#include <njones/a2m/fft.h>
+#include <njones/a2m/magnitude.h>
+#include <njones/a2m/notes.h>
+#include <njones/a2m/plan_cache.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace njones {
+namespace audio {
+namespace a2m {
+/**
+ * @brief The bin layout of a single level analysis of one samplerate and block size, computed at compile
+ * time exactly as BasicConverter computes it at run time.
+ */
+template <unsigned int SampleRate, unsigned int BlockSize>
+struct FixedLayout {
+    static constexpr unsigned int bins = BlockSize / 2;
+    static constexpr int time_window = static_cast<int>(BlockSize / (static_cast<double>(SampleRate) / 1000));
+    static_assert(time_window > 0, "A block must span at least one millisecond.");
+
+    static constexpr double max_freq = std::min(equal_temperament[127].high, static_cast<double>(SampleRate) / 2);
+    static constexpr double min_freq = std::max(equal_temperament[0].low, static_cast<double>(1000 / time_window));
+
+    static constexpr std::array<double, bins> bin_freqs = [] {
+        std::array<double, bins> freqs{};
+        for (unsigned int i = 0; i < bins; ++i)
+            freqs[i] = i * static_cast<double>(SampleRate) / BlockSize;
+        return freqs;
+    }();
+
+    static constexpr unsigned int min_bin = [] {
+        for (unsigned int i = 0; i < bins; ++i)
+            if (bin_freqs[i] >= min_freq)
+                return i;
+        return 0u;
+    }();
+
+    static constexpr unsigned int max_bin = [] {
+        for (unsigned int i = 0; i < bins; ++i)
+            if (bin_freqs[i] >= max_freq)
+                return i - 1;
+        return bins - 1;
+    }();
+
+    struct Segments {
+        std::array<PitchSegment, 128> segments;
+        size_t count;
+    };
+
+    // The unsnapped segments of every analysed bin, each raw pitch covering at most one run of bins.
+    static constexpr Segments mapping = [] {
+        Segments mapping{};
+        int raw_pitch = 0;
+        for (unsigned int i = min_bin; i < max_bin; ++i) {
+            const double freq = bin_freqs[i];
+            while (raw_pitch < 128 && equal_temperament[raw_pitch].high < freq)
+                ++raw_pitch;
+
+            if (raw_pitch >= 128 || freq < equal_temperament[raw_pitch].low)
+                continue;
+
+            if (mapping.count > 0 && mapping.segments[mapping.count - 1].raw_pitch == raw_pitch &&
+                mapping.segments[mapping.count - 1].end == i)
+                mapping.segments[mapping.count - 1].end = i + 1;
+            else
+                mapping.segments[mapping.count++] = PitchSegment{i, i + 1, raw_pitch, raw_pitch, 0};
+        }
+        return mapping;
+    }();
+};
+
+/**
+ * @brief A converter specialised for one samplerate and block size. The note table, bin frequencies,
+ * bin range and bin to pitch mapping are constants, every loop runs a fixed number of times and all
+ * buffers are stored inline, so a FixedConverter never touches the heap after construction and
+ * produces the same notes as an equally configured BasicConverter with a rectangular window.
+ * Unlike BasicConverter its setters are not thread safe and must not overlap with convert().
+ * @tparam SampleRate The samplerate of the audio data passed into convert.
+ * @tparam BlockSize The number of samples processed per call to convert().
+ * @tparam SampleType The sample and FFT precision, either float or double.
+ */
+template <unsigned int SampleRate, unsigned int BlockSize, class SampleType = double>
+class FixedConverter {
+   public:
+    typedef FixedLayout<SampleRate, BlockSize> Layout;
+
+    static constexpr unsigned int samplerate = SampleRate;
+    static constexpr unsigned int block_size = BlockSize;
+
+    /**
+     * @see BasicConverter::BasicConverter
+     */
+    FixedConverter(const double activation_level = 0.0,
+                   const std::vector<unsigned int>& pitch_set = std::vector<unsigned int>{},
+                   const std::array<unsigned int, 2>& pitch_range = std::array<unsigned int, 2>{0, 127},
+                   const unsigned int note_count = 0,
+                   const int transpose = 0,
+                   const double ceiling = 1.0)
+        : pitch_range(pitch_range),
+          note_count(note_count),
+          magnitude_kernel(njones::audio::a2m::magnitude_kernel<SampleType>()) {
+        amplitudes.fill(0.0);
+        counts.fill(0);
+        active.fill(0);
+        set_activation_level(activation_level);
+        set_pitch_set(pitch_set);
+        set_transpose(transpose);
+        set_ceiling(ceiling);
+        plan = PlanCache::instance().plan<SampleType>(BlockSize, 1, input.data(), output());
+    }
+
+    /**
+     * @brief Converts a block of BlockSize samples into a2m::Note instances.
+     */
+    std::vector<Note> convert(const SampleType* samples) {
+        std::array<Note, 128> notes;
+        const size_t count = convert(samples, notes);
+        return std::vector<Note>(notes.begin(), notes.begin() + count);
+    }
+
+    /**
+     * @brief Converts a block of BlockSize samples into a2m::Note instances written to a caller owned
+     * buffer, without allocating, locking or throwing.
+     * @see BasicConverter::convert
+     */
+    size_t convert(const SampleType* samples, std::span<Note> notes) noexcept {
+        std::copy_n(samples, BlockSize, input.begin());
+        plan->execute(input.data(), output());
+
+        for (size_t i = 0; i < Layout::mapping.count; ++i) {
+            const auto& segment = Layout::mapping.segments[i];
+            const auto sum = magnitude_kernel(spectrum.data(), segment.begin, segment.end);
+            if (sum.count > 0) {
+                const unsigned int pitch = snapped[segment.raw_pitch];
+                raw_pitches[pitch] = segment.raw_pitch;
+                amplitudes[pitch] += sum.amplitude;
+                counts[pitch] += sum.count;
+                active[pitch >> 6] |= uint64_t(1) << (pitch & 63);
+            }
+        }
+
+        size_t limit = notes.size();
+        if (note_count > 0)
+            limit = std::min(limit, static_cast<size_t>(note_count));
+
+        // As in BasicConverter, notes go straight into the output and the loudest are selected in place,
+        // falling back to a min-heap on velocity when the output cannot hold them all. Output stores may
+        // alias the members, so those read per note are loaded once up front.
+        const int transpose = this->transpose;
+        const int low = static_cast<int>(pitch_range[0]);
+        const int high = static_cast<int>(pitch_range[1]);
+        const unsigned int velocity_limit = this->velocity_limit;
+        const double full_scale = Layout::bins * ceiling;
+        size_t count = 0;
+        bool heap = false;
+        for (unsigned int word = 0; word < active.size(); ++word) {
+            uint64_t bits = active[word];
+            active[word] = 0;
+            while (bits != 0) {
+                const unsigned int pitch = word * 64 + std::countr_zero(bits);
+                bits &= bits - 1;
+
+                const double amplitude = amplitudes[pitch] / counts[pitch];
+                amplitudes[pitch] = 0.0;
+                counts[pitch] = 0;
+                const int new_pitch = pitch + transpose;
+                if (new_pitch < low || new_pitch > high)
+                    continue;
+
+                const unsigned int velocity = std::min(127, static_cast<int>(127 * (amplitude / full_scale)));
+                if (velocity <= velocity_limit)
+                    continue;
+
+                const auto note = Note(new_pitch, raw_pitches[pitch] + transpose, velocity);
+                if (count < notes.size()) {
+                    notes[count++] = note;
+                } else if (count > 0) {
+                    if (!heap) {
+                        std::make_heap(notes.begin(), notes.end(), std::greater<>());
+                        heap = true;
+                    }
+                    if (note > notes.front()) {
+                        std::pop_heap(notes.begin(), notes.end(), std::greater<>());
+                        notes.back() = note;
+                        std::push_heap(notes.begin(), notes.end(), std::greater<>());
+                    }
+                }
+            }
+        }
+
+        // Notes are ordered by velocity whenever the output is limited, keeping the loudest ones.
+        if (count > limit) {
+            std::nth_element(notes.begin(), notes.begin() + limit, notes.begin() + count, std::greater<>());
+            count = limit;
+        }
+        if (note_count > 0 || heap)
+            std::sort(notes.begin(), notes.begin() + count, std::greater<>());
+        return count;
+    }
+
+    void set_activation_level(const double activation_level) {
+        velocity_limit = activation_level != 0.0 ? static_cast<unsigned int>(127 * activation_level) : 1;
+    }
+    void set_pitch_set(const std::vector<unsigned int>& pitch_set) {
+        for (unsigned int pitch = 0; pitch < 128; ++pitch)
+            snapped[pitch] = snap_to_key(pitch, pitch_set);
+    }
+    void set_pitch_range(const std::array<unsigned int, 2>& pitch_range) { this->pitch_range = pitch_range; }
+    void set_note_count(const int note_count) { this->note_count = note_count; }
+    void set_transpose(const int transpose) { this->transpose = std::clamp(transpose, -127, 127); }
+    void set_ceiling(const double ceiling) { this->ceiling = std::clamp(ceiling, 0.0, 1.0); }
+
+   private:
+    typedef typename FFT<SampleType>::complex Complex;
+
+    FixedConverter(const FixedConverter&) = delete;
+    FixedConverter(FixedConverter&&) = delete;
+
+    Complex* output() { return reinterpret_cast<Complex*>(spectrum.data()); }
+
+    alignas(64) std::array<SampleType, BlockSize> input;
+    // The interleaved (re, im) output of the FFT.
+    alignas(64) std::array<SampleType, 2 * (BlockSize / 2 + 1)> spectrum;
+    std::array<double, 128> amplitudes;
+    std::array<size_t, 128> counts;
+    // The pitches holding a non zero count.
+    std::array<uint64_t, 2> active;
+    std::array<unsigned int, 128> raw_pitches;
+    // The pitch each raw pitch is snapped to by the pitch set.
+    std::array<unsigned int, 128> snapped;
+
+    unsigned int velocity_limit;
+    std::array<unsigned int, 2> pitch_range;
+    unsigned int note_count;
+    int transpose;
+    double ceiling;
+    MagnitudeKernel<SampleType> magnitude_kernel;
+    std::shared_ptr<const Plan<SampleType>> plan;
+};
+}  // namespace a2m
+}  // namespace audio
+}  // namespace njones
@@ -0,0 +1,103 @@
+#include "gate.h"
+
+#include <math.h>
+#include <algorithm>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Measures samples [begin, n), continuing from the sums already taken over [0, begin).
+template <class SampleType>
+static njones::audio::a2m::BlockLevels measure_tail(const SampleType* samples,
+                                                    const size_t begin,
+                                                    const size_t n,
+                                                    njones::audio::a2m::BlockLevels levels) {
+    for (size_t i = begin; i < n; ++i) {
+        const double sample = samples[i];
+        levels.peak = std::max(levels.peak, fabs(sample));
+        levels.energy += sample * sample;
+        if (i > 0) {
+            const double slope = sample - samples[i - 1];
+            levels.slope_energy += slope * slope;
+        }
+    }
+    return levels;
+}
+
+namespace njones {
+namespace audio {
+namespace a2m {
+template <>
+BlockLevels measure_block<double>(const double* samples, const size_t n) noexcept {
+    size_t i = 0;
+    BlockLevels levels{0.0, 0.0, 0.0};
+#if defined(__SSE2__)
+    if (n >= 3) {
+        const __m128d sign = _mm_set1_pd(-0.0);
+        __m128d peak = _mm_setzero_pd();
+        __m128d energy = _mm_setzero_pd();
+        __m128d slope_energy = _mm_setzero_pd();
+        // Each step covers samples i and i + 1 and their differences to i - 1 and i, so the first sample
+        // is left to the scalar tail.
+        for (i = 1; i + 2 <= n; i += 2) {
+            const __m128d current = _mm_loadu_pd(samples + i);
+            const __m128d previous = _mm_loadu_pd(samples + i - 1);
+            const __m128d slope = _mm_sub_pd(current, previous);
+            peak = _mm_max_pd(peak, _mm_andnot_pd(sign, current));
+            energy = _mm_add_pd(energy, _mm_mul_pd(current, current));
+            slope_energy = _mm_add_pd(slope_energy, _mm_mul_pd(slope, slope));
+        }
+
+        alignas(16) double lanes[3][2];
+        _mm_store_pd(lanes[0], peak);
+        _mm_store_pd(lanes[1], energy);
+        _mm_store_pd(lanes[2], slope_energy);
+        levels = BlockLevels{std::max(lanes[0][0], lanes[0][1]), lanes[1][0] + lanes[1][1], lanes[2][0] + lanes[2][1]};
+        levels = measure_tail(samples, i, n, levels);
+        return measure_tail(samples, 0, 1, levels);
+    }
+#endif
+    return measure_tail(samples, i, n, levels);
+}
+
+template <>
+BlockLevels measure_block<float>(const float* samples, const size_t n) noexcept {
+    size_t i = 0;
+    BlockLevels levels{0.0, 0.0, 0.0};
+#if defined(__SSE2__)
+    if (n >= 5) {
+        const __m128 sign = _mm_set1_ps(-0.0f);
+        __m128 peak = _mm_setzero_ps();
+        // Samples are widened to double before they are differenced and squared, as in the scalar path,
+        // so both paths measure the same levels and long blocks keep their precision.
+        __m128d energy = _mm_setzero_pd();
+        __m128d slope_energy = _mm_setzero_pd();
+        for (i = 1; i + 4 <= n; i += 4) {
+            const __m128 current = _mm_loadu_ps(samples + i);
+            const __m128 previous = _mm_loadu_ps(samples + i - 1);
+            peak = _mm_max_ps(peak, _mm_andnot_ps(sign, current));
+            const __m128d low = _mm_cvtps_pd(current);
+            const __m128d high = _mm_cvtps_pd(_mm_movehl_ps(current, current));
+            const __m128d low_slope = _mm_sub_pd(low, _mm_cvtps_pd(previous));
+            const __m128d high_slope = _mm_sub_pd(high, _mm_cvtps_pd(_mm_movehl_ps(previous, previous)));
+            energy = _mm_add_pd(energy, _mm_mul_pd(low, low));
+            energy = _mm_add_pd(energy, _mm_mul_pd(high, high));
+            slope_energy = _mm_add_pd(slope_energy, _mm_mul_pd(low_slope, low_slope));
+            slope_energy = _mm_add_pd(slope_energy, _mm_mul_pd(high_slope, high_slope));
+        }
+
+        alignas(16) float peaks[4];
+        alignas(16) double sums[2][2];
+        _mm_store_ps(peaks, peak);
+        _mm_store_pd(sums[0], energy);
+        _mm_store_pd(sums[1], slope_energy);
+        levels = BlockLevels{*std::max_element(peaks, peaks + 4), sums[0][0] + sums[0][1], sums[1][0] + sums[1][1]};
+        levels = measure_tail(samples, i, n, levels);
+        return measure_tail(samples, 0, 1, levels);
+    }
+#endif
+    return measure_tail(samples, i, n, levels);
+}
+}  // namespace a2m
+}  // namespace audio
+}  // namespace njones
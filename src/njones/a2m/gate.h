@@ -0,0 +1,39 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+namespace njones {
+namespace audio {
+namespace a2m {
+/**
+ * @brief Time domain measures of a run of samples, cheap enough to decide whether a block needs analysing.
+ */
+struct BlockLevels {
+    // The largest absolute sample.
+    double peak;
+    // The sum of squared samples.
+    double energy;
+    // The sum of squared differences between consecutive samples. Relative to energy it grows with the
+    // square of the power weighted mean frequency, so a change in it stands in for a change in spectrum.
+    double slope_energy;
+};
+
+/**
+ * @brief Measures n samples in a single pass, two or four at a time with SSE2 where available.
+ */
+template <class SampleType>
+BlockLevels measure_block(const SampleType* samples, const size_t n) noexcept;
+
+/**
+ * @brief How many blocks a converter was given and how many of them it did not analyse in full.
+ */
+struct GateCounters {
+    uint64_t blocks;
+    // Blocks below the silence floor, which produced no notes without an FFT.
+    uint64_t silent;
+    // Blocks which repeated the previous frame's notes without an FFT.
+    uint64_t stationary;
+};
+}  // namespace a2m
+}  // namespace audio
+}  // namespace njones
@@ -0,0 +1,52 @@
+#include "goertzel.h"
+
+#include <math.h>
+#include <algorithm>
+
+njones::audio::a2m::GoertzelBin::GoertzelBin(const unsigned int bin, const unsigned int block_size)
+    : bin(bin),
+      coefficient(2.0 * cos(2.0 * M_PI * bin / block_size)),
+      cosine(cos(2.0 * M_PI * bin / block_size)),
+      sine(sin(2.0 * M_PI * bin / block_size)) {}
+
+template <class SampleType>
+void njones::audio::a2m::goertzel(const SampleType* samples,
+                                  const size_t n,
+                                  std::span<const GoertzelBin> bins,
+                                  SampleType* spectrum) noexcept {
+    // Independent filters are interleaved so the loop carried dependency of one recurrence does not
+    // bound the throughput. Unused lanes of the last group run on a zero coefficient.
+    constexpr size_t lanes = 8;
+    for (size_t first = 0; first < bins.size(); first += lanes) {
+        const size_t count = std::min(lanes, bins.size() - first);
+        double coefficients[lanes] = {};
+        double s1[lanes] = {};
+        double s2[lanes] = {};
+        for (size_t j = 0; j < count; ++j)
+            coefficients[j] = bins[first + j].coefficient;
+
+        for (size_t i = 0; i < n; ++i) {
+            const double sample = samples[i];
+            for (size_t j = 0; j < lanes; ++j) {
+                const double s0 = sample + coefficients[j] * s1[j] - s2[j];
+                s2[j] = s1[j];
+                s1[j] = s0;
+            }
+        }
+
+        for (size_t j = 0; j < count; ++j) {
+            const auto& bin = bins[first + j];
+            spectrum[2 * bin.bin] = static_cast<SampleType>(s1[j] - s2[j] * bin.cosine);
+            spectrum[2 * bin.bin + 1] = static_cast<SampleType>(s2[j] * bin.sine);
+        }
+    }
+}
+
+template void njones::audio::a2m::goertzel<double>(const double*,
+                                                   const size_t,
+                                                   std::span<const GoertzelBin>,
+                                                   double*) noexcept;
+template void njones::audio::a2m::goertzel<float>(const float*,
+                                                  const size_t,
+                                                  std::span<const GoertzelBin>,
+                                                  float*) noexcept;
@@ -0,0 +1,34 @@
+#pragma once
+#include <stddef.h>
+#include <span>
+
+namespace njones {
+namespace audio {
+namespace a2m {
+/**
+ * @brief One DFT bin evaluated by a Goertzel filter, with the constants of its recurrence.
+ */
+struct GoertzelBin {
+    GoertzelBin(const unsigned int bin, const unsigned int block_size);
+
+    unsigned int bin;
+    double coefficient;
+    double cosine;
+    double sine;
+};
+
+/**
+ * @brief Evaluates the given bins of the DFT of n samples, one Goertzel filter per bin, and writes
+ * them to the interleaved (re, im) spectrum at the same positions a real FFT of n samples would.
+ * Only the magnitudes match the FFT, the phases do not. Bins not listed are left untouched.
+ * The filters run in double precision, in groups the compiler can vectorise across bins, and cost
+ * one multiply and two additions per sample and bin.
+ */
+template <class SampleType>
+void goertzel(const SampleType* samples,
+              const size_t n,
+              std::span<const GoertzelBin> bins,
+              SampleType* spectrum) noexcept;
+}  // namespace a2m
+}  // namespace audio
+}  // namespace njones
@@ -0,0 +1,36 @@
+#include "instrumentation.h"
+
+uint64_t njones::audio::a2m::InstrumentationSnapshot::latency_quantile_ns(const double quantile) const {
+    uint64_t total = 0;
+    for (auto count : latency_histogram)
+        total += count;
+    if (total == 0)
+        return 0;
+
+    const auto target = static_cast<uint64_t>(quantile * total);
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket < latency_buckets; ++bucket) {
+        seen += latency_histogram[bucket];
+        if (seen > target || seen == total)
+            return uint64_t(1) << (bucket + 1);
+    }
+    return uint64_t(1) << latency_buckets;
+}
+
+njones::audio::a2m::InstrumentationSnapshot njones::audio::a2m::Instrumentation::snapshot() const {
+    auto snapshot = InstrumentationSnapshot{};
+#ifdef A2M_INSTRUMENTATION
+    for (size_t stage = 0; stage < stage_count; ++stage)
+        snapshot.stages[stage] = StageStats{stages[stage].calls.load(std::memory_order_relaxed),
+                                            stages[stage].ns.load(std::memory_order_relaxed),
+                                            stages[stage].cycles.load(std::memory_order_relaxed)};
+    for (size_t bucket = 0; bucket < latency_buckets; ++bucket)
+        snapshot.latency_histogram[bucket] = latency[bucket].load(std::memory_order_relaxed);
+    snapshot.blocks = blocks.load(std::memory_order_relaxed);
+    snapshot.notes_emitted = notes_emitted.load(std::memory_order_relaxed);
+    snapshot.notes_below_activation = notes_below_activation.load(std::memory_order_relaxed);
+    snapshot.notes_out_of_range = notes_out_of_range.load(std::memory_order_relaxed);
+    snapshot.notes_dropped = notes_dropped.load(std::memory_order_relaxed);
+#endif
+    return snapshot;
+}
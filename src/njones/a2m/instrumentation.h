@@ -0,0 +1,177 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+
+#if defined(A2M_INSTRUMENTATION) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#define A2M_CYCLE_COUNTER
+#endif
+
+namespace njones {
+namespace audio {
+namespace a2m {
+/**
+ * @brief Whether converters were built with A2M_INSTRUMENTATION defined. Without it every
+ * instrumentation call compiles to nothing and converters carry no counters.
+ */
+#ifdef A2M_INSTRUMENTATION
+inline constexpr bool instrumentation_enabled = true;
+#else
+inline constexpr bool instrumentation_enabled = false;
+#endif
+
+/**
+ * @brief The stages of one conversion. Magnitudes, pitch mapping and accumulation run in one fused
+ * pass over the pitch segments, so they are measured together.
+ */
+enum class Stage {
+    // Copying, mixing, decimating and windowing samples into the FFT input.
+    Load,
+    // The FFT, or the Goertzel bank standing in for it.
+    Fft,
+    // Bin magnitudes, pitch mapping and accumulation.
+    Accumulate,
+    // Velocity mapping, filtering and top-N selection.
+    Select,
+};
+inline constexpr size_t stage_count = 4;
+// Block latencies are binned by power of two: bucket i holds latencies in [2^i, 2^(i+1)) ns.
+inline constexpr size_t latency_buckets = 40;
+
+struct StageStats {
+    uint64_t calls;
+    uint64_t ns;
+    // Time stamp counter ticks, or 0 where no cycle counter is available.
+    uint64_t cycles;
+};
+
+/**
+ * @brief A copy of a converter's counters. Every counter only grows, so rates are taken from the
+ * difference of two snapshots.
+ */
+struct InstrumentationSnapshot {
+    std::array<StageStats, stage_count> stages;
+    std::array<uint64_t, latency_buckets> latency_histogram;
+    uint64_t blocks;
+    uint64_t notes_emitted;
+    // Notes whose velocity did not exceed the activation level.
+    uint64_t notes_below_activation;
+    // Notes transposed outside the pitch range.
+    uint64_t notes_out_of_range;
+    // Notes that passed every filter but were cut by note_count or the output buffer size.
+    uint64_t notes_dropped;
+
+    const StageStats& operator[](const Stage stage) const { return stages[static_cast<size_t>(stage)]; }
+
+    /**
+     * @brief The upper bound of the histogram bucket holding the given quantile of block latencies.
+     * @param quantile In the range [0.0, 1.0].
+     */
+    uint64_t latency_quantile_ns(const double quantile) const;
+};
+
+/**
+ * @brief Per-converter counters written by the converting thread and read from any other thread.
+ * The single writer updates each counter with a plain relaxed load and store, so instrumented code
+ * takes no locks and issues no atomic read-modify-write instructions. A snapshot is consistent per
+ * counter, not across counters.
+ */
+class Instrumentation {
+   public:
+    struct Timestamp {
+        int64_t ns;
+        uint64_t cycles;
+    };
+
+    Timestamp start() const noexcept {
+#ifdef A2M_INSTRUMENTATION
+        return Timestamp{std::chrono::steady_clock::now().time_since_epoch().count(), cycles()};
+#else
+        return Timestamp{0, 0};
+#endif
+    }
+
+    /**
+     * @brief Charges the time since start to a stage and returns the current time, so consecutive
+     * stages can be chained without reading the clock twice.
+     */
+    Timestamp stop(const Stage stage, const Timestamp& start) noexcept {
+#ifdef A2M_INSTRUMENTATION
+        const auto now = this->start();
+        auto& counters = stages[static_cast<size_t>(stage)];
+        add(counters.calls, 1);
+        add(counters.ns, static_cast<uint64_t>(now.ns - start.ns));
+        add(counters.cycles, now.cycles - start.cycles);
+        return now;
+#else
+        return start;
+#endif
+    }
+
+    /**
+     * @brief Records the latency of a whole block started at start.
+     */
+    void block(const Timestamp& start) noexcept {
+#ifdef A2M_INSTRUMENTATION
+        const auto ns = static_cast<uint64_t>(this->start().ns - start.ns);
+        const size_t width = std::bit_width(ns);
+        add(latency[std::min(width > 0 ? width - 1 : 0, latency_buckets - 1)], 1);
+        add(blocks, 1);
+#endif
+    }
+
+    void notes(const size_t emitted,
+               const size_t below_activation,
+               const size_t out_of_range,
+               const size_t dropped) noexcept {
+#ifdef A2M_INSTRUMENTATION
+        add(notes_emitted, emitted);
+        add(notes_below_activation, below_activation);
+        add(notes_out_of_range, out_of_range);
+        add(notes_dropped, dropped);
+#endif
+    }
+
+    /**
+     * @brief Reads every counter. Safe to call from any thread while the converter runs; returns
+     * zeros when instrumentation is disabled.
+     */
+    InstrumentationSnapshot snapshot() const;
+
+   private:
+    static uint64_t cycles() noexcept {
+#ifdef A2M_CYCLE_COUNTER
+        return __rdtsc();
+#else
+        return 0;
+#endif
+    }
+
+#ifdef A2M_INSTRUMENTATION
+    struct Counters {
+        std::atomic<uint64_t> calls{0};
+        std::atomic<uint64_t> ns{0};
+        std::atomic<uint64_t> cycles{0};
+    };
+
+    static void add(std::atomic<uint64_t>& counter, const uint64_t value) noexcept {
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+
+    std::array<Counters, stage_count> stages;
+    std::array<std::atomic<uint64_t>, latency_buckets> latency{};
+    std::atomic<uint64_t> blocks{0};
+    std::atomic<uint64_t> notes_emitted{0};
+    std::atomic<uint64_t> notes_below_activation{0};
+    std::atomic<uint64_t> notes_out_of_range{0};
+    std::atomic<uint64_t> notes_dropped{0};
+#endif
+};
+}  // namespace a2m
+}  // namespace audio
+}  // namespace njones
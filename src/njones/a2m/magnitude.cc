@@ -0,0 +1,145 @@
+#include "magnitude.h"
+
+#include <math.h>
+
+#if defined(__GNUC__) && defined(__SSE2__) && (defined(__x86_64__) || defined(__i386__))
+#define A2M_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+template <class SampleType>
+njones::audio::a2m::MagnitudeSum njones::audio::a2m::sum_magnitudes_scalar(const SampleType* spectrum,
+                                                                          const size_t begin,
+                                                                          const size_t end) {
+    MagnitudeSum sum{0.0, 0};
+    for (size_t i = begin; i < end; ++i) {
+        const SampleType re = spectrum[2 * i];
+        const SampleType im = spectrum[2 * i + 1];
+        const SampleType magnitude = std::sqrt(re * re + im * im);
+        sum.amplitude += magnitude;
+        sum.count += magnitude > 0;
+    }
+    return sum;
+}
+
+#ifdef A2M_X86_KERNELS
+static njones::audio::a2m::MagnitudeSum sum_magnitudes_sse2(const double* spectrum,
+                                                            const size_t begin,
+                                                            const size_t end) {
+    const __m128d zero = _mm_setzero_pd();
+    __m128d amplitude = _mm_setzero_pd();
+    size_t count = 0;
+    size_t i = begin;
+
+    for (; i + 2 <= end; i += 2) {
+        const __m128d a = _mm_loadu_pd(spectrum + 2 * i);
+        const __m128d b = _mm_loadu_pd(spectrum + 2 * i + 2);
+        const __m128d a2 = _mm_mul_pd(a, a);
+        const __m128d b2 = _mm_mul_pd(b, b);
+        const __m128d magnitude = _mm_sqrt_pd(_mm_add_pd(_mm_unpacklo_pd(a2, b2), _mm_unpackhi_pd(a2, b2)));
+        amplitude = _mm_add_pd(amplitude, magnitude);
+        count += __builtin_popcount(_mm_movemask_pd(_mm_cmpgt_pd(magnitude, zero)));
+    }
+
+    alignas(16) double lanes[2];
+    _mm_store_pd(lanes, amplitude);
+    auto tail = njones::audio::a2m::sum_magnitudes_scalar(spectrum, i, end);
+    return {lanes[0] + lanes[1] + tail.amplitude, count + tail.count};
+}
+
+static njones::audio::a2m::MagnitudeSum sum_magnitudes_sse2(const float* spectrum,
+                                                            const size_t begin,
+                                                            const size_t end) {
+    const __m128 zero = _mm_setzero_ps();
+    __m128d low = _mm_setzero_pd();
+    __m128d high = _mm_setzero_pd();
+    size_t count = 0;
+    size_t i = begin;
+
+    for (; i + 4 <= end; i += 4) {
+        const __m128 a = _mm_loadu_ps(spectrum + 2 * i);
+        const __m128 b = _mm_loadu_ps(spectrum + 2 * i + 4);
+        const __m128 re = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+        const __m128 im = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+        const __m128 magnitude = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(re, re), _mm_mul_ps(im, im)));
+        low = _mm_add_pd(low, _mm_cvtps_pd(magnitude));
+        high = _mm_add_pd(high, _mm_cvtps_pd(_mm_movehl_ps(magnitude, magnitude)));
+        count += __builtin_popcount(_mm_movemask_ps(_mm_cmpgt_ps(magnitude, zero)));
+    }
+
+    alignas(16) double lanes[2];
+    _mm_store_pd(lanes, _mm_add_pd(low, high));
+    auto tail = njones::audio::a2m::sum_magnitudes_scalar(spectrum, i, end);
+    return {lanes[0] + lanes[1] + tail.amplitude, count + tail.count};
+}
+
+__attribute__((target("avx2"))) static njones::audio::a2m::MagnitudeSum sum_magnitudes_avx2(const double* spectrum,
+                                                                                           const size_t begin,
+                                                                                           const size_t end) {
+    const __m256d zero = _mm256_setzero_pd();
+    __m256d amplitude = _mm256_setzero_pd();
+    size_t count = 0;
+    size_t i = begin;
+
+    for (; i + 4 <= end; i += 4) {
+        const __m256d a = _mm256_loadu_pd(spectrum + 2 * i);
+        const __m256d b = _mm256_loadu_pd(spectrum + 2 * i + 4);
+        // Lanes come out as bins [0, 2, 1, 3], which does not matter for a reduction.
+        const __m256d magnitude = _mm256_sqrt_pd(_mm256_hadd_pd(_mm256_mul_pd(a, a), _mm256_mul_pd(b, b)));
+        amplitude = _mm256_add_pd(amplitude, magnitude);
+        count += __builtin_popcount(_mm256_movemask_pd(_mm256_cmp_pd(magnitude, zero, _CMP_GT_OQ)));
+    }
+
+    alignas(32) double lanes[4];
+    _mm256_store_pd(lanes, amplitude);
+    auto tail = njones::audio::a2m::sum_magnitudes_scalar(spectrum, i, end);
+    return {(lanes[0] + lanes[1]) + (lanes[2] + lanes[3]) + tail.amplitude, count + tail.count};
+}
+
+__attribute__((target("avx2"))) static njones::audio::a2m::MagnitudeSum sum_magnitudes_avx2(const float* spectrum,
+                                                                                           const size_t begin,
+                                                                                           const size_t end) {
+    const __m256 zero = _mm256_setzero_ps();
+    __m256d low = _mm256_setzero_pd();
+    __m256d high = _mm256_setzero_pd();
+    size_t count = 0;
+    size_t i = begin;
+
+    for (; i + 8 <= end; i += 8) {
+        const __m256 a = _mm256_loadu_ps(spectrum + 2 * i);
+        const __m256 b = _mm256_loadu_ps(spectrum + 2 * i + 8);
+        const __m256 re = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+        const __m256 im = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+        const __m256 magnitude = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(re, re), _mm256_mul_ps(im, im)));
+        low = _mm256_add_pd(low, _mm256_cvtps_pd(_mm256_castps256_ps128(magnitude)));
+        high = _mm256_add_pd(high, _mm256_cvtps_pd(_mm256_extractf128_ps(magnitude, 1)));
+        count += __builtin_popcount(_mm256_movemask_ps(_mm256_cmp_ps(magnitude, zero, _CMP_GT_OQ)));
+    }
+
+    alignas(32) double lanes[4];
+    _mm256_store_pd(lanes, _mm256_add_pd(low, high));
+    auto tail = njones::audio::a2m::sum_magnitudes_scalar(spectrum, i, end);
+    return {(lanes[0] + lanes[1]) + (lanes[2] + lanes[3]) + tail.amplitude, count + tail.count};
+}
+#endif
+
+template <class SampleType>
+njones::audio::a2m::MagnitudeKernel<SampleType> njones::audio::a2m::magnitude_kernel() {
+#ifdef A2M_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return static_cast<MagnitudeKernel<SampleType>>(sum_magnitudes_avx2);
+    return static_cast<MagnitudeKernel<SampleType>>(sum_magnitudes_sse2);
+#else
+    return sum_magnitudes_scalar<SampleType>;
+#endif
+}
+
+template njones::audio::a2m::MagnitudeSum njones::audio::a2m::sum_magnitudes_scalar<double>(const double*,
+                                                                                          const size_t,
+                                                                                          const size_t);
+template njones::audio::a2m::MagnitudeSum njones::audio::a2m::sum_magnitudes_scalar<float>(const float*,
+                                                                                         const size_t,
+                                                                                         const size_t);
+template njones::audio::a2m::MagnitudeKernel<double> njones::audio::a2m::magnitude_kernel<double>();
+template njones::audio::a2m::MagnitudeKernel<float> njones::audio::a2m::magnitude_kernel<float>();
@@ -0,0 +1,38 @@
+#pragma once
+#include <stddef.h>
+
+namespace njones {
+namespace audio {
+namespace a2m {
+/**
+ * @brief The summed magnitude of a run of FFT bins and the number of those bins with a non zero magnitude.
+ */
+struct MagnitudeSum {
+    double amplitude;
+    size_t count;
+};
+
+/**
+ * @brief Computes |X[k]| for every bin k in [begin, end) of an interleaved (re, im) spectrum
+ * and reduces them into a single MagnitudeSum.
+ */
+template <class SampleType>
+using MagnitudeKernel = MagnitudeSum (*)(const SampleType* spectrum, const size_t begin, const size_t end);
+
+/**
+ * @brief The portable reference kernel, summing one bin at a time in ascending order.
+ */
+template <class SampleType>
+MagnitudeSum sum_magnitudes_scalar(const SampleType* spectrum, const size_t begin, const size_t end);
+
+/**
+ * @brief Selects the fastest kernel supported by the running CPU (AVX2, SSE2 or scalar).
+ * Each bin magnitude is computed exactly as the scalar kernel does, but the vector kernels sum
+ * several bins in parallel lanes, so a run of n bins may differ from the scalar sum by the
+ * reassociation error of at most n * epsilon relative to the sum.
+ */
+template <class SampleType>
+MagnitudeKernel<SampleType> magnitude_kernel();
+}  // namespace a2m
+}  // namespace audio
+}  // namespace njones
@@ -0,0 +1,105 @@
+#include "midi_file.h"
+#include <math.h>
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+void write_u16(std::ofstream& file, const uint16_t value) {
+    const char bytes[] = {static_cast<char>(value >> 8), static_cast<char>(value)};
+    file.write(bytes, sizeof(bytes));
+}
+
+void write_u32(std::ofstream& file, const uint32_t value) {
+    const char bytes[] = {static_cast<char>(value >> 24), static_cast<char>(value >> 16),
+                          static_cast<char>(value >> 8), static_cast<char>(value)};
+    file.write(bytes, sizeof(bytes));
+}
+}  // namespace
+
+njones::audio::a2m::MidiFileWriter::MidiFileWriter(const std::string& path,
+                                                   const unsigned int ticks_per_quarter,
+                                                   const unsigned int tempo)
+    : file(path, std::ios::binary | std::ios::trunc),
+      ticks_per_second(ticks_per_quarter * 1000000.0 / tempo),
+      last_tick(0),
+      nevents(0) {
+    if (!file)
+        throw std::runtime_error("Failed to create " + path + ".");
+
+    file.write("MThd", 4);
+    write_u32(file, 6);
+    write_u16(file, 0);
+    write_u16(file, 1);
+    write_u16(file, static_cast<uint16_t>(ticks_per_quarter));
+
+    file.write("MTrk", 4);
+    track_start = file.tellp();
+    write_u32(file, 0);
+
+    // Set tempo meta event, so players map ticks back to the same wall clock time.
+    const char meta[] = {0x00, static_cast<char>(0xFF), 0x51, 0x03, static_cast<char>(tempo >> 16),
+                         static_cast<char>(tempo >> 8), static_cast<char>(tempo)};
+    file.write(meta, sizeof(meta));
+}
+
+njones::audio::a2m::MidiFileWriter::~MidiFileWriter() {
+    if (file.is_open())
+        close();
+}
+
+void njones::audio::a2m::MidiFileWriter::note_on(const double seconds,
+                                                  const unsigned int pitch,
+                                                  const unsigned int velocity) {
+    write_event(seconds, 0x90, static_cast<uint8_t>(pitch & 0x7F), static_cast<uint8_t>(std::min(velocity, 127u)));
+}
+
+void njones::audio::a2m::MidiFileWriter::note_off(const double seconds, const unsigned int pitch) {
+    write_event(seconds, 0x80, static_cast<uint8_t>(pitch & 0x7F), 0);
+}
+
+void njones::audio::a2m::MidiFileWriter::aftertouch(const double seconds,
+                                                     const unsigned int pitch,
+                                                     const unsigned int pressure) {
+    write_event(seconds, 0xA0, static_cast<uint8_t>(pitch & 0x7F), static_cast<uint8_t>(std::min(pressure, 127u)));
+}
+
+void njones::audio::a2m::MidiFileWriter::write_event(const double seconds,
+                                                     const uint8_t status,
+                                                     const uint8_t data1,
+                                                     const uint8_t data2) {
+    const uint64_t tick = std::max(last_tick, static_cast<uint64_t>(llround(seconds * ticks_per_second)));
+    write_delta(tick - last_tick);
+    last_tick = tick;
+
+    const char bytes[] = {static_cast<char>(status), static_cast<char>(data1), static_cast<char>(data2)};
+    file.write(bytes, sizeof(bytes));
+    ++nevents;
+}
+
+void njones::audio::a2m::MidiFileWriter::write_delta(const uint64_t ticks) {
+    // Variable length quantity: 7 bits per byte, most significant first, continuation bit set on all but the last.
+    char bytes[10];
+    size_t count = 0;
+    uint64_t value = ticks;
+    do {
+        bytes[count++] = static_cast<char>(value & 0x7F);
+        value >>= 7;
+    } while (value > 0);
+
+    for (size_t i = count; i > 0; --i)
+        file.put(static_cast<char>(bytes[i - 1] | (i > 1 ? 0x80 : 0x00)));
+}
+
+void njones::audio::a2m::MidiFileWriter::close() {
+    const char end_of_track[] = {0x00, static_cast<char>(0xFF), 0x2F, 0x00};
+    file.write(end_of_track, sizeof(end_of_track));
+
+    const std::streampos end = file.tellp();
+    file.seekp(track_start);
+    write_u32(file, static_cast<uint32_t>(end - track_start - 4));
+    file.close();
+}
+
+size_t njones::audio::a2m::MidiFileWriter::get_nevents() const {
+    return nevents;
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <stdint.h>
+#include <fstream>
+#include <string>
+
+namespace njones {
+namespace audio {
+namespace a2m {
+/**
+ * @brief Writes a single track (format 0) Standard MIDI File.
+ * Events are streamed to disk as they are added, so memory use does not grow with the length of
+ * the file. Events must be added in non-decreasing time order.
+ */
+class MidiFileWriter {
+   public:
+    /**
+     * @param path
+     * @param ticks_per_quarter The time resolution of the file.
+     * @param tempo The tempo in microseconds per quarter note, used to convert seconds into ticks.
+     */
+    MidiFileWriter(const std::string& path,
+                   const unsigned int ticks_per_quarter = 480,
+                   const unsigned int tempo = 500000);
+    /**
+     * @brief Closes the file if close() has not been called.
+     */
+    ~MidiFileWriter();
+
+    void note_on(const double seconds, const unsigned int pitch, const unsigned int velocity);
+    void note_off(const double seconds, const unsigned int pitch);
+    /**
+     * @brief Writes a polyphonic key pressure event, used to report velocity changes of a sounding note.
+     */
+    void aftertouch(const double seconds, const unsigned int pitch, const unsigned int pressure);
+
+    /**
+     * @brief Writes the end of track event and the final track length.
+     */
+    void close();
+
+    size_t get_nevents() const;
+
+   private:
+    MidiFileWriter(const MidiFileWriter&) = delete;
+    MidiFileWriter(MidiFileWriter&&) = delete;
+
+    void write_event(const double seconds, const uint8_t status, const uint8_t data1, const uint8_t data2);
+    void write_delta(const uint64_t ticks);
+
+    std::ofstream file;
+    double ticks_per_second;
+    uint64_t last_tick;
+    std::streampos track_start;
+    size_t nevents;
+};
+}  // namespace a2m
+}  // namespace audio
+}  // namespace njones
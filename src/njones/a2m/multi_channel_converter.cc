@@ -0,0 +1,104 @@
+#include "multi_channel_converter.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+// The channels the base class analyses, checked before it builds its tables and plan.
+unsigned int analysis_channels(const unsigned int nchannels, const bool mono_mix) {
+    if (nchannels == 0)
+        throw std::invalid_argument("A multi-channel converter needs at least one channel.");
+    return mono_mix ? 1 : nchannels;
+}
+}  // namespace
+
+template <class SampleType>
+njones::audio::a2m::BasicMultiChannelConverter<SampleType>::BasicMultiChannelConverter(
+    const unsigned int nchannels,
+    const unsigned int samplerate,
+    const unsigned int block_size,
+    const Mode mode,
+    const double activation_level,
+    const std::vector<unsigned int> pitch_set,
+    const std::array<unsigned int, 2> pitch_range,
+    const unsigned int note_count,
+    const int transpose,
+    const double ceiling)
+    : BasicConverter<SampleType>(
+          typename BasicConverter<SampleType>::Channels{analysis_channels(nchannels, mode == Mode::MonoMix)},
+                                 samplerate,
+                                 block_size,
+                                 activation_level,
+                                 pitch_set,
+                                 pitch_range,
+                                 note_count,
+                                 transpose,
+                                 ceiling),
+      nchannels(nchannels),
+      mode(mode),
+      accumulators(mode == Mode::Independent ? nchannels : 1) {
+    for (auto& accumulator : accumulators)
+        this->reset(accumulator);
+}
+
+template <class SampleType>
+unsigned int njones::audio::a2m::BasicMultiChannelConverter<SampleType>::get_nchannels() const {
+    return nchannels;
+}
+
+template <class SampleType>
+unsigned int njones::audio::a2m::BasicMultiChannelConverter<SampleType>::get_noutputs() const {
+    return accumulators.size();
+}
+
+template <class SampleType>
+std::vector<std::vector<njones::audio::a2m::Note>> njones::audio::a2m::BasicMultiChannelConverter<SampleType>::convert(
+    SampleType* const* channels) {
+    auto notes = std::vector<njones::audio::a2m::Note>(128 * get_noutputs());
+    auto counts = std::vector<size_t>(get_noutputs());
+    convert(channels, notes, counts);
+
+    auto ret = std::vector<std::vector<njones::audio::a2m::Note>>(get_noutputs());
+    for (size_t output = 0; output < ret.size(); ++output)
+        ret[output].assign(notes.begin() + output * 128, notes.begin() + output * 128 + counts[output]);
+    return ret;
+}
+
+template <class SampleType>
+size_t njones::audio::a2m::BasicMultiChannelConverter<SampleType>::convert(SampleType* const* channels,
+                                                                           std::span<njones::audio::a2m::Note> notes,
+                                                                           std::span<size_t> counts) noexcept {
+    const auto start = this->instrumentation.start();
+    this->acquire();
+    const auto& settings = *this->active;
+    const size_t outputs = std::min<size_t>(get_noutputs(), counts.size());
+    if (this->gate(settings, channels, nchannels, false) == BasicConverter<SampleType>::Gated::Silent) {
+        this->samples_to_freqs(settings, channels, nchannels, mode == Mode::MonoMix, false);
+        std::fill_n(counts.begin(), outputs, 0);
+        this->instrumentation.block(start);
+        return 0;
+    }
+    this->samples_to_freqs(settings, channels, nchannels, mode == Mode::MonoMix);
+
+    const size_t capacity = notes.size() / get_noutputs();
+    size_t total = 0;
+
+    if (mode == Mode::Independent) {
+        for (size_t output = 0; output < outputs; ++output) {
+            this->accumulate(settings, *settings.analysis, output, accumulators[output]);
+            counts[output] = this->emit(settings, accumulators[output], notes.subspan(output * capacity, capacity));
+            total += counts[output];
+        }
+    } else if (outputs > 0) {
+        for (unsigned int channel = 0; channel < settings.analysis->nchannels; ++channel)
+            this->accumulate(settings, *settings.analysis, channel, accumulators[0]);
+        counts[0] = this->emit(settings, accumulators[0], notes.subspan(0, capacity));
+        total = counts[0];
+    }
+
+    this->instrumentation.block(start);
+    return total;
+}
+
+template class njones::audio::a2m::BasicMultiChannelConverter<double>;
+template class njones::audio::a2m::BasicMultiChannelConverter<float>;
@@ -0,0 +1,82 @@
+#pragma once
+#include <njones/a2m/converter.h>
+
+namespace njones {
+namespace audio {
+namespace a2m {
+/**
+ * @brief Converts every channel of a multi-channel block at once. All channels share one set of
+ * mapping tables and are transformed by a single batched FFTW plan over a channel-major buffer,
+ * instead of one plan and one set of tables per channel.
+ * Parameter setters behave as they do for BasicConverter.
+ * @tparam SampleType The sample and FFT precision, either float or double.
+ */
+template <class SampleType>
+class BasicMultiChannelConverter : public BasicConverter<SampleType> {
+   public:
+    enum class Mode {
+        // One note set per channel.
+        Independent,
+        // The magnitudes of every channel are pooled into a single note set.
+        Summed,
+        // The channels are averaged into one signal, which is transformed once.
+        MonoMix
+    };
+
+    /**
+     * @param nchannels The number of channels passed to convert(), at least 1.
+     * @param mode
+     * @throws std::invalid_argument When nchannels is 0.
+     * @see BasicConverter::BasicConverter for the remaining parameters.
+     */
+    BasicMultiChannelConverter(const unsigned int nchannels,
+                               const unsigned int samplerate,
+                               const unsigned int block_size,
+                               const Mode mode = Mode::Independent,
+                               const double activation_level = 0.0,
+                               const std::vector<unsigned int> pitch_set = std::vector<unsigned int>{},
+                               const std::array<unsigned int, 2> pitch_range = std::array<unsigned int, 2>{0, 127},
+                               const unsigned int note_count = 0,
+                               const int transpose = 0,
+                               const double ceiling = 1.0);
+
+    unsigned int get_nchannels() const;
+    /**
+     * @brief The number of note sets produced per block: nchannels in Independent mode, otherwise 1.
+     */
+    unsigned int get_noutputs() const;
+
+    /**
+     * @brief Converts one block of every channel into a2m::Note instances.
+     * @param channels nchannels pointers to block_size (or hop_size) samples each.
+     * @return One note set per output.
+     */
+    std::vector<std::vector<Note>> convert(SampleType* const* channels);
+
+    /**
+     * @brief Converts one block of every channel without allocating, locking or throwing.
+     * @param channels nchannels pointers to block_size (or hop_size) samples each.
+     * @param notes The destination buffer, split evenly between the outputs.
+     * @param counts Receives the number of notes written for each output.
+     * @return The total number of notes written.
+     */
+    size_t convert(SampleType* const* channels, std::span<Note> notes, std::span<size_t> counts) noexcept;
+
+    /**
+     * @brief Batched offline conversion only handles a single channel.
+     */
+    size_t convert_blocks(const SampleType* samples, const size_t nblocks, NoteSink& sink) = delete;
+
+   protected:
+    typedef typename BasicConverter<SampleType>::Accumulator Accumulator;
+
+    unsigned int nchannels;
+    Mode mode;
+    std::vector<Accumulator> accumulators;
+};
+
+typedef BasicMultiChannelConverter<double> MultiChannelConverter;
+typedef BasicMultiChannelConverter<float> FloatMultiChannelConverter;
+}  // namespace a2m
+}  // namespace audio
+}  // namespace njones
@@ -0,0 +1,81 @@
+#include "note_tracker.h"
+#include <algorithm>
+
+njones::audio::a2m::NoteTracker::NoteTracker(const unsigned int on_velocity,
+                                             const unsigned int off_velocity,
+                                             const unsigned int release_blocks,
+                                             const uint64_t min_duration,
+                                             const unsigned int velocity_threshold)
+    : on_velocity(std::max(1u, on_velocity)),
+      off_velocity(std::max(1u, std::min(off_velocity, this->on_velocity))),
+      release_blocks(release_blocks),
+      min_duration(min_duration),
+      velocity_threshold(velocity_threshold) {
+    reset();
+}
+
+size_t njones::audio::a2m::NoteTracker::update(std::span<const Note> notes,
+                                               const uint64_t offset,
+                                               std::span<NoteEvent> events) noexcept {
+    std::array<unsigned int, 128> present{};
+    for (const auto& note : notes)
+        if (note.pitch < 128)
+            present[note.pitch] = std::max(present[note.pitch], note.velocity);
+
+    size_t count = 0;
+    auto push = [&](const NoteEvent::Type type, const unsigned int pitch, const unsigned int velocity) {
+        if (count < events.size())
+            events[count++] = NoteEvent{type, pitch, velocity, offset};
+    };
+
+    for (unsigned int pitch = 0; pitch < 128; ++pitch) {
+        auto& state = pitches[pitch];
+        const unsigned int velocity = present[pitch];
+
+        if (state.sounding) {
+            if (velocity < off_velocity) {
+                if (++state.missing_blocks > release_blocks) {
+                    state.sounding = false;
+                    state.onset = pending_none;
+                    push(NoteEvent::Type::Off, pitch, 0);
+                }
+                continue;
+            }
+
+            state.missing_blocks = 0;
+            const unsigned int change =
+                velocity > state.velocity ? velocity - state.velocity : state.velocity - velocity;
+            if (velocity_threshold > 0 && change >= velocity_threshold) {
+                state.velocity = velocity;
+                push(NoteEvent::Type::Velocity, pitch, velocity);
+            }
+        } else if (velocity >= on_velocity) {
+            if (state.onset == pending_none)
+                state.onset = offset;
+            if (offset - state.onset >= min_duration) {
+                state.sounding = true;
+                state.velocity = velocity;
+                state.missing_blocks = 0;
+                push(NoteEvent::Type::On, pitch, velocity);
+            }
+        } else
+            state.onset = pending_none;
+    }
+
+    return count;
+}
+
+size_t njones::audio::a2m::NoteTracker::flush(const uint64_t offset, std::span<NoteEvent> events) noexcept {
+    size_t count = 0;
+    for (unsigned int pitch = 0; pitch < 128; ++pitch) {
+        auto& state = pitches[pitch];
+        if (state.sounding && count < events.size())
+            events[count++] = NoteEvent{NoteEvent::Type::Off, pitch, 0, offset};
+        state = PitchState{false, 0, 0, pending_none};
+    }
+    return count;
+}
+
+void njones::audio::a2m::NoteTracker::reset() {
+    pitches.fill(PitchState{false, 0, 0, pending_none});
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <njones/a2m/converter.h>
+#include <stdint.h>
+#include <array>
+#include <span>
+
+namespace njones {
+namespace audio {
+namespace a2m {
+/**
+ * @brief A change to the set of sounding notes, positioned in samples from the start of the stream.
+ */
+struct NoteEvent {
+    enum class Type { On, Off, Velocity };
+
+    Type type;
+    unsigned int pitch;
+    // The new velocity for On and Velocity events, 0 for Off events.
+    unsigned int velocity;
+    uint64_t offset;
+};
+
+/**
+ * @brief Turns the note frames produced by a converter into a stream of note-on, note-off and
+ * velocity-change events by keeping per-pitch state across blocks. Frames which repeat the previous
+ * one produce no events at all.
+ */
+class NoteTracker {
+   public:
+    /**
+     * @param on_velocity The velocity a note needs to start sounding.
+     * @param off_velocity The velocity below which a sounding note counts as missing. Setting it
+     * below on_velocity adds hysteresis, so notes hovering around the threshold do not flutter.
+     * @param release_blocks The number of consecutive blocks a sounding note may be missing before
+     * it is switched off.
+     * @param min_duration The number of samples a note must be present for before it is switched on.
+     * Shorter notes produce no events; longer ones start at the block which confirms them.
+     * @param velocity_threshold The change in velocity of a sounding note which produces a Velocity
+     * event, or 0 to never report velocity changes.
+     */
+    NoteTracker(const unsigned int on_velocity = 1,
+                const unsigned int off_velocity = 1,
+                const unsigned int release_blocks = 0,
+                const uint64_t min_duration = 0,
+                const unsigned int velocity_threshold = 0);
+
+    /**
+     * @brief Compares one block's notes against the sounding notes.
+     * Never allocates, so it may run on the audio thread next to the converter.
+     * @param notes The notes a converter returned for the block.
+     * @param offset The position of the block in samples; it must grow from call to call.
+     * @param events The destination. Each pitch produces at most one event per block, so 128
+     * events always suffice; events which do not fit are lost.
+     * @return The number of events written, ordered by pitch.
+     */
+    size_t update(std::span<const Note> notes, const uint64_t offset, std::span<NoteEvent> events) noexcept;
+
+    /**
+     * @brief Switches every sounding note off, for the end of a stream.
+     * @return The number of events written.
+     */
+    size_t flush(const uint64_t offset, std::span<NoteEvent> events) noexcept;
+
+    /**
+     * @brief Forgets every sounding and pending note without producing events.
+     */
+    void reset();
+
+   private:
+    struct PitchState {
+        bool sounding;
+        unsigned int velocity;
+        unsigned int missing_blocks;
+        // The offset the note was first seen at while waiting for min_duration, or pending_none.
+        uint64_t onset;
+    };
+    static constexpr uint64_t pending_none = UINT64_MAX;
+
+    unsigned int on_velocity;
+    unsigned int off_velocity;
+    unsigned int release_blocks;
+    uint64_t min_duration;
+    unsigned int velocity_threshold;
+    std::array<PitchState, 128> pitches;
+};
+}  // namespace a2m
+}  // namespace audio
+}  // namespace njones
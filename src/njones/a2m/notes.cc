@@ -1,19 +1,44 @@
 #include "notes.h"
 
+#include <algorithm>
+
 njones::audio::a2m::note_map njones::audio::a2m::generate_notes() {
     auto notes = njones::audio::a2m::note_map();
+    for (int i = 0; i < 128; ++i)
+        notes[i] = njones::audio::a2m::equal_temperament[i];
+    return notes;
+}
+
+template <class T, class C>
+static T nearest_value(T val, C arr) {
+    auto copy = arr;
+    std::sort(copy.begin(), copy.end());
 
-    // 12th root of 2
-    static const double multiplier = 1.0594630943592953;
+    auto lower = std::lower_bound(copy.begin(), copy.end(), val);
+    auto upper = std::upper_bound(copy.begin(), copy.end(), val);
 
-    // C0
-    notes[0] = njones::audio::a2m::note_range{7.946362749, 8.1757989155, 8.4188780665};
-    for (int i = 1; i < 128; ++i) {
-        notes[i] = njones::audio::a2m::note_range{7.946362749, 8.1757989155, 8.4188780665};
-        notes[i].mid = multiplier * notes[i - 1].mid;
-        notes[i].low = (notes[i].mid + notes[i - 1].mid) / 2.0;
-        notes[i].high = (notes[i].mid + (multiplier * notes[i].mid)) / 2.0;
+    if (lower == copy.end() && upper == copy.end())
+        return arr.back();
+    else if (upper == copy.end())
+        return *lower;
+    else if (lower == copy.end())
+        return *upper;
+    else {
+        auto lower_diff = val - *lower;
+        auto upper_diff = *upper - val;
+
+        if (lower_diff < upper_diff)
+            return *lower;
+        return *upper;
     }
+}
 
-    return notes;
-}
\ No newline at end of file
+unsigned int njones::audio::a2m::snap_to_key(unsigned int pitch, const std::vector<unsigned int>& pitch_set) {
+    if (pitch_set.size() > 0) {
+        unsigned int mod = pitch % 12;
+        pitch = (12 * (pitch / 12)) + nearest_value(mod, pitch_set);
+    }
+    int ret = pitch;
+    ret = std::min(ret, 127);
+    return std::max(0, ret);
+}
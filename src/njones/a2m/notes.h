@@ -1,3 +1,5 @@
+#pragma once
+#include <array>
 #include <map>
 #include <vector>
 
@@ -11,13 +13,47 @@ struct note_range {
 };
 
 typedef std::map<int, note_range> note_map;
+typedef std::array<note_range, 128> note_table;
+
+/**
+ * @brief Computes the note ranges [low, mid, high] of every MIDI pitch in the 12 tone equal temperment
+ * scale. Usable in constant expressions.
+ * @return a2m::note_table
+ */
+constexpr note_table generate_note_table() {
+    // 12th root of 2
+    const double multiplier = 1.0594630943592953;
+
+    // C0
+    note_table notes{};
+    notes[0] = note_range{7.946362749, 8.1757989155, 8.4188780665};
+    for (int i = 1; i < 128; ++i) {
+        notes[i].mid = multiplier * notes[i - 1].mid;
+        notes[i].low = (notes[i].mid + notes[i - 1].mid) / 2.0;
+        notes[i].high = (notes[i].mid + (multiplier * notes[i].mid)) / 2.0;
+    }
+    return notes;
+}
+
+/**
+ * @brief The note ranges of every MIDI pitch, computed at compile time and shared by every converter.
+ */
+inline constexpr note_table equal_temperament = generate_note_table();
 
 /**
  * @brief Generates a map of note ranges [low, mid, high] which can be used to map
- * data returned from FFTs into the 12 tone equal temperment scale.
+ * data returned from FFTs into the 12 tone equal temperment scale. A copy of equal_temperament.
  * @return a2m::note_map
  */
 note_map generate_notes();
+
+/**
+ * @brief Snaps a pitch to the nearest pitch class of pitch_set within its octave, or leaves it as is
+ * when pitch_set is empty.
+ * @param pitch_set Pitch classes in the range [0, 11].
+ * @return The snapped pitch, clamped to [0, 127].
+ */
+unsigned int snap_to_key(unsigned int pitch, const std::vector<unsigned int>& pitch_set);
 }  // namespace a2m
 }  // namespace audio
 }  // namespace njones
\ No newline at end of file
@@ -0,0 +1,243 @@
+#include "pcm_file.h"
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+uint16_t read_u16(const uint8_t* bytes) {
+    return static_cast<uint16_t>(bytes[0] | (bytes[1] << 8));
+}
+
+uint32_t read_u32(const uint8_t* bytes) {
+    return static_cast<uint32_t>(bytes[0]) | (static_cast<uint32_t>(bytes[1]) << 8) |
+           (static_cast<uint32_t>(bytes[2]) << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+}
+
+struct Int16 {
+    static double decode(const uint8_t* bytes) { return static_cast<int16_t>(read_u16(bytes)) / 32768.0; }
+};
+
+struct Int24 {
+    static double decode(const uint8_t* bytes) {
+        int32_t value = bytes[0] | (bytes[1] << 8) | (bytes[2] << 16);
+        if (value & 0x800000)
+            value -= 0x1000000;
+        return value / 8388608.0;
+    }
+};
+
+struct Int32 {
+    static double decode(const uint8_t* bytes) { return static_cast<int32_t>(read_u32(bytes)) / 2147483648.0; }
+};
+
+struct Float32 {
+    static double decode(const uint8_t* bytes) {
+        float value;
+        memcpy(&value, bytes, sizeof(value));
+        return value;
+    }
+};
+
+struct Float64 {
+    static double decode(const uint8_t* bytes) {
+        double value;
+        memcpy(&value, bytes, sizeof(value));
+        return value;
+    }
+};
+
+template <class Decoder, class SampleType>
+void mix_down(const uint8_t* frames,
+              SampleType* samples,
+              const size_t nframes,
+              const unsigned int nchannels,
+              const size_t sample_size) {
+    const double scale = 1.0 / nchannels;
+    for (size_t i = 0; i < nframes; ++i) {
+        double sum = 0.0;
+        for (unsigned int channel = 0; channel < nchannels; ++channel, frames += sample_size)
+            sum += Decoder::decode(frames);
+        samples[i] = static_cast<SampleType>(sum * scale);
+    }
+}
+}  // namespace
+
+size_t njones::audio::a2m::sample_size(const SampleFormat format) {
+    switch (format) {
+        case SampleFormat::Int16:
+            return 2;
+        case SampleFormat::Int24:
+            return 3;
+        case SampleFormat::Int32:
+        case SampleFormat::Float32:
+            return 4;
+        case SampleFormat::Float64:
+            return 8;
+    }
+    return 0;
+}
+
+njones::audio::a2m::PcmFile::PcmFile(const std::string& path)
+    : format{SampleFormat::Int16, 0, 0},
+      data(nullptr),
+      size(0),
+      data_offset(0),
+      frame_size(0),
+      nframes(0),
+      released(0) {
+    map(path);
+    try {
+        parse_wav();
+    } catch (...) {
+        munmap(const_cast<uint8_t*>(data), size);
+        throw;
+    }
+}
+
+njones::audio::a2m::PcmFile::PcmFile(const std::string& path, const PcmFormat& format)
+    : format(format), data(nullptr), size(0), data_offset(0), frame_size(0), nframes(0), released(0) {
+    if (format.nchannels == 0 || format.samplerate == 0)
+        throw std::runtime_error("Raw PCM files need at least one channel and a samplerate.");
+
+    map(path);
+    frame_size = sample_size(format.format) * format.nchannels;
+    nframes = size / frame_size;
+}
+
+njones::audio::a2m::PcmFile::~PcmFile() {
+    if (data != nullptr)
+        munmap(const_cast<uint8_t*>(data), size);
+}
+
+void njones::audio::a2m::PcmFile::map(const std::string& path) {
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("Failed to open " + path + ".");
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        close(fd);
+        throw std::runtime_error("Failed to read " + path + ".");
+    }
+
+    size = static_cast<size_t>(info.st_size);
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED)
+        throw std::runtime_error("Failed to map " + path + ".");
+
+    madvise(mapping, size, MADV_SEQUENTIAL);
+    data = static_cast<const uint8_t*>(mapping);
+}
+
+void njones::audio::a2m::PcmFile::parse_wav() {
+    if (size < 12 || memcmp(data, "RIFF", 4) != 0 || memcmp(data + 8, "WAVE", 4) != 0)
+        throw std::runtime_error("Not a RIFF WAVE file.");
+
+    bool found_format = false;
+    size_t offset = 12;
+    while (offset + 8 <= size) {
+        const uint8_t* chunk = data + offset;
+        const size_t chunk_size = read_u32(chunk + 4);
+        const size_t body = offset + 8;
+
+        if (memcmp(chunk, "fmt ", 4) == 0 && chunk_size >= 16 && body + 16 <= size) {
+            uint16_t encoding = read_u16(data + body);
+            const uint16_t bits = read_u16(data + body + 14);
+            // WAVE_FORMAT_EXTENSIBLE stores the real encoding at the start of its sub-format GUID.
+            if (encoding == 0xFFFE && chunk_size >= 40 && body + 26 <= size)
+                encoding = read_u16(data + body + 24);
+
+            format.nchannels = read_u16(data + body + 2);
+            format.samplerate = read_u32(data + body + 4);
+            if (encoding == 1 && bits == 16)
+                format.format = SampleFormat::Int16;
+            else if (encoding == 1 && bits == 24)
+                format.format = SampleFormat::Int24;
+            else if (encoding == 1 && bits == 32)
+                format.format = SampleFormat::Int32;
+            else if (encoding == 3 && bits == 32)
+                format.format = SampleFormat::Float32;
+            else if (encoding == 3 && bits == 64)
+                format.format = SampleFormat::Float64;
+            else
+                throw std::runtime_error("Unsupported WAVE sample format.");
+            found_format = true;
+        } else if (memcmp(chunk, "data", 4) == 0) {
+            if (!found_format || format.nchannels == 0 || format.samplerate == 0)
+                throw std::runtime_error("WAVE data chunk precedes a valid fmt chunk.");
+
+            data_offset = body;
+            frame_size = sample_size(format.format) * format.nchannels;
+            // Streams written before their length was known leave the size unset or too large.
+            nframes = std::min(chunk_size, size - body) / frame_size;
+            return;
+        }
+
+        offset = body + chunk_size + (chunk_size & 1);
+    }
+
+    throw std::runtime_error("WAVE file has no data chunk.");
+}
+
+const njones::audio::a2m::PcmFormat& njones::audio::a2m::PcmFile::get_format() const {
+    return format;
+}
+
+size_t njones::audio::a2m::PcmFile::get_nframes() const {
+    return nframes;
+}
+
+template <class SampleType>
+void njones::audio::a2m::decode_mono(const PcmFormat& format,
+                                     const uint8_t* frames,
+                                     SampleType* samples,
+                                     const size_t nframes) {
+    const size_t bytes = sample_size(format.format);
+    switch (format.format) {
+        case SampleFormat::Int16:
+            mix_down<Int16>(frames, samples, nframes, format.nchannels, bytes);
+            break;
+        case SampleFormat::Int24:
+            mix_down<Int24>(frames, samples, nframes, format.nchannels, bytes);
+            break;
+        case SampleFormat::Int32:
+            mix_down<Int32>(frames, samples, nframes, format.nchannels, bytes);
+            break;
+        case SampleFormat::Float32:
+            mix_down<Float32>(frames, samples, nframes, format.nchannels, bytes);
+            break;
+        case SampleFormat::Float64:
+            mix_down<Float64>(frames, samples, nframes, format.nchannels, bytes);
+            break;
+    }
+}
+
+template <class SampleType>
+size_t njones::audio::a2m::PcmFile::read_mono(const size_t frame, SampleType* samples, const size_t nframes) const {
+    if (frame >= this->nframes)
+        return 0;
+
+    const size_t count = std::min(nframes, this->nframes - frame);
+    decode_mono(format, data + data_offset + frame * frame_size, samples, count);
+    return count;
+}
+
+void njones::audio::a2m::PcmFile::release(const size_t frame) {
+    const size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    const size_t end = std::min(data_offset + std::min(frame, nframes) * frame_size, size) / page * page;
+    if (end <= released)
+        return;
+
+    madvise(const_cast<uint8_t*>(data) + released, end - released, MADV_DONTNEED);
+    released = end;
+}
+
+template void njones::audio::a2m::decode_mono<double>(const PcmFormat&, const uint8_t*, double*, const size_t);
+template void njones::audio::a2m::decode_mono<float>(const PcmFormat&, const uint8_t*, float*, const size_t);
+template size_t njones::audio::a2m::PcmFile::read_mono<double>(const size_t, double*, const size_t) const;
+template size_t njones::audio::a2m::PcmFile::read_mono<float>(const size_t, float*, const size_t) const;
@@ -0,0 +1,87 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+namespace njones {
+namespace audio {
+namespace a2m {
+/**
+ * @brief The encoding of one interleaved little endian PCM sample.
+ */
+enum class SampleFormat { Int16, Int24, Int32, Float32, Float64 };
+
+struct PcmFormat {
+    SampleFormat format;
+    unsigned int nchannels;
+    unsigned int samplerate;
+};
+
+/**
+ * @brief The size of one encoded sample in bytes.
+ */
+size_t sample_size(const SampleFormat format);
+
+/**
+ * @brief Decodes interleaved frames and mixes their channels down to mono in the range [-1.0, 1.0].
+ * @param format The encoding of frames; its samplerate is ignored.
+ * @param frames nframes * nchannels encoded samples.
+ * @param samples The destination for nframes samples.
+ * @param nframes
+ */
+template <class SampleType>
+void decode_mono(const PcmFormat& format, const uint8_t* frames, SampleType* samples, const size_t nframes);
+
+/**
+ * @brief A read-only, memory-mapped WAV or headerless PCM file.
+ * Frames are decoded on demand, so files of any length are read without loading them into memory;
+ * release() hands pages that have already been read back to the operating system.
+ */
+class PcmFile {
+   public:
+    /**
+     * @brief Opens a RIFF WAVE file holding 16, 24 or 32 bit integer or 32 or 64 bit float samples.
+     */
+    PcmFile(const std::string& path);
+    /**
+     * @brief Opens a headerless file of interleaved samples in the given format.
+     */
+    PcmFile(const std::string& path, const PcmFormat& format);
+    ~PcmFile();
+
+    const PcmFormat& get_format() const;
+    size_t get_nframes() const;
+
+    /**
+     * @brief Decodes frames and mixes their channels down to mono in the range [-1.0, 1.0].
+     * @param frame The first frame to read.
+     * @param samples The destination for up to nframes samples.
+     * @param nframes
+     * @return The number of frames read, less than nframes only at the end of the file.
+     */
+    template <class SampleType>
+    size_t read_mono(const size_t frame, SampleType* samples, const size_t nframes) const;
+
+    /**
+     * @brief Drops the mapped pages before frame from memory. They are reloaded if read again.
+     */
+    void release(const size_t frame);
+
+   private:
+    PcmFile(const PcmFile&) = delete;
+    PcmFile(PcmFile&&) = delete;
+
+    void map(const std::string& path);
+    void parse_wav();
+
+    PcmFormat format;
+    const uint8_t* data;
+    size_t size;
+    size_t data_offset;
+    size_t frame_size;
+    size_t nframes;
+    size_t released;
+};
+}  // namespace a2m
+}  // namespace audio
+}  // namespace njones
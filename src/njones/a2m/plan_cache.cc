@@ -0,0 +1,142 @@
+#include "plan_cache.h"
+
+#include <stdexcept>
+
+template <class SampleType>
+njones::audio::a2m::Plan<SampleType>::Plan(typename FFT<SampleType>::plan plan) : plan(plan) {}
+
+template <class SampleType>
+njones::audio::a2m::Plan<SampleType>::~Plan() {
+    std::lock_guard<std::mutex> guard(PlanCache::planner_lock());
+    FFT<SampleType>::destroy(plan);
+}
+
+njones::audio::a2m::PlanCache::PlanCache() : rigor(PlanRigor::Estimate) {
+    // Constructing the planner lock first guarantees it outlives the cached plans at exit.
+    planner_lock();
+}
+
+njones::audio::a2m::PlanCache& njones::audio::a2m::PlanCache::instance() {
+    static PlanCache cache;
+    return cache;
+}
+
+std::mutex& njones::audio::a2m::PlanCache::planner_lock() {
+    static std::mutex lock;
+    return lock;
+}
+
+void njones::audio::a2m::PlanCache::set_rigor(const njones::audio::a2m::PlanRigor rigor) {
+    std::lock_guard<std::mutex> guard(planner_lock());
+    this->rigor = rigor;
+}
+
+njones::audio::a2m::PlanRigor njones::audio::a2m::PlanCache::get_rigor() {
+    std::lock_guard<std::mutex> guard(planner_lock());
+    return rigor;
+}
+
+void njones::audio::a2m::PlanCache::clear() {
+    std::map<Key, std::shared_ptr<const Plan<double>>> released_double_plans;
+    std::map<Key, std::shared_ptr<const Plan<float>>> released_float_plans;
+    {
+        std::lock_guard<std::mutex> guard(planner_lock());
+        released_double_plans.swap(double_plans);
+        released_float_plans.swap(float_plans);
+    }
+    // The plans are destroyed here, outside the planner lock which their destructors take.
+}
+
+namespace njones {
+namespace audio {
+namespace a2m {
+template <>
+std::map<PlanCache::Key, std::shared_ptr<const Plan<double>>>& PlanCache::plans<double>() {
+    return double_plans;
+}
+
+template <>
+std::map<PlanCache::Key, std::shared_ptr<const Plan<float>>>& PlanCache::plans<float>() {
+    return float_plans;
+}
+}  // namespace a2m
+}  // namespace audio
+}  // namespace njones
+
+template <class SampleType>
+std::shared_ptr<const njones::audio::a2m::Plan<SampleType>> njones::audio::a2m::PlanCache::plan(
+    const int n,
+    const int howmany,
+    SampleType* in,
+    typename FFT<SampleType>::complex* out) {
+    typedef typename FFT<SampleType>::complex Complex;
+
+    const bool aligned = FFT<SampleType>::alignment_of(in) == 0 &&
+                         FFT<SampleType>::alignment_of(reinterpret_cast<SampleType*>(out)) == 0;
+
+    std::lock_guard<std::mutex> guard(planner_lock());
+    const Key key(n, howmany, aligned, rigor);
+    auto& cache = plans<SampleType>();
+    auto found = cache.find(key);
+    if (found != cache.end())
+        return found->second;
+
+    unsigned int flags = FFTW_ESTIMATE;
+    if (rigor == PlanRigor::Measure)
+        flags = FFTW_MEASURE;
+    else if (rigor == PlanRigor::Patient)
+        flags = FFTW_PATIENT;
+    if (!aligned)
+        flags |= FFTW_UNALIGNED;
+
+    // Measuring overwrites the arrays being planned, so plan on scratch buffers with the same layout
+    // and execute the plan on the caller's buffers with the new-array interface.
+    const int stride = n / 2 + 1;
+    auto scratch_in = (SampleType*)FFT<SampleType>::malloc(sizeof(SampleType) * n * howmany);
+    auto scratch_out = (Complex*)FFT<SampleType>::malloc(sizeof(Complex) * stride * howmany);
+    typename FFT<SampleType>::plan plan = nullptr;
+    if (scratch_in != nullptr && scratch_out != nullptr) {
+        if (howmany == 1)
+            plan = FFT<SampleType>::plan_r2c(n, scratch_in, scratch_out, flags);
+        else
+            plan = FFT<SampleType>::plan_many_r2c(n, howmany, scratch_in, n, scratch_out, stride, flags);
+    }
+    FFT<SampleType>::free(scratch_in);
+    FFT<SampleType>::free(scratch_out);
+
+    if (plan == nullptr)
+        throw std::runtime_error("Failed to create FFT plan.");
+
+    auto ret = std::make_shared<const Plan<SampleType>>(plan);
+    cache[key] = ret;
+    return ret;
+}
+
+template <class SampleType>
+bool njones::audio::a2m::PlanCache::import_wisdom(const std::string& path) {
+    std::lock_guard<std::mutex> guard(planner_lock());
+    return FFT<SampleType>::import_wisdom(path.c_str());
+}
+
+template <class SampleType>
+bool njones::audio::a2m::PlanCache::export_wisdom(const std::string& path) {
+    std::lock_guard<std::mutex> guard(planner_lock());
+    return FFT<SampleType>::export_wisdom(path.c_str());
+}
+
+template class njones::audio::a2m::Plan<double>;
+template class njones::audio::a2m::Plan<float>;
+template std::shared_ptr<const njones::audio::a2m::Plan<double>> njones::audio::a2m::PlanCache::plan<double>(
+    const int,
+    const int,
+    double*,
+    fftw_complex*);
+template std::shared_ptr<const njones::audio::a2m::Plan<float>> njones::audio::a2m::PlanCache::plan<float>(
+    const int,
+    const int,
+    float*,
+    fftwf_complex*);
+template bool njones::audio::a2m::PlanCache::import_wisdom<double>(const std::string&);
+template bool njones::audio::a2m::PlanCache::import_wisdom<float>(const std::string&);
+template bool njones::audio::a2m::PlanCache::export_wisdom<double>(const std::string&);
+template bool njones::audio::a2m::PlanCache::export_wisdom<float>(const std::string&);
@@ -0,0 +1,107 @@
+#pragma once
+#include <njones/a2m/fft.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+
+namespace njones {
+namespace audio {
+namespace a2m {
+/**
+ * @brief How much time FFTW may spend searching for a fast plan, mirroring FFTW_ESTIMATE,
+ * FFTW_MEASURE and FFTW_PATIENT.
+ */
+enum class PlanRigor { Estimate, Measure, Patient };
+
+/**
+ * @brief A batch of real to complex transforms which may be executed on any pair of buffers
+ * with the size, layout and alignment it was planned for. Execution is thread safe.
+ */
+template <class SampleType>
+class Plan {
+   public:
+    Plan(typename FFT<SampleType>::plan plan);
+    ~Plan();
+
+    void execute(SampleType* in, typename FFT<SampleType>::complex* out) const {
+        FFT<SampleType>::execute_r2c(plan, in, out);
+    }
+
+   private:
+    Plan(const Plan&) = delete;
+    Plan(Plan&&) = delete;
+
+    typename FFT<SampleType>::plan plan;
+};
+
+/**
+ * @brief A process-wide cache of FFTW plans shared by every converter, so converters with the same
+ * block size plan once and block size changes back to a known size are near instant.
+ * All FFTW planner access goes through the cache because the planner is not thread safe.
+ */
+class PlanCache {
+   public:
+    static PlanCache& instance();
+
+    /**
+     * @brief Sets the rigor used for plans created from now on. Plans already cached are kept.
+     */
+    void set_rigor(const PlanRigor rigor);
+    PlanRigor get_rigor();
+
+    /**
+     * @brief Returns a plan for howmany transforms of n samples, laid out contiguously at a
+     * distance of n input samples and n / 2 + 1 output values, creating it if needed.
+     * Planning never writes to in or out, regardless of the rigor.
+     */
+    template <class SampleType>
+    std::shared_ptr<const Plan<SampleType>> plan(const int n,
+                                                 const int howmany,
+                                                 SampleType* in,
+                                                 typename FFT<SampleType>::complex* out);
+
+    /**
+     * @brief Imports FFTW wisdom of the given precision, so later plans of any rigor covered by
+     * the wisdom are created without measuring.
+     * @return false if the file could not be read.
+     */
+    template <class SampleType>
+    bool import_wisdom(const std::string& path);
+
+    /**
+     * @brief Exports the FFTW wisdom of the given precision accumulated by this process.
+     * @return false if the file could not be written.
+     */
+    template <class SampleType>
+    bool export_wisdom(const std::string& path);
+
+    /**
+     * @brief Releases every cached plan. Plans still used by converters stay alive until released.
+     */
+    void clear();
+
+    /**
+     * @brief Serialises every call into the FFTW planner.
+     */
+    static std::mutex& planner_lock();
+
+   private:
+    // size, batch count, aligned, rigor
+    typedef std::tuple<int, int, bool, PlanRigor> Key;
+
+    PlanCache();
+    PlanCache(const PlanCache&) = delete;
+    PlanCache(PlanCache&&) = delete;
+
+    template <class SampleType>
+    std::map<Key, std::shared_ptr<const Plan<SampleType>>>& plans();
+
+    PlanRigor rigor;
+    std::map<Key, std::shared_ptr<const Plan<double>>> double_plans;
+    std::map<Key, std::shared_ptr<const Plan<float>>> float_plans;
+};
+}  // namespace a2m
+}  // namespace audio
+}  // namespace njones
@@ -0,0 +1,57 @@
+#pragma once
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace njones {
+namespace audio {
+namespace a2m {
+/**
+ * @brief A process-wide registry of immutable tables, so converters with the same configuration share
+ * one copy of each instead of building their own.
+ * Tables are held weakly and freed with the last converter using them, unlike FFT plans, which are
+ * kept for the life of the PlanCache. Only parameter setters use the registry, never convert().
+ * @tparam Key An ordered key holding every parameter the table is built from.
+ * @tparam Value The table type.
+ */
+template <class Key, class Value>
+class SharedTables {
+   public:
+    /**
+     * @brief Returns the table for key, calling build to create it if no converter holds it right now.
+     */
+    template <class Build>
+    std::shared_ptr<const Value> get(const Key& key, Build&& build) {
+        std::lock_guard<std::mutex> guard(lock);
+        auto found = tables.find(key);
+        if (found != tables.end())
+            if (auto table = found->second.lock())
+                return table;
+
+        // Allocated separately from its control block, which the registry's weak reference keeps alive,
+        // so the table itself is freed as soon as the last converter releases it.
+        std::shared_ptr<const Value> table(new Value(build()));
+        for (auto it = tables.begin(); it != tables.end();)
+            it = it->second.expired() ? tables.erase(it) : std::next(it);
+        tables[key] = table;
+        return table;
+    }
+
+    /**
+     * @brief The number of tables currently alive.
+     */
+    size_t size() {
+        std::lock_guard<std::mutex> guard(lock);
+        size_t count = 0;
+        for (const auto& [key, table] : tables)
+            count += table.expired() ? 0 : 1;
+        return count;
+    }
+
+   private:
+    std::mutex lock;
+    std::map<Key, std::weak_ptr<const Value>> tables;
+};
+}  // namespace a2m
+}  // namespace audio
+}  // namespace njones
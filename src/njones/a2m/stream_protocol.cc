@@ -0,0 +1,90 @@
+#include "stream_protocol.h"
+#include <string.h>
+
+namespace {
+// Bounds on what a client may ask of a server, so one connection cannot claim unbounded memory.
+constexpr unsigned int max_channels = 32;
+constexpr unsigned int min_samplerate = 1000;
+constexpr unsigned int max_samplerate = 768000;
+constexpr unsigned int min_block_size = 64;
+constexpr unsigned int max_block_size = 65536;
+
+void write_u16(uint8_t* bytes, const uint16_t value) {
+    bytes[0] = static_cast<uint8_t>(value);
+    bytes[1] = static_cast<uint8_t>(value >> 8);
+}
+
+void write_u32(uint8_t* bytes, const uint32_t value) {
+    for (int i = 0; i < 4; ++i)
+        bytes[i] = static_cast<uint8_t>(value >> (8 * i));
+}
+
+uint16_t read_u16(const uint8_t* bytes) {
+    return static_cast<uint16_t>(bytes[0] | (bytes[1] << 8));
+}
+
+uint32_t read_u32(const uint8_t* bytes) {
+    return static_cast<uint32_t>(bytes[0]) | (static_cast<uint32_t>(bytes[1]) << 8) |
+           (static_cast<uint32_t>(bytes[2]) << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+}
+}  // namespace
+
+void njones::audio::a2m::encode_hello(const StreamHello& hello, uint8_t* bytes) {
+    const float activation_level = static_cast<float>(hello.activation_level);
+    write_u32(bytes, StreamHello::magic);
+    bytes[4] = static_cast<uint8_t>(hello.format.format);
+    bytes[5] = static_cast<uint8_t>(hello.format.nchannels);
+    bytes[6] = static_cast<uint8_t>(hello.window);
+    bytes[7] = static_cast<uint8_t>(hello.octave_levels);
+    write_u32(bytes + 8, hello.format.samplerate);
+    write_u32(bytes + 12, hello.block_size);
+    write_u32(bytes + 16, hello.hop_size);
+    memcpy(bytes + 20, &activation_level, sizeof(activation_level));
+}
+
+bool njones::audio::a2m::decode_hello(const uint8_t* bytes, StreamHello& hello) {
+    if (read_u32(bytes) != StreamHello::magic)
+        return false;
+    if (bytes[4] > static_cast<uint8_t>(SampleFormat::Float64) || bytes[6] > static_cast<uint8_t>(Window::Blackman))
+        return false;
+
+    float activation_level;
+    memcpy(&activation_level, bytes + 20, sizeof(activation_level));
+    hello.format = PcmFormat{static_cast<SampleFormat>(bytes[4]), bytes[5], read_u32(bytes + 8)};
+    hello.window = static_cast<Window>(bytes[6]);
+    hello.octave_levels = bytes[7];
+    hello.block_size = read_u32(bytes + 12);
+    hello.hop_size = read_u32(bytes + 16);
+    hello.activation_level = activation_level;
+
+    return hello.format.nchannels >= 1 && hello.format.nchannels <= max_channels &&
+           hello.format.samplerate >= min_samplerate && hello.format.samplerate <= max_samplerate &&
+           hello.block_size >= min_block_size && hello.block_size <= max_block_size &&
+           hello.hop_size <= hello.block_size && hello.activation_level >= 0.0 && hello.activation_level <= 1.0;
+}
+
+size_t njones::audio::a2m::encode_frame(const uint32_t block,
+                                        std::span<const NoteEvent> events,
+                                        const uint16_t flags,
+                                        uint8_t* bytes) {
+    write_u32(bytes, block);
+    write_u16(bytes + 4, static_cast<uint16_t>(events.size()));
+    write_u16(bytes + 6, flags);
+
+    uint8_t* event = bytes + FrameHeader::size;
+    for (const auto& note : events) {
+        event[0] = static_cast<uint8_t>(note.type);
+        event[1] = static_cast<uint8_t>(note.pitch);
+        event[2] = static_cast<uint8_t>(note.velocity);
+        event += FrameHeader::event_size;
+    }
+    return frame_size(events.size());
+}
+
+njones::audio::a2m::FrameHeader njones::audio::a2m::decode_frame_header(const uint8_t* bytes) {
+    return FrameHeader{read_u32(bytes), read_u16(bytes + 4), read_u16(bytes + 6)};
+}
+
+njones::audio::a2m::NoteEvent njones::audio::a2m::decode_event(const uint8_t* bytes, const uint64_t offset) {
+    return NoteEvent{static_cast<NoteEvent::Type>(bytes[0]), bytes[1], bytes[2], offset};
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include <njones/a2m/note_tracker.h>
+#include <njones/a2m/pcm_file.h>
+#include <njones/a2m/window.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <span>
+
+namespace njones {
+namespace audio {
+namespace a2m {
+/**
+ * @brief The parameters a client sends once at the start of a stream, before its PCM data.
+ * On the wire it takes hello_size bytes, every field little endian in declaration order:
+ * magic u32, format u8, nchannels u8, window u8, octave_levels u8, samplerate u32, block_size u32,
+ * hop_size u32 and activation_level f32. The rest of the connection carries interleaved frames in
+ * format, until the client shuts down its side.
+ */
+struct StreamHello {
+    static constexpr uint32_t magic = 0x534d3241;  // "A2MS"
+    static constexpr size_t size = 24;
+
+    PcmFormat format;
+    Window window;
+    unsigned int octave_levels;
+    unsigned int block_size;
+    // The samples per note frame, or 0 for non-overlapping blocks of block_size.
+    unsigned int hop_size;
+    double activation_level;
+};
+
+/**
+ * @brief Precedes the events of every note frame a server sends, one frame per hop of the stream.
+ * On the wire it takes size bytes: block u32, nevents u16 and flags u16, followed by nevents events
+ * of event_size bytes each: type u8, pitch u8 and velocity u8. Events are positioned at the end of
+ * their block, so a client recovers the sample offset as (block + 1) * hop_size.
+ */
+struct FrameHeader {
+    static constexpr size_t size = 8;
+    static constexpr size_t event_size = 3;
+    // Set on the last frame of a stream, which switches every sounding note off.
+    static constexpr uint16_t final = 1;
+
+    uint32_t block;
+    uint16_t nevents;
+    uint16_t flags;
+};
+
+/**
+ * @brief Writes hello into StreamHello::size bytes.
+ */
+void encode_hello(const StreamHello& hello, uint8_t* bytes);
+
+/**
+ * @brief Reads StreamHello::size bytes into hello.
+ * @return false when the magic does not match or a parameter is outside what a server accepts: 1 to 32
+ * channels, 1 kHz to 768 kHz, blocks of 64 to 65536 samples, a hop no longer than the block and an
+ * activation level in [0, 1].
+ */
+bool decode_hello(const uint8_t* bytes, StreamHello& hello);
+
+/**
+ * @brief The number of bytes a frame of nevents events takes on the wire.
+ */
+constexpr size_t frame_size(const size_t nevents) {
+    return FrameHeader::size + nevents * FrameHeader::event_size;
+}
+
+/**
+ * @brief Writes a frame into frame_size(events.size()) bytes. Never allocates.
+ * @return The number of bytes written.
+ */
+size_t encode_frame(const uint32_t block, std::span<const NoteEvent> events, const uint16_t flags, uint8_t* bytes);
+
+/**
+ * @brief Reads the header of a frame from FrameHeader::size bytes.
+ */
+FrameHeader decode_frame_header(const uint8_t* bytes);
+
+/**
+ * @brief Reads one event of a frame.
+ * @param offset The sample offset of the frame, copied into the event.
+ */
+NoteEvent decode_event(const uint8_t* bytes, const uint64_t offset);
+}  // namespace a2m
+}  // namespace audio
+}  // namespace njones
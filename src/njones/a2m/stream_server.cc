@@ -0,0 +1,295 @@
+#include "stream_server.h"
+#include <algorithm>
+
+namespace {
+// Hops converted per pool task before the connection yields to the others.
+constexpr size_t batch_hops = 8;
+// Encoded frames waiting to be sent before a connection stops reading.
+constexpr size_t max_queued_bytes = 64 * 1024;
+}  // namespace
+
+/**
+ * @brief One stream. Everything except the conversion state runs on the connection's strand; the
+ * converter, tracker and scratch buffers are touched only by the single pool task converting it,
+ * which hands its encoded frames back by posting to the strand.
+ */
+template <class SampleType>
+class njones::audio::a2m::BasicStreamServer<SampleType>::Connection
+    : public std::enable_shared_from_this<Connection> {
+   public:
+    Connection(BasicStreamServer& server, boost::asio::ip::tcp::socket socket)
+        : server(server),
+          socket(std::move(socket)),
+          hop(0),
+          hop_bytes(0),
+          received(0),
+          consumed(0),
+          reading(false),
+          converting(false),
+          writing(false),
+          eof(false),
+          finished(false),
+          closed(false),
+          block(0) {}
+
+    ~Connection() { server.active.fetch_sub(1, std::memory_order_relaxed); }
+
+    void start() {
+        boost::system::error_code err;
+        socket.set_option(boost::asio::ip::tcp::no_delay(true), err);
+        boost::asio::async_read(socket, boost::asio::buffer(hello_bytes),
+                                [self = this->shared_from_this()](const boost::system::error_code& err, size_t) {
+                                    self->on_hello(err);
+                                });
+    }
+
+   private:
+    void on_hello(const boost::system::error_code& err) {
+        if (err)
+            return close();
+        if (!decode_hello(hello_bytes.data(), hello)) {
+            server.rejected.fetch_add(1, std::memory_order_relaxed);
+            return close();
+        }
+
+        hop = hello.hop_size > 0 ? hello.hop_size : hello.block_size;
+        hop_bytes = hop * hello.format.nchannels * sample_size(hello.format.format);
+        inbox.resize(server.buffered_hops * hop_bytes);
+        queued.reserve(max_queued_bytes);
+        outgoing.reserve(max_queued_bytes);
+
+        // Planning a new block size can take a while, so the converter is built on the pool.
+        server.pool.submit([self = this->shared_from_this()]() {
+            self->create_converter();
+            boost::asio::post(self->socket.get_executor(), [self]() { self->read(); });
+        });
+    }
+
+    void create_converter() {
+        converter = std::make_unique<BasicConverter<SampleType>>(hello.format.samplerate, hello.block_size,
+                                                                 hello.activation_level);
+        converter->set_hop_size(hello.hop_size);
+        converter->set_window(hello.window);
+        converter->set_octave_levels(hello.octave_levels);
+        samples.resize(hop);
+        encoded.reserve(batch_hops * frame_size(notes.size()));
+    }
+
+    void read() {
+        const size_t buffered = received - consumed;
+        if (reading || eof || closed || buffered == inbox.size() || queued.size() >= max_queued_bytes)
+            return;
+
+        // The ring holds whole hops, so a hop never wraps; a read may stop at the end and continue at the start.
+        const size_t start = received % inbox.size();
+        const size_t length = std::min(inbox.size() - buffered, inbox.size() - start);
+        reading = true;
+        socket.async_read_some(
+            boost::asio::buffer(inbox.data() + start, length),
+            [self = this->shared_from_this()](const boost::system::error_code& err, const size_t nbytes) {
+                self->on_read(err, nbytes);
+            });
+    }
+
+    void on_read(const boost::system::error_code& err, const size_t nbytes) {
+        reading = false;
+        received += nbytes;
+        server.bytes_received.fetch_add(nbytes, std::memory_order_relaxed);
+        if (err == boost::asio::error::eof)
+            eof = true;
+        else if (err)
+            return close();
+
+        convert();
+        read();
+    }
+
+    void convert() {
+        if (converting || closed)
+            return;
+
+        const size_t nhops = std::min((received - consumed) / hop_bytes, batch_hops);
+        if (nhops == 0) {
+            // A partial hop left at the end of a stream is dropped.
+            if (eof)
+                finish();
+            return;
+        }
+
+        converting = true;
+        server.pool.submit([self = this->shared_from_this(), begin = consumed, nhops]() {
+            self->convert_hops(begin, nhops);
+            boost::asio::post(self->socket.get_executor(), [self, nhops]() { self->on_converted(nhops); });
+        });
+    }
+
+    void convert_hops(const uint64_t begin, const size_t nhops) {
+        for (size_t i = 0; i < nhops; ++i, ++block) {
+            const uint8_t* frames = inbox.data() + (begin + i * hop_bytes) % inbox.size();
+            decode_mono(hello.format, frames, samples.data(), hop);
+            const size_t nnotes = converter->convert(samples.data(), std::span<Note>(notes));
+            const size_t nevents = tracker.update(std::span<const Note>(notes.data(), nnotes),
+                                                  static_cast<uint64_t>(block + 1) * hop, events);
+            append_frame(block, nevents, 0);
+        }
+    }
+
+    void on_converted(const size_t nhops) {
+        consumed += nhops * hop_bytes;
+        converting = false;
+        server.blocks.fetch_add(nhops, std::memory_order_relaxed);
+        queued.insert(queued.end(), encoded.begin(), encoded.end());
+        encoded.clear();
+
+        write();
+        convert();
+        read();
+    }
+
+    void finish() {
+        if (finished)
+            return;
+        finished = true;
+        const size_t nevents = tracker.flush(static_cast<uint64_t>(block) * hop, events);
+        append_frame(block, nevents, FrameHeader::final);
+        queued.insert(queued.end(), encoded.begin(), encoded.end());
+        encoded.clear();
+        write();
+    }
+
+    void append_frame(const uint32_t index, const size_t nevents, const uint16_t flags) {
+        const size_t offset = encoded.size();
+        encoded.resize(offset + frame_size(nevents));
+        encode_frame(index, std::span<const NoteEvent>(events.data(), nevents), flags, encoded.data() + offset);
+    }
+
+    void write() {
+        if (writing || closed)
+            return;
+        if (queued.empty()) {
+            if (finished) {
+                boost::system::error_code err;
+                socket.shutdown(boost::asio::ip::tcp::socket::shutdown_send, err);
+                close();
+            }
+            return;
+        }
+
+        std::swap(queued, outgoing);
+        writing = true;
+        boost::asio::async_write(
+            socket, boost::asio::buffer(outgoing),
+            [self = this->shared_from_this()](const boost::system::error_code& err, const size_t nbytes) {
+                self->on_write(err, nbytes);
+            });
+    }
+
+    void on_write(const boost::system::error_code& err, const size_t nbytes) {
+        writing = false;
+        outgoing.clear();
+        server.bytes_sent.fetch_add(nbytes, std::memory_order_relaxed);
+        if (err)
+            return close();
+
+        write();
+        read();
+    }
+
+    void close() {
+        if (closed)
+            return;
+        closed = true;
+        boost::system::error_code err;
+        socket.close(err);
+    }
+
+    BasicStreamServer& server;
+    boost::asio::ip::tcp::socket socket;
+    std::array<uint8_t, StreamHello::size> hello_bytes;
+    StreamHello hello;
+    unsigned int hop;
+    size_t hop_bytes;
+
+    // Guarded by the strand. Bytes [consumed, received) of the stream are buffered in the inbox.
+    std::vector<uint8_t> inbox;
+    uint64_t received;
+    uint64_t consumed;
+    bool reading;
+    bool converting;
+    bool writing;
+    bool eof;
+    bool finished;
+    bool closed;
+    std::vector<uint8_t> queued;
+    std::vector<uint8_t> outgoing;
+
+    // Owned by the conversion task while converting is set, and by the strand otherwise.
+    std::unique_ptr<BasicConverter<SampleType>> converter;
+    NoteTracker tracker;
+    std::vector<SampleType> samples;
+    std::array<Note, 128> notes;
+    std::array<NoteEvent, 128> events;
+    std::vector<uint8_t> encoded;
+    uint32_t block;
+};
+
+template <class SampleType>
+njones::audio::a2m::BasicStreamServer<SampleType>::BasicStreamServer(const std::string& address,
+                                                                     const unsigned short port,
+                                                                     const unsigned int nthreads,
+                                                                     const unsigned int nio_threads,
+                                                                     const unsigned int buffered_hops)
+    : buffered_hops(std::max(2u, buffered_hops)),
+      connections(0),
+      active(0),
+      rejected(0),
+      blocks(0),
+      bytes_received(0),
+      bytes_sent(0),
+      acceptor(io_context, boost::asio::ip::tcp::endpoint(boost::asio::ip::make_address(address), port)),
+      pool(nthreads) {
+    accept();
+    for (unsigned int i = 0; i < std::max(1u, nio_threads); ++i)
+        io_threads.emplace_back([this]() { io_context.run(); });
+}
+
+template <class SampleType>
+njones::audio::a2m::BasicStreamServer<SampleType>::~BasicStreamServer() {
+    io_context.stop();
+    for (auto& thread : io_threads)
+        thread.join();
+}
+
+template <class SampleType>
+unsigned short njones::audio::a2m::BasicStreamServer<SampleType>::get_port() const {
+    return acceptor.local_endpoint().port();
+}
+
+template <class SampleType>
+njones::audio::a2m::StreamServerStats njones::audio::a2m::BasicStreamServer<SampleType>::get_stats() const {
+    return StreamServerStats{connections.load(std::memory_order_relaxed),
+                             active.load(std::memory_order_relaxed),
+                             rejected.load(std::memory_order_relaxed),
+                             blocks.load(std::memory_order_relaxed),
+                             bytes_received.load(std::memory_order_relaxed),
+                             bytes_sent.load(std::memory_order_relaxed)};
+}
+
+template <class SampleType>
+void njones::audio::a2m::BasicStreamServer<SampleType>::accept() {
+    // Each connection's socket runs its handlers on a strand of its own.
+    acceptor.async_accept(boost::asio::make_strand(io_context),
+                          [this](const boost::system::error_code& err, boost::asio::ip::tcp::socket socket) {
+                              if (err == boost::asio::error::operation_aborted)
+                                  return;
+                              if (!err) {
+                                  connections.fetch_add(1, std::memory_order_relaxed);
+                                  active.fetch_add(1, std::memory_order_relaxed);
+                                  std::make_shared<Connection>(*this, std::move(socket))->start();
+                              }
+                              accept();
+                          });
+}
+
+template class njones::audio::a2m::BasicStreamServer<double>;
+template class njones::audio::a2m::BasicStreamServer<float>;
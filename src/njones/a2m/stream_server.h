@@ -0,0 +1,96 @@
+#pragma once
+#include <njones/a2m/converter.h>
+#include <njones/a2m/stream_protocol.h>
+#include <njones/lib/thread_pool.h>
+#include <atomic>
+#include <boost/asio.hpp>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace njones {
+namespace audio {
+namespace a2m {
+/**
+ * @brief Totals across every connection a server has accepted.
+ */
+struct StreamServerStats {
+    uint64_t connections;
+    // Connections still open.
+    uint64_t active;
+    // Connections closed because their StreamHello was invalid.
+    uint64_t rejected;
+    uint64_t blocks;
+    uint64_t bytes_received;
+    uint64_t bytes_sent;
+};
+
+/**
+ * @brief Converts PCM streamed over TCP into note events sent back over the same connection.
+ * Each connection starts with a StreamHello, after which the server answers every hop of PCM with
+ * a note frame; a client ends its stream by shutting down its sending side, which the server
+ * answers with a final frame and by closing the connection.
+ * A few I/O threads receive straight into a fixed ring of encoded frames per connection, and the
+ * connection's own converter decodes and converts whole hops from the ring on a thread pool shared
+ * by every connection, one batch per connection at a time. A connection whose ring or outgoing
+ * frames are full stops reading, so a client sending faster than it is converted, or not reading
+ * its frames, is slowed down by TCP instead of growing the server's buffers.
+ * @tparam SampleType The sample and FFT precision, either float or double.
+ */
+template <class SampleType>
+class BasicStreamServer {
+   public:
+    /**
+     * @param address The local address to listen on, such as "127.0.0.1" or "0.0.0.0".
+     * @param port The port to listen on, or 0 for any free port.
+     * @param nthreads The number of conversion threads shared by every connection.
+     * @param nio_threads The number of threads sending and receiving.
+     * @param buffered_hops The number of hops of PCM each connection buffers ahead of conversion.
+     */
+    BasicStreamServer(const std::string& address,
+                      const unsigned short port,
+                      const unsigned int nthreads = std::thread::hardware_concurrency(),
+                      const unsigned int nio_threads = 1,
+                      const unsigned int buffered_hops = 16);
+    /**
+     * @brief Stops listening and closes every connection without waiting for streams to end.
+     */
+    ~BasicStreamServer();
+
+    /**
+     * @brief The port the server listens on, useful when it was started on port 0.
+     */
+    unsigned short get_port() const;
+
+    StreamServerStats get_stats() const;
+
+   private:
+    BasicStreamServer(const BasicStreamServer&) = delete;
+    BasicStreamServer(BasicStreamServer&&) = delete;
+
+    class Connection;
+
+    void accept();
+
+    unsigned int buffered_hops;
+    std::atomic<uint64_t> connections;
+    std::atomic<uint64_t> active;
+    std::atomic<uint64_t> rejected;
+    std::atomic<uint64_t> blocks;
+    std::atomic<uint64_t> bytes_received;
+    std::atomic<uint64_t> bytes_sent;
+
+    // Destroyed after the pool, whose remaining tasks post their results to connections' strands.
+    boost::asio::io_context io_context;
+    boost::asio::ip::tcp::acceptor acceptor;
+    std::vector<std::thread> io_threads;
+    // Declared last so the workers are joined before anything they use is destroyed.
+    ThreadPool pool;
+};
+
+typedef BasicStreamServer<double> StreamServer;
+typedef BasicStreamServer<float> FloatStreamServer;
+}  // namespace a2m
+}  // namespace audio
+}  // namespace njones
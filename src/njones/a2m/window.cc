@@ -0,0 +1,31 @@
+#include "window.h"
+
+#include <math.h>
+
+std::vector<double> njones::audio::a2m::generate_window(const njones::audio::a2m::Window window,
+                                                        const unsigned int size) {
+    auto coefficients = std::vector<double>(size, 1.0);
+
+    for (unsigned int i = 0; i < size; ++i) {
+        const double phase = 2.0 * M_PI * i / size;
+        switch (window) {
+            case Window::Rectangular:
+                break;
+            case Window::Hann:
+                coefficients[i] = 0.5 - 0.5 * cos(phase);
+                break;
+            case Window::Blackman:
+                coefficients[i] = 0.42 - 0.5 * cos(phase) + 0.08 * cos(2.0 * phase);
+                break;
+        }
+    }
+
+    double sum = 0.0;
+    for (auto coefficient : coefficients)
+        sum += coefficient;
+    if (sum > 0.0)
+        for (auto& coefficient : coefficients)
+            coefficient *= size / sum;
+
+    return coefficients;
+}
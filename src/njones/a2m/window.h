@@ -0,0 +1,22 @@
+#pragma once
+#include <vector>
+
+namespace njones {
+namespace audio {
+namespace a2m {
+/**
+ * @brief The analysis window applied to each block before the FFT.
+ */
+enum class Window { Rectangular, Hann, Blackman };
+
+/**
+ * @brief Generates a periodic analysis window normalized to a mean of 1, so a windowed sinusoid
+ * produces the same peak magnitude as an unwindowed one.
+ * @param window
+ * @param size The number of coefficients.
+ * @return std::vector<double>
+ */
+std::vector<double> generate_window(const Window window, const unsigned int size);
+}  // namespace a2m
+}  // namespace audio
+}  // namespace njones
@@ -0,0 +1,33 @@
+#pragma once
+#include <stddef.h>
+#include <new>
+
+namespace njones {
+namespace audio {
+/**
+ * @brief A standard allocator whose allocations start on a boundary of Alignment bytes, by default a
+ * cache line, so SIMD loads never straddle lines and separate buffers never share one.
+ */
+template <class T, size_t Alignment = 64>
+struct AlignedAllocator {
+    typedef T value_type;
+
+    template <class U>
+    struct rebind {
+        typedef AlignedAllocator<U, Alignment> other;
+    };
+
+    AlignedAllocator() noexcept = default;
+    template <class U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment>&) noexcept {}
+
+    T* allocate(const size_t n) { return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(Alignment))); }
+    void deallocate(T* p, const size_t) noexcept { ::operator delete(p, std::align_val_t(Alignment)); }
+
+    template <class U>
+    bool operator==(const AlignedAllocator<U, Alignment>&) const noexcept {
+        return true;
+    }
+};
+}  // namespace audio
+}  // namespace njones
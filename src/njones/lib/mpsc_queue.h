@@ -0,0 +1,92 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <memory>
+
+namespace njones {
+namespace audio {
+/**
+ * @brief A bounded lock-free queue for many producers and a single consumer.
+ * Every slot carries a sequence number telling producers and the consumer whose turn it is, so
+ * producers only contend on one atomic index and never wait for each other to finish writing.
+ * Elements are written and read in place, so pushing never allocates.
+ * @tparam T A default constructible element type.
+ */
+template <class T>
+class MPSCQueue {
+   public:
+    /**
+     * @param capacity The number of slots, rounded up to a power of two.
+     */
+    MPSCQueue(const size_t capacity) : enqueue_position(0), dequeue_position(0) {
+        size_t size = 2;
+        while (size < capacity)
+            size <<= 1;
+        mask = size - 1;
+        cells = std::make_unique<Cell[]>(size);
+        for (size_t i = 0; i < size; ++i)
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Claims a slot and passes it to fill. Safe to call from any number of threads.
+     * @return false without calling fill when the queue is full.
+     */
+    template <class Fill>
+    bool try_push(Fill&& fill) noexcept {
+        size_t position = enqueue_position.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true) {
+            cell = &cells[position & mask];
+            const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            const intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+            if (difference == 0) {
+                if (enqueue_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                    break;
+            } else if (difference < 0)
+                return false;
+            else
+                position = enqueue_position.load(std::memory_order_relaxed);
+        }
+
+        fill(cell->value);
+        cell->sequence.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Passes the oldest element to drain and releases its slot. Only one thread may consume.
+     * @return false when the queue is empty, or the oldest slot is still being written.
+     */
+    template <class Drain>
+    bool try_pop(Drain&& drain) noexcept {
+        Cell& cell = cells[dequeue_position & mask];
+        if (cell.sequence.load(std::memory_order_acquire) != dequeue_position + 1)
+            return false;
+
+        drain(cell.value);
+        cell.sequence.store(dequeue_position + mask + 1, std::memory_order_release);
+        ++dequeue_position;
+        return true;
+    }
+
+    size_t capacity() const { return mask + 1; }
+
+   private:
+    MPSCQueue(const MPSCQueue&) = delete;
+    MPSCQueue(MPSCQueue&&) = delete;
+
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    std::unique_ptr<Cell[]> cells;
+    size_t mask;
+    // Producers and the consumer update different indices, so they are kept on separate cache lines.
+    alignas(64) std::atomic<size_t> enqueue_position;
+    alignas(64) size_t dequeue_position;
+};
+}  // namespace audio
+}  // namespace njones
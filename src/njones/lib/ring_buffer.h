@@ -1,13 +1,60 @@
 #pragma once
+#include <njones/lib/aligned_allocator.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <algorithm>
 #include <functional>
+#include <limits>
+#include <type_traits>
 #include <vector>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 namespace njones {
 namespace audio {
 template <typename T, typename U>
 concept SameType = std::same_as<T, U>;
 
+/**
+ * @brief A packed little endian 24 bit PCM sample, three bytes wide as in 24 bit WAV data.
+ */
+struct Int24 {
+    uint8_t bytes[3];
+
+    int32_t value() const {
+        const uint32_t bits = static_cast<uint32_t>(bytes[0]) << 8 | static_cast<uint32_t>(bytes[1]) << 16 |
+                              static_cast<uint32_t>(bytes[2]) << 24;
+        return static_cast<int32_t>(bits) >> 8;
+    }
+};
+static_assert(sizeof(Int24) == 3, "Int24 must be packed.");
+
+/**
+ * @brief Converts one sample to ConversionType. Signed integer PCM converted to floating point is scaled
+ * to [-1.0, 1.0), every other conversion is a plain cast.
+ */
+template <class ConversionType, class T>
+ConversionType convert_sample(const T sample) {
+    if constexpr (std::is_same_v<T, Int24>) {
+        if constexpr (std::is_floating_point_v<ConversionType>)
+            return static_cast<ConversionType>(sample.value()) * static_cast<ConversionType>(1.0 / (1 << 23));
+        else
+            return static_cast<ConversionType>(sample.value());
+    } else if constexpr (std::is_integral_v<T> && std::is_signed_v<T> && std::is_floating_point_v<ConversionType>) {
+        constexpr double scale = 1.0 / (static_cast<double>(std::numeric_limits<T>::max()) + 1.0);
+        return static_cast<ConversionType>(sample) * static_cast<ConversionType>(scale);
+    } else {
+        return static_cast<ConversionType>(sample);
+    }
+}
+
+/**
+ * @brief Collects planar or interleaved host buffers of any size into blocks of block_size samples per
+ * channel and calls the processor once per channel for every completed block.
+ * Supported sample formats are float, double and int16_t, Int24 and int32_t PCM.
+ * The blocks are stored channel-major in one allocation, each channel starting on its own cache line.
+ */
 template <class SampleType, class ConversionType = double>
 class RingBuffer {
    public:
@@ -16,7 +63,7 @@ class RingBuffer {
             [](const int, ConversionType*, const int) -> void {},
         int nchannels = 0,
         int block_size = 0)
-        : processor(processor), index(0) {
+        : processor(processor), nchannels(0), block_size(0), index(0), stride(0) {
         resize(nchannels, block_size);
     }
 
@@ -31,6 +78,7 @@ class RingBuffer {
         nchannels = rhs.nchannels;
         block_size = rhs.block_size;
         index = rhs.index;
+        stride = rhs.stride;
         buffer = rhs.buffer;
 
         return *this;
@@ -41,24 +89,23 @@ class RingBuffer {
         nchannels = std::move(rhs.nchannels);
         block_size = std::move(rhs.block_size);
         index = std::move(rhs.index);
+        stride = std::move(rhs.stride);
         buffer = std::move(rhs.buffer);
 
         return *this;
     }
 
     void resize(const int nchannels, const int block_size) {
-        if (nchannels != this->nchannels) {
-            this->nchannels = nchannels;
-            buffer = std::vector<std::vector<ConversionType>>(nchannels);
-            this->block_size = 0;
-            index = 0;
-        }
-        if (this->block_size != block_size) {
-            this->block_size = block_size;
-            for (int i = 0; i < nchannels; ++i)
-                buffer[i] = std::vector<ConversionType>(block_size);
-            index = 0;
-        }
+        if (nchannels == this->nchannels && block_size == this->block_size)
+            return;
+
+        // Channels are padded to whole cache lines so each one starts aligned.
+        constexpr size_t line = std::max<size_t>(1, 64 / sizeof(ConversionType));
+        this->nchannels = nchannels;
+        this->block_size = block_size;
+        stride = (std::max(0, block_size) + line - 1) / line * line;
+        buffer.assign(std::max(0, nchannels) * stride, ConversionType(0));
+        index = 0;
     }
 
     void set_nchannels(const int nchannels) { resize(nchannels, block_size); }
@@ -72,28 +119,63 @@ class RingBuffer {
     int get_nchannels() const { return nchannels; }
     int get_block_size() const { return block_size; }
 
+    /**
+     * @brief Adds planar samples, one buffer of nsamples samples per channel.
+     * When SampleType and ConversionType are the same and a whole block is available in samples, the
+     * processor is called on samples itself without copying, so it must not modify them unless the host
+     * allows it.
+     */
     void add(SampleType** samples, const int nsamples) {
         int remaining = nsamples;
         int offset = 0;
 
         while (remaining > 0) {
+            if constexpr (std::is_same_v<SampleType, ConversionType>) {
+                if (index == 0 && block_size > 0 && remaining >= block_size) {
+                    for (int channel = 0; channel < nchannels; ++channel)
+                        processor(channel, samples[channel] + offset, offset);
+
+                    remaining -= block_size;
+                    offset += block_size;
+                    continue;
+                }
+            }
+
             int max_process = block_size - index;
             int to_process = std::min(remaining, max_process);
 
             for (int channel = 0; channel < nchannels; ++channel) {
-                add_impl(buffer[channel], samples[channel] + offset, to_process, index);
+                add_impl(channel_data(channel) + index, samples[channel] + offset, to_process);
             }
 
             index += to_process;
             remaining -= to_process;
             offset += to_process;
 
-            if (index == block_size) {
-                for (int channel = 0; channel < nchannels; ++channel) {
-                    processor(channel, buffer[channel].data(), offset - block_size);
-                }
-                index = 0;
-            }
+            if (index == block_size)
+                process(offset - block_size);
+        }
+    }
+
+    /**
+     * @brief Adds interleaved samples, nframes frames of one sample per channel.
+     */
+    void add_interleaved(const SampleType* samples, const int nframes) {
+        int remaining = nframes;
+        int offset = 0;
+
+        while (remaining > 0) {
+            int max_process = block_size - index;
+            int to_process = std::min(remaining, max_process);
+
+            deinterleave(samples + static_cast<size_t>(offset) * nchannels, to_process);
+
+            index += to_process;
+            remaining -= to_process;
+            offset += to_process;
+
+            if (index == block_size)
+                process(offset - block_size);
         }
     }
 
@@ -104,17 +186,122 @@ class RingBuffer {
     int nchannels;
     int block_size;
     int index;
+    // The distance between the first samples of two channels.
+    size_t stride;
+
+    std::vector<ConversionType, AlignedAllocator<ConversionType>> buffer;
+
+    ConversionType* channel_data(const int channel) { return buffer.data() + channel * stride; }
+
+    void process(const int offset) {
+        for (int channel = 0; channel < nchannels; ++channel) {
+            processor(channel, channel_data(channel), offset);
+        }
+        index = 0;
+    }
 
-    std::vector<std::vector<ConversionType>> buffer;
-    template <SameType<SampleType> T>
-    void add_impl(std::vector<ConversionType>& dest, const T* src, int count, int dest_offset) {
-        std::copy_n(src, count, dest.begin() + dest_offset);
+    template <SameType<ConversionType> T>
+    static void add_impl(ConversionType* dest, const T* src, int count) {
+        std::copy_n(src, count, dest);
     }
 
+    // Widens float and scales int16 with SSE2, a block of samples at a time.
     template <typename T>
-    void add_impl(std::vector<ConversionType>& dest, const T* src, int count, int dest_offset) {
-        std::transform(src, src + count, dest.begin() + dest_offset,
-                       [](const T& sample) { return static_cast<ConversionType>(sample); });
+    static void add_impl(ConversionType* dest, const T* src, int count) {
+        int i = 0;
+#if defined(__SSE2__)
+        if constexpr (std::is_same_v<T, float> && std::is_same_v<ConversionType, double>) {
+            for (; i + 4 <= count; i += 4) {
+                const __m128 samples = _mm_loadu_ps(src + i);
+                _mm_storeu_pd(dest + i, _mm_cvtps_pd(samples));
+                _mm_storeu_pd(dest + i + 2, _mm_cvtps_pd(_mm_movehl_ps(samples, samples)));
+            }
+        } else if constexpr (std::is_same_v<T, int16_t> && simd_conversion) {
+            for (; i + 8 <= count; i += 8) {
+                const __m128i samples = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+                store_int16(dest + i, _mm_srai_epi32(_mm_unpacklo_epi16(samples, samples), 16));
+                store_int16(dest + i + 4, _mm_srai_epi32(_mm_unpackhi_epi16(samples, samples), 16));
+            }
+        }
+#endif
+        for (; i < count; ++i)
+            dest[i] = convert_sample<ConversionType>(src[i]);
+    }
+
+    static constexpr bool simd_conversion =
+        std::is_same_v<ConversionType, float> || std::is_same_v<ConversionType, double>;
+
+#if defined(__SSE2__)
+    // Stores four sign extended int16 samples held in 32 bit lanes, scaled as convert_sample does.
+    static void store_int16(ConversionType* dest, const __m128i samples) {
+        if constexpr (std::is_same_v<ConversionType, float>) {
+            _mm_storeu_ps(dest, _mm_mul_ps(_mm_cvtepi32_ps(samples), _mm_set1_ps(1.0f / 32768)));
+        } else {
+            const __m128d scale = _mm_set1_pd(1.0 / 32768);
+            const __m128i high = _mm_shuffle_epi32(samples, _MM_SHUFFLE(1, 0, 3, 2));
+            _mm_storeu_pd(dest, _mm_mul_pd(_mm_cvtepi32_pd(samples), scale));
+            _mm_storeu_pd(dest + 2, _mm_mul_pd(_mm_cvtepi32_pd(high), scale));
+        }
+    }
+#endif
+
+    void deinterleave(const SampleType* src, const int count) {
+        if (nchannels == 2) {
+            deinterleave_stereo(src, channel_data(0) + index, channel_data(1) + index, count);
+            return;
+        }
+
+        for (int channel = 0; channel < nchannels; ++channel) {
+            ConversionType* dest = channel_data(channel) + index;
+            for (int i = 0; i < count; ++i)
+                dest[i] = convert_sample<ConversionType>(src[static_cast<size_t>(i) * nchannels + channel]);
+        }
+    }
+
+    // Splits the most common layout with SSE2 shuffles, converting float and int16 on the way when needed.
+    static void deinterleave_stereo(const SampleType* src,
+                                    ConversionType* left,
+                                    ConversionType* right,
+                                    const int count) {
+        int i = 0;
+#if defined(__SSE2__)
+        if constexpr (std::is_same_v<SampleType, double> && std::is_same_v<ConversionType, double>) {
+            for (; i + 2 <= count; i += 2) {
+                const __m128d a = _mm_loadu_pd(src + 2 * i);
+                const __m128d b = _mm_loadu_pd(src + 2 * i + 2);
+                _mm_storeu_pd(left + i, _mm_unpacklo_pd(a, b));
+                _mm_storeu_pd(right + i, _mm_unpackhi_pd(a, b));
+            }
+        } else if constexpr (std::is_same_v<SampleType, float> && (std::is_same_v<ConversionType, float> ||
+                                                                    std::is_same_v<ConversionType, double>)) {
+            for (; i + 4 <= count; i += 4) {
+                const __m128 a = _mm_loadu_ps(src + 2 * i);
+                const __m128 b = _mm_loadu_ps(src + 2 * i + 4);
+                const __m128 l = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+                const __m128 r = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+                if constexpr (std::is_same_v<ConversionType, float>) {
+                    _mm_storeu_ps(left + i, l);
+                    _mm_storeu_ps(right + i, r);
+                } else {
+                    _mm_storeu_pd(left + i, _mm_cvtps_pd(l));
+                    _mm_storeu_pd(left + i + 2, _mm_cvtps_pd(_mm_movehl_ps(l, l)));
+                    _mm_storeu_pd(right + i, _mm_cvtps_pd(r));
+                    _mm_storeu_pd(right + i + 2, _mm_cvtps_pd(_mm_movehl_ps(r, r)));
+                }
+            }
+        } else if constexpr (std::is_same_v<SampleType, int16_t> && simd_conversion) {
+            // Each 32 bit lane holds one frame, left in the low half and right in the high half.
+            for (; i + 4 <= count; i += 4) {
+                const __m128i frames = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 2 * i));
+                store_int16(left + i, _mm_srai_epi32(_mm_slli_epi32(frames, 16), 16));
+                store_int16(right + i, _mm_srai_epi32(frames, 16));
+            }
+        }
+#endif
+        for (; i < count; ++i) {
+            left[i] = convert_sample<ConversionType>(src[2 * i]);
+            right[i] = convert_sample<ConversionType>(src[2 * i + 1]);
+        }
     }
 };
 }  // namespace audio
@@ -0,0 +1,111 @@
+#pragma once
+#include <stddef.h>
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+namespace njones {
+namespace audio {
+/**
+ * @brief A bounded wait-free queue for exactly one producer and one consumer thread.
+ * Elements stay in preallocated slots and are written and read in place through claim()/push() and
+ * front()/pop(), so neither side ever allocates, locks or copies more than it touches. Each side
+ * caches the other's index and only rereads it when the queue looks full or empty.
+ * @tparam T A copy constructible element type.
+ */
+template <class T>
+class SPSCQueue {
+   public:
+    /**
+     * @param capacity The maximum number of elements held at once.
+     * @param prototype The value every slot starts as, e.g. a buffer of the right size.
+     */
+    SPSCQueue(const size_t capacity, const T& prototype = T())
+        : slots(std::max<size_t>(1, capacity), prototype),
+          head(0),
+          cached_tail(0),
+          tail(0),
+          cached_head(0) {}
+
+    /**
+     * @brief The slot the next push() publishes, which the producer fills in place first.
+     * @return nullptr when the queue is full.
+     */
+    T* claim() noexcept {
+        const size_t position = tail.load(std::memory_order_relaxed);
+        if (position - cached_head == slots.size()) {
+            cached_head = head.load(std::memory_order_acquire);
+            if (position - cached_head == slots.size())
+                return nullptr;
+        }
+        return &slots[position % slots.size()];
+    }
+
+    /**
+     * @brief Publishes the slot returned by the last successful claim().
+     */
+    void push() noexcept { tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+    /**
+     * @brief The oldest element, which the consumer reads in place before calling pop().
+     * @return nullptr when the queue is empty.
+     */
+    T* front() noexcept {
+        const size_t position = head.load(std::memory_order_relaxed);
+        if (position == cached_tail) {
+            cached_tail = tail.load(std::memory_order_acquire);
+            if (position == cached_tail)
+                return nullptr;
+        }
+        return &slots[position % slots.size()];
+    }
+
+    /**
+     * @brief Releases the element returned by the last successful front() to the producer.
+     */
+    void pop() noexcept { head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+    /**
+     * @brief Fills one element in place. Producer only.
+     * @return false without calling fill when the queue is full.
+     */
+    template <class Fill>
+    bool try_push(Fill&& fill) noexcept {
+        T* slot = claim();
+        if (slot == nullptr)
+            return false;
+        fill(*slot);
+        push();
+        return true;
+    }
+
+    /**
+     * @brief Passes the oldest element to drain and releases it. Consumer only.
+     * @return false when the queue is empty.
+     */
+    template <class Drain>
+    bool try_pop(Drain&& drain) noexcept {
+        T* slot = front();
+        if (slot == nullptr)
+            return false;
+        drain(*slot);
+        pop();
+        return true;
+    }
+
+    size_t capacity() const { return slots.size(); }
+
+   private:
+    SPSCQueue(const SPSCQueue&) = delete;
+    SPSCQueue(SPSCQueue&&) = delete;
+
+    std::vector<T> slots;
+    // The consumer's index and its copy of the producer's, then the producer's pair, each pair on its own
+    // cache line so the two threads only share a line when one actually reads the other's index.
+    alignas(64) std::atomic<size_t> head;
+    size_t cached_tail;
+    alignas(64) std::atomic<size_t> tail;
+    size_t cached_head;
+};
+}  // namespace audio
+}  // namespace njones
@@ -0,0 +1,143 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace njones {
+namespace audio {
+/**
+ * @brief A fixed size work-stealing thread pool. Every worker owns a task deque; tasks submitted from a
+ * worker go to its own deque and are run newest first, while idle workers steal the oldest tasks
+ * from the other deques. Tasks submitted from outside the pool are spread round robin.
+ */
+class ThreadPool {
+   public:
+    ThreadPool(const unsigned int nthreads = std::thread::hardware_concurrency())
+        : stopping(false), pending(0), next_worker(0) {
+        const unsigned int count = std::max(1u, nthreads);
+        for (unsigned int i = 0; i < count; ++i)
+            workers.push_back(std::make_unique<Worker>());
+        for (unsigned int i = 0; i < count; ++i)
+            threads.emplace_back([this, i]() { run(i); });
+    }
+
+    /**
+     * @brief Runs every task already submitted, then joins the workers.
+     */
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> guard(sleep_lock);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& thread : threads)
+            thread.join();
+    }
+
+    void submit(std::function<void()> task) { push(std::move(task), false); }
+
+    /**
+     * @brief Submits a task which runs only after the tasks already queued on the calling worker, for
+     * long running work which yields and continues later. Outside the pool it is the same as submit().
+     */
+    void defer(std::function<void()> task) { push(std::move(task), true); }
+
+    unsigned int get_nthreads() const { return workers.size(); }
+
+   private:
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool(ThreadPool&&) = delete;
+
+    struct Worker {
+        std::mutex lock;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+    bool stopping;
+    std::atomic<size_t> pending;
+    std::atomic<size_t> next_worker;
+    std::mutex sleep_lock;
+    std::condition_variable wake;
+
+    static int& current_worker_index() {
+        static thread_local int index = -1;
+        return index;
+    }
+
+    static ThreadPool*& current_pool() {
+        static thread_local ThreadPool* pool = nullptr;
+        return pool;
+    }
+
+    void push(std::function<void()> task, const bool oldest) {
+        int index = current_worker_index();
+        if (index < 0 || current_pool() != this)
+            index = next_worker.fetch_add(1, std::memory_order_relaxed) % workers.size();
+
+        pending.fetch_add(1, std::memory_order_release);
+        {
+            // The owner pops the newest task and thieves steal the oldest, so the front runs last locally.
+            std::lock_guard<std::mutex> guard(workers[index]->lock);
+            if (oldest)
+                workers[index]->tasks.push_front(std::move(task));
+            else
+                workers[index]->tasks.push_back(std::move(task));
+        }
+        {
+            std::lock_guard<std::mutex> guard(sleep_lock);
+        }
+        wake.notify_one();
+    }
+
+    bool pop(const unsigned int index, std::function<void()>& task) {
+        {
+            auto& own = *workers[index];
+            std::lock_guard<std::mutex> guard(own.lock);
+            if (!own.tasks.empty()) {
+                task = std::move(own.tasks.back());
+                own.tasks.pop_back();
+                return true;
+            }
+        }
+        for (size_t offset = 1; offset < workers.size(); ++offset) {
+            auto& victim = *workers[(index + offset) % workers.size()];
+            std::lock_guard<std::mutex> guard(victim.lock);
+            if (!victim.tasks.empty()) {
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void run(const unsigned int index) {
+        current_worker_index() = index;
+        current_pool() = this;
+
+        std::function<void()> task;
+        while (true) {
+            if (pop(index, task)) {
+                pending.fetch_sub(1, std::memory_order_acq_rel);
+                task();
+                task = nullptr;
+                continue;
+            }
+
+            std::unique_lock<std::mutex> guard(sleep_lock);
+            wake.wait(guard, [this]() { return stopping || pending.load(std::memory_order_acquire) > 0; });
+            if (stopping && pending.load(std::memory_order_acquire) == 0)
+                return;
+        }
+    }
+};
+}  // namespace audio
+}  // namespace njones
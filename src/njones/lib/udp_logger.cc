@@ -1,25 +1,129 @@
-#include "udp_logger.h"
-
-namespace njones {
-namespace audio {
-UDPLogger::UDPLogger(const std::string& host, const int port)
-    : host(host), port(port), socket(io_service), remote_endpoint(boost::asio::ip::address::from_string(host), port) {
-    using namespace boost::asio;
-
-    boost::system::error_code err;
-    socket.open(ip::udp::v4(), err);
-}
-
-UDPLogger::~UDPLogger() {
-    boost::system::error_code err;
-    socket.close(err);
-}
-
-void UDPLogger::log(const std::string& msg) {
-    using namespace boost::asio;
-
-    boost::system::error_code err;
-    socket.send_to(buffer(msg, msg.length()), remote_endpoint, 0, err);
-}
-}  // namespace audio
-}  // namespace njones
+#include "udp_logger.h"
+#include <string.h>
+#include <algorithm>
+
+namespace njones {
+namespace audio {
+UDPLogger::UDPLogger(const std::string& host,
+                     const int port,
+                     const size_t capacity,
+                     const std::chrono::milliseconds flush_interval)
+    : host(host),
+      port(port),
+      socket(io_service),
+      remote_endpoint(boost::asio::ip::address::from_string(host), port),
+      queue(capacity),
+      sent(0),
+      dropped(0),
+      datagrams(0),
+      flush_interval(flush_interval),
+      stopping(false),
+      flush_requests(0),
+      flushes(0) {
+    using namespace boost::asio;
+
+    boost::system::error_code err;
+    socket.open(ip::udp::v4(), err);
+
+    sender = std::thread([this]() { run(); });
+}
+
+UDPLogger::~UDPLogger() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    wake.notify_one();
+    sender.join();
+
+    boost::system::error_code err;
+    socket.close(err);
+}
+
+void UDPLogger::log(std::string_view msg) noexcept {
+    const bool queued = queue.try_push([&](Message& message) {
+        message.length = std::min(msg.size(), max_message_size);
+        memcpy(message.text.data(), msg.data(), message.length);
+    });
+
+    if (!queued)
+        dropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+void UDPLogger::flush() {
+    std::unique_lock<std::mutex> guard(lock);
+    const uint64_t request = ++flush_requests;
+    wake.notify_one();
+    flushed.wait(guard, [&]() { return flushes >= request; });
+}
+
+uint64_t UDPLogger::get_sent() const {
+    return sent.load(std::memory_order_relaxed);
+}
+
+uint64_t UDPLogger::get_dropped() const {
+    return dropped.load(std::memory_order_relaxed);
+}
+
+uint64_t UDPLogger::get_datagrams() const {
+    return datagrams.load(std::memory_order_relaxed);
+}
+
+void UDPLogger::run() {
+    std::unique_lock<std::mutex> guard(lock);
+    while (true) {
+        const bool stop = stopping;
+        const uint64_t request = flush_requests;
+        guard.unlock();
+
+        // Producers never signal the sender, so logging stays free of system calls; the sender
+        // wakes on its own every flush_interval, or early for flush() and shutdown.
+        drain();
+
+        guard.lock();
+        if (flushes < request) {
+            flushes = request;
+            flushed.notify_all();
+        }
+        if (stop)
+            return;
+        wake.wait_for(guard, flush_interval, [this, request]() { return stopping || flush_requests > request; });
+    }
+}
+
+void UDPLogger::drain() {
+    size_t length = 0;
+    size_t count = 0;
+
+    auto pack = [&](const Message& message) {
+        // Messages are newline separated; one which would overflow the datagram starts the next one.
+        const size_t separator = length > 0 ? 1 : 0;
+        if (length + separator + message.length > datagram.size()) {
+            send(length, count);
+            length = 0;
+            count = 0;
+        } else if (separator > 0)
+            datagram[length++] = '\n';
+
+        memcpy(datagram.data() + length, message.text.data(), message.length);
+        length += message.length;
+        ++count;
+    };
+
+    while (queue.try_pop(pack)) {
+    }
+
+    if (count > 0)
+        send(length, count);
+}
+
+void UDPLogger::send(const size_t length, const size_t nmessages) {
+    using namespace boost::asio;
+
+    boost::system::error_code err;
+    socket.send_to(buffer(datagram.data(), length), remote_endpoint, 0, err);
+    datagrams.fetch_add(1, std::memory_order_relaxed);
+    sent.fetch_add(nmessages, std::memory_order_relaxed);
+}
+}  // namespace audio
+}  // namespace njones
@@ -1,27 +1,97 @@
-#pragma once
-
-#include <boost/asio.hpp>
-#include <string>
-
-namespace njones {
-namespace audio {
-class UDPLogger {
-   public:
-    UDPLogger(const std::string& host, const int port);
-    ~UDPLogger();
-
-    void log(const std::string& msg);
-
-   private:
-    UDPLogger() = delete;
-    UDPLogger(const UDPLogger&) = delete;
-    UDPLogger(UDPLogger&&) = delete;
-
-    std::string host;
-    int port;
-    boost::asio::io_service io_service;
-    boost::asio::ip::udp::socket socket;
-    boost::asio::ip::udp::endpoint remote_endpoint;
-};
-}  // namespace audio
-}  // namespace njones
\ No newline at end of file
+#pragma once
+
+#include <njones/lib/mpsc_queue.h>
+#include <array>
+#include <atomic>
+#include <boost/asio.hpp>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+
+namespace njones {
+namespace audio {
+/**
+ * @brief Sends log messages as UDP datagrams without blocking the caller.
+ * log() copies the message into a preallocated lock-free queue and returns; a background thread
+ * drains the queue, packs newline separated messages into datagrams of up to max_datagram_size
+ * bytes and sends them. Messages which do not fit into a full queue are dropped and counted.
+ */
+class UDPLogger {
+   public:
+    // Longer messages are truncated.
+    static constexpr size_t max_message_size = 512;
+    // The largest UDP payload that fits a 1500 byte Ethernet MTU over IPv4 without fragmenting.
+    static constexpr size_t max_datagram_size = 1472;
+
+    /**
+     * @param host
+     * @param port
+     * @param capacity The number of messages which may wait to be sent.
+     * @param flush_interval How long the sender sleeps when the queue is empty.
+     */
+    UDPLogger(const std::string& host,
+              const int port,
+              const size_t capacity = 1024,
+              const std::chrono::milliseconds flush_interval = std::chrono::milliseconds(10));
+    /**
+     * @brief Sends every message logged before destruction, then closes the socket.
+     */
+    ~UDPLogger();
+
+    /**
+     * @brief Queues a message. Never allocates, blocks or makes a system call, so it may be called
+     * from an audio thread. Safe to call from any number of threads.
+     */
+    void log(std::string_view msg) noexcept;
+
+    /**
+     * @brief Blocks until every message logged before the call has been sent.
+     */
+    void flush();
+
+    uint64_t get_sent() const;
+    uint64_t get_dropped() const;
+    uint64_t get_datagrams() const;
+
+   private:
+    UDPLogger() = delete;
+    UDPLogger(const UDPLogger&) = delete;
+    UDPLogger(UDPLogger&&) = delete;
+
+    struct Message {
+        size_t length;
+        std::array<char, max_message_size> text;
+    };
+
+    void run();
+    void drain();
+    void send(const size_t length, const size_t nmessages);
+
+    std::string host;
+    int port;
+    boost::asio::io_service io_service;
+    boost::asio::ip::udp::socket socket;
+    boost::asio::ip::udp::endpoint remote_endpoint;
+
+    MPSCQueue<Message> queue;
+    std::array<char, max_datagram_size> datagram;
+    std::atomic<uint64_t> sent;
+    std::atomic<uint64_t> dropped;
+    std::atomic<uint64_t> datagrams;
+
+    std::chrono::milliseconds flush_interval;
+    std::mutex lock;
+    std::condition_variable wake;
+    std::condition_variable flushed;
+    // Guarded by lock.
+    bool stopping;
+    uint64_t flush_requests;
+    uint64_t flushes;
+    std::thread sender;
+};
+}  // namespace audio
+}  // namespace njones
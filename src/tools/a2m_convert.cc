@@ -0,0 +1,180 @@
+#include <getopt.h>
+#include <njones/a2m/file_converter.h>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+
+namespace {
+void usage() {
+    std::cerr << "usage: a2m-convert [options] <input.wav|input.raw> <output.mid>\n"
+                 "  --raw <s16|s24|s32|f32|f64>  read headerless PCM in this format\n"
+                 "  --channels <n>               channels of raw input (default 1)\n"
+                 "  --samplerate <hz>            samplerate of raw input (default 44100)\n"
+                 "  --block-size <n>             analysis block size (default 4096)\n"
+                 "  --hop-size <n>               overlapping analysis hop size (default block size)\n"
+                 "  --window <rectangular|hann|blackman>\n"
+                 "  --octave-levels <n>          decimated levels for resolving low notes (default 1)\n"
+                 "  --detector <auto|fft|goertzel>\n"
+                 "  --activation <level>         activation level in [0, 1] (default 0)\n"
+                 "  --note-count <n>             maximum notes per block, 0 for unlimited\n"
+                 "  --transpose <n>\n"
+                 "  --ceiling <level>            amplitude ceiling in [0, 1] (default 1)\n"
+                 "  --on-level <level>           level a note must exceed to start, for hysteresis\n"
+                 "  --release-blocks <n>         blocks a note may be missing before it ends\n"
+                 "  --min-duration <seconds>     shortest note written\n"
+                 "  --velocity-threshold <n>     write velocity changes as aftertouch, 0 for none\n"
+                 "  --float                      analyse in single precision\n";
+}
+
+njones::audio::a2m::SampleFormat parse_format(const std::string& name) {
+    if (name == "s16")
+        return njones::audio::a2m::SampleFormat::Int16;
+    if (name == "s24")
+        return njones::audio::a2m::SampleFormat::Int24;
+    if (name == "s32")
+        return njones::audio::a2m::SampleFormat::Int32;
+    if (name == "f32")
+        return njones::audio::a2m::SampleFormat::Float32;
+    if (name == "f64")
+        return njones::audio::a2m::SampleFormat::Float64;
+    throw std::invalid_argument("Unknown raw sample format " + name + ".");
+}
+
+njones::audio::a2m::Window parse_window(const std::string& name) {
+    if (name == "rectangular")
+        return njones::audio::a2m::Window::Rectangular;
+    if (name == "hann")
+        return njones::audio::a2m::Window::Hann;
+    if (name == "blackman")
+        return njones::audio::a2m::Window::Blackman;
+    throw std::invalid_argument("Unknown window " + name + ".");
+}
+
+njones::audio::a2m::Detector parse_detector(const std::string& name) {
+    if (name == "auto")
+        return njones::audio::a2m::Detector::Auto;
+    if (name == "fft")
+        return njones::audio::a2m::Detector::Fft;
+    if (name == "goertzel")
+        return njones::audio::a2m::Detector::Goertzel;
+    throw std::invalid_argument("Unknown detector " + name + ".");
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+    static const option long_options[] = {
+        {"raw", required_argument, nullptr, 'r'},
+        {"channels", required_argument, nullptr, 'c'},
+        {"samplerate", required_argument, nullptr, 's'},
+        {"block-size", required_argument, nullptr, 'b'},
+        {"hop-size", required_argument, nullptr, 'h'},
+        {"window", required_argument, nullptr, 'w'},
+        {"octave-levels", required_argument, nullptr, 'L'},
+        {"detector", required_argument, nullptr, 'D'},
+        {"activation", required_argument, nullptr, 'a'},
+        {"note-count", required_argument, nullptr, 'n'},
+        {"transpose", required_argument, nullptr, 't'},
+        {"ceiling", required_argument, nullptr, 'e'},
+        {"on-level", required_argument, nullptr, 'o'},
+        {"release-blocks", required_argument, nullptr, 'l'},
+        {"min-duration", required_argument, nullptr, 'd'},
+        {"velocity-threshold", required_argument, nullptr, 'v'},
+        {"float", no_argument, nullptr, 'f'},
+        {"help", no_argument, nullptr, '?'},
+        {nullptr, 0, nullptr, 0}};
+
+    auto options = njones::audio::a2m::FileConversionOptions();
+    auto raw = njones::audio::a2m::PcmFormat{njones::audio::a2m::SampleFormat::Int16, 1, 44100};
+    bool is_raw = false;
+    bool single_precision = false;
+
+    try {
+        int option;
+        while ((option = getopt_long(argc, argv, "", long_options, nullptr)) != -1) {
+            switch (option) {
+                case 'r':
+                    raw.format = parse_format(optarg);
+                    is_raw = true;
+                    break;
+                case 'c':
+                    raw.nchannels = std::stoul(optarg);
+                    break;
+                case 's':
+                    raw.samplerate = std::stoul(optarg);
+                    break;
+                case 'b':
+                    options.block_size = std::stoul(optarg);
+                    break;
+                case 'h':
+                    options.hop_size = std::stoul(optarg);
+                    break;
+                case 'w':
+                    options.window = parse_window(optarg);
+                    break;
+                case 'L':
+                    options.octave_levels = std::stoul(optarg);
+                    break;
+                case 'D':
+                    options.detector = parse_detector(optarg);
+                    break;
+                case 'a':
+                    options.activation_level = std::stod(optarg);
+                    break;
+                case 'n':
+                    options.note_count = std::stoul(optarg);
+                    break;
+                case 't':
+                    options.transpose = std::stoi(optarg);
+                    break;
+                case 'e':
+                    options.ceiling = std::stod(optarg);
+                    break;
+                case 'o':
+                    options.on_level = std::stod(optarg);
+                    break;
+                case 'l':
+                    options.release_blocks = std::stoul(optarg);
+                    break;
+                case 'd':
+                    options.min_duration = std::stod(optarg);
+                    break;
+                case 'v':
+                    options.velocity_threshold = std::stoul(optarg);
+                    break;
+                case 'f':
+                    single_precision = true;
+                    break;
+                default:
+                    usage();
+                    return EXIT_FAILURE;
+            }
+        }
+
+        if (argc - optind != 2) {
+            usage();
+            return EXIT_FAILURE;
+        }
+
+        auto input = is_raw ? std::make_unique<njones::audio::a2m::PcmFile>(argv[optind], raw)
+                            : std::make_unique<njones::audio::a2m::PcmFile>(argv[optind]);
+        auto output = njones::audio::a2m::MidiFileWriter(argv[optind + 1]);
+
+        auto start = std::chrono::steady_clock::now();
+        auto stats = single_precision ? njones::audio::a2m::convert_file<float>(*input, output, options)
+                                      : njones::audio::a2m::convert_file<double>(*input, output, options);
+        output.close();
+        auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << "frames=" << stats.nframes << " blocks=" << stats.nblocks << " notes=" << stats.nnotes
+                  << " events=" << stats.nevents << " duration_s=" << stats.duration << " elapsed_s=" << elapsed
+                  << " realtime_factor=" << (elapsed > 0.0 ? stats.duration / elapsed : 0.0) << std::endl;
+    } catch (const std::exception& error) {
+        std::cerr << "a2m-convert: " << error.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,395 @@
+#include <getopt.h>
+#include <math.h>
+#include <njones/a2m/stream_protocol.h>
+#include <string.h>
+#include <algorithm>
+#include <array>
+#include <boost/asio.hpp>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+typedef std::chrono::steady_clock Clock;
+
+// Send times are kept for this many hops per stream, far more than are ever in flight.
+constexpr size_t send_ring = 1 << 14;
+// Hops a stream may have unanswered when it sends as fast as possible.
+constexpr uint64_t max_in_flight = 32;
+// The looped test signal is this many hops long.
+constexpr size_t signal_hops = 64;
+
+struct Options {
+    std::string host = "127.0.0.1";
+    unsigned short port = 5150;
+    unsigned int nstreams = 16;
+    double duration = 10.0;
+    double speed = 1.0;
+    unsigned int ncores = std::thread::hardware_concurrency();
+    unsigned int nthreads = 1;
+    njones::audio::a2m::StreamHello hello{njones::audio::a2m::PcmFormat{njones::audio::a2m::SampleFormat::Int16, 1,
+                                                                        44100},
+                                          njones::audio::a2m::Window::Rectangular,
+                                          1,
+                                          4096,
+                                          0,
+                                          0.0};
+};
+
+void usage() {
+    std::cerr << "usage: a2m-loadtest [options]\n"
+                 "  --host <ip>                  server address (default 127.0.0.1)\n"
+                 "  --port <n>                   server port (default 5150)\n"
+                 "  --streams <n>                concurrent streams (default 16)\n"
+                 "  --duration <seconds>         audio sent per stream (default 10)\n"
+                 "  --speed <x>                  pace streams at x times real time, 0 for as fast as possible\n"
+                 "  --cores <n>                  server cores to divide throughput by (default one per core)\n"
+                 "  --threads <n>                client socket threads (default 1)\n"
+                 "  --format <s16|s24|s32|f32|f64>\n"
+                 "  --channels <n>               (default 1)\n"
+                 "  --samplerate <hz>            (default 44100)\n"
+                 "  --block-size <n>             (default 4096)\n"
+                 "  --hop-size <n>               (default block size)\n";
+}
+
+njones::audio::a2m::SampleFormat parse_format(const std::string& name) {
+    if (name == "s16")
+        return njones::audio::a2m::SampleFormat::Int16;
+    if (name == "s24")
+        return njones::audio::a2m::SampleFormat::Int24;
+    if (name == "s32")
+        return njones::audio::a2m::SampleFormat::Int32;
+    if (name == "f32")
+        return njones::audio::a2m::SampleFormat::Float32;
+    if (name == "f64")
+        return njones::audio::a2m::SampleFormat::Float64;
+    throw std::invalid_argument("Unknown sample format " + name + ".");
+}
+
+void encode_sample(const njones::audio::a2m::SampleFormat format, const double sample, uint8_t* bytes) {
+    switch (format) {
+        case njones::audio::a2m::SampleFormat::Int16:
+        case njones::audio::a2m::SampleFormat::Int24:
+        case njones::audio::a2m::SampleFormat::Int32: {
+            const size_t size = njones::audio::a2m::sample_size(format);
+            const auto value = static_cast<int32_t>(lround(sample * (ldexp(1.0, 8 * size - 1) - 1.0)));
+            for (size_t i = 0; i < size; ++i)
+                bytes[i] = static_cast<uint8_t>(static_cast<uint32_t>(value) >> (8 * i));
+            break;
+        }
+        case njones::audio::a2m::SampleFormat::Float32: {
+            const float value = static_cast<float>(sample);
+            memcpy(bytes, &value, sizeof(value));
+            break;
+        }
+        case njones::audio::a2m::SampleFormat::Float64:
+            memcpy(bytes, &sample, sizeof(sample));
+            break;
+    }
+}
+
+/**
+ * @brief A C major chord encoded in the stream's format, looped by every stream from a different hop.
+ */
+std::vector<uint8_t> generate_signal(const njones::audio::a2m::StreamHello& hello, const unsigned int hop) {
+    static const double chord[] = {261.63, 329.63, 392.00};
+    const size_t sample_size = njones::audio::a2m::sample_size(hello.format.format);
+    const size_t nframes = signal_hops * hop;
+    auto pcm = std::vector<uint8_t>(nframes * hello.format.nchannels * sample_size);
+    uint8_t* bytes = pcm.data();
+    for (size_t i = 0; i < nframes; ++i) {
+        double sample = 0.0;
+        for (auto freq : chord)
+            sample += 0.3 * sin(2.0 * M_PI * freq * i / hello.format.samplerate);
+        for (unsigned int channel = 0; channel < hello.format.nchannels; ++channel, bytes += sample_size)
+            encode_sample(hello.format.format, sample, bytes);
+    }
+    return pcm;
+}
+
+/**
+ * @brief One connection, sending hops on schedule and timing the frame which answers each one.
+ * All of its handlers run on its own strand.
+ */
+class Stream : public std::enable_shared_from_this<Stream> {
+   public:
+    Stream(boost::asio::io_context& io_context,
+           const Options& options,
+           const std::vector<uint8_t>& pcm,
+           const size_t first_hop,
+           const uint64_t nhops)
+        : misses(0),
+          finished(false),
+          options(options),
+          pcm(pcm),
+          socket(boost::asio::make_strand(io_context)),
+          timer(socket.get_executor()),
+          hop(options.hello.hop_size > 0 ? options.hello.hop_size : options.hello.block_size),
+          hop_bytes(pcm.size() / signal_hops),
+          first_hop(first_hop),
+          nhops(nhops),
+          sent(0),
+          answered(0),
+          waiting(false),
+          filled(0),
+          send_times(send_ring),
+          inbox(64 * 1024) {
+        latencies_us.reserve(nhops);
+    }
+
+    void start(const boost::asio::ip::tcp::endpoint& endpoint) {
+        socket.async_connect(endpoint, [self = shared_from_this()](const boost::system::error_code& err) {
+            if (err)
+                return self->fail(err);
+            // Exceptions would escape io_context.run() on a client thread, so errors go to fail() instead.
+            boost::system::error_code option_err;
+            self->socket.set_option(boost::asio::ip::tcp::no_delay(true), option_err);
+            if (option_err)
+                return self->fail(option_err);
+            njones::audio::a2m::encode_hello(self->options.hello, self->hello_bytes.data());
+            boost::asio::async_write(self->socket, boost::asio::buffer(self->hello_bytes),
+                                     [self](const boost::system::error_code& err, size_t) {
+                                         if (err)
+                                             return self->fail(err);
+                                         self->started = Clock::now();
+                                         self->send();
+                                         self->receive();
+                                     });
+        });
+    }
+
+    std::vector<double> latencies_us;
+    uint64_t misses;
+    bool finished;
+    std::string error;
+
+   private:
+    void send() {
+        if (sent == nhops) {
+            boost::system::error_code err;
+            socket.shutdown(boost::asio::ip::tcp::socket::shutdown_send, err);
+            return;
+        }
+
+        if (options.speed > 0.0) {
+            const auto due = started + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(
+                                           sent * hop / (options.speed * options.hello.format.samplerate)));
+            if (Clock::now() < due) {
+                timer.expires_at(due);
+                timer.async_wait([self = shared_from_this()](const boost::system::error_code& err) {
+                    if (!err)
+                        self->send();
+                });
+                return;
+            }
+        } else if (sent - answered >= max_in_flight) {
+            waiting = true;
+            return;
+        }
+
+        const size_t offset = (first_hop + sent) % signal_hops * hop_bytes;
+        send_times[sent % send_ring] = Clock::now();
+        boost::asio::async_write(socket, boost::asio::buffer(pcm.data() + offset, hop_bytes),
+                                 [self = shared_from_this()](const boost::system::error_code& err, size_t) {
+                                     if (err)
+                                         return self->fail(err);
+                                     ++self->sent;
+                                     self->send();
+                                 });
+    }
+
+    void receive() {
+        socket.async_read_some(
+            boost::asio::buffer(inbox.data() + filled, inbox.size() - filled),
+            [self = shared_from_this()](const boost::system::error_code& err, const size_t nbytes) {
+                self->filled += nbytes;
+                self->parse();
+                if (err == boost::asio::error::eof)
+                    return;
+                if (err)
+                    return self->fail(err);
+                self->receive();
+            });
+    }
+
+    void parse() {
+        const auto now = Clock::now();
+        const double hop_us = 1e6 * hop / options.hello.format.samplerate;
+        size_t offset = 0;
+        while (filled - offset >= njones::audio::a2m::FrameHeader::size) {
+            const auto header = njones::audio::a2m::decode_frame_header(inbox.data() + offset);
+            const size_t length = njones::audio::a2m::frame_size(header.nevents);
+            if (filled - offset < length)
+                break;
+            offset += length;
+
+            if (header.flags & njones::audio::a2m::FrameHeader::final) {
+                finished = true;
+                continue;
+            }
+            const auto sent_at = send_times[header.block % send_ring];
+            const double latency = std::chrono::duration<double, std::micro>(now - sent_at).count();
+            latencies_us.push_back(latency);
+            misses += latency > hop_us ? 1 : 0;
+            ++answered;
+        }
+        memmove(inbox.data(), inbox.data() + offset, filled - offset);
+        filled -= offset;
+
+        if (waiting) {
+            waiting = false;
+            send();
+        }
+    }
+
+    void fail(const boost::system::error_code& err) {
+        error = err.message();
+        boost::system::error_code ignored;
+        socket.close(ignored);
+        timer.cancel();
+    }
+
+    const Options& options;
+    const std::vector<uint8_t>& pcm;
+    boost::asio::ip::tcp::socket socket;
+    boost::asio::steady_timer timer;
+    std::array<uint8_t, njones::audio::a2m::StreamHello::size> hello_bytes;
+    unsigned int hop;
+    size_t hop_bytes;
+    size_t first_hop;
+    uint64_t nhops;
+    uint64_t sent;
+    uint64_t answered;
+    bool waiting;
+    size_t filled;
+    Clock::time_point started;
+    std::vector<Clock::time_point> send_times;
+    std::vector<uint8_t> inbox;
+};
+
+double quantile(const std::vector<double>& sorted, const double q) {
+    if (sorted.empty())
+        return 0.0;
+    return sorted[std::min(sorted.size() - 1, static_cast<size_t>(q * sorted.size()))];
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+    static const option long_options[] = {{"host", required_argument, nullptr, 'H'},
+                                          {"port", required_argument, nullptr, 'p'},
+                                          {"streams", required_argument, nullptr, 'n'},
+                                          {"duration", required_argument, nullptr, 'd'},
+                                          {"speed", required_argument, nullptr, 'x'},
+                                          {"cores", required_argument, nullptr, 'C'},
+                                          {"threads", required_argument, nullptr, 't'},
+                                          {"format", required_argument, nullptr, 'r'},
+                                          {"channels", required_argument, nullptr, 'c'},
+                                          {"samplerate", required_argument, nullptr, 's'},
+                                          {"block-size", required_argument, nullptr, 'b'},
+                                          {"hop-size", required_argument, nullptr, 'h'},
+                                          {"help", no_argument, nullptr, '?'},
+                                          {nullptr, 0, nullptr, 0}};
+
+    auto options = Options();
+    try {
+        int option;
+        while ((option = getopt_long(argc, argv, "", long_options, nullptr)) != -1) {
+            switch (option) {
+                case 'H':
+                    options.host = optarg;
+                    break;
+                case 'p':
+                    options.port = static_cast<unsigned short>(std::stoul(optarg));
+                    break;
+                case 'n':
+                    options.nstreams = std::stoul(optarg);
+                    break;
+                case 'd':
+                    options.duration = std::stod(optarg);
+                    break;
+                case 'x':
+                    options.speed = std::stod(optarg);
+                    break;
+                case 'C':
+                    options.ncores = std::max(1ul, std::stoul(optarg));
+                    break;
+                case 't':
+                    options.nthreads = std::max(1ul, std::stoul(optarg));
+                    break;
+                case 'r':
+                    options.hello.format.format = parse_format(optarg);
+                    break;
+                case 'c':
+                    options.hello.format.nchannels = std::stoul(optarg);
+                    break;
+                case 's':
+                    options.hello.format.samplerate = std::stoul(optarg);
+                    break;
+                case 'b':
+                    options.hello.block_size = std::stoul(optarg);
+                    break;
+                case 'h':
+                    options.hello.hop_size = std::stoul(optarg);
+                    break;
+                default:
+                    usage();
+                    return EXIT_FAILURE;
+            }
+        }
+
+        const unsigned int hop = options.hello.hop_size > 0 ? options.hello.hop_size : options.hello.block_size;
+        const uint64_t nhops = std::max<uint64_t>(1, options.duration * options.hello.format.samplerate / hop);
+        const auto pcm = generate_signal(options.hello, hop);
+        const auto endpoint =
+            boost::asio::ip::tcp::endpoint(boost::asio::ip::make_address(options.host), options.port);
+
+        boost::asio::io_context io_context;
+        auto streams = std::vector<std::shared_ptr<Stream>>();
+        for (unsigned int i = 0; i < options.nstreams; ++i) {
+            streams.push_back(std::make_shared<Stream>(io_context, options, pcm, i % signal_hops, nhops));
+            streams.back()->start(endpoint);
+        }
+
+        const auto start = Clock::now();
+        auto threads = std::vector<std::thread>();
+        for (unsigned int i = 0; i < options.nthreads; ++i)
+            threads.emplace_back([&io_context]() { io_context.run(); });
+        for (auto& thread : threads)
+            thread.join();
+        const double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+        auto latencies = std::vector<double>();
+        uint64_t misses = 0;
+        unsigned int failed = 0;
+        for (const auto& stream : streams) {
+            latencies.insert(latencies.end(), stream->latencies_us.begin(), stream->latencies_us.end());
+            misses += stream->misses;
+            if (!stream->finished) {
+                ++failed;
+                if (!stream->error.empty())
+                    std::cerr << "a2m-loadtest: " << stream->error << std::endl;
+            }
+        }
+        std::sort(latencies.begin(), latencies.end());
+
+        // Seconds of audio converted per second, that is the number of streams served in real time.
+        const double audio = static_cast<double>(latencies.size()) * hop / options.hello.format.samplerate;
+        const double realtime_streams = elapsed > 0.0 ? audio / elapsed : 0.0;
+        std::cout << "streams=" << options.nstreams << " failed=" << failed << " frames=" << latencies.size()
+                  << " audio_s=" << audio << " elapsed_s=" << elapsed << " realtime_streams=" << realtime_streams
+                  << " streams_per_core=" << realtime_streams / options.ncores
+                  << " latency_us_p50=" << quantile(latencies, 0.5) << " p90=" << quantile(latencies, 0.9)
+                  << " p99=" << quantile(latencies, 0.99) << " p999=" << quantile(latencies, 0.999)
+                  << " max=" << (latencies.empty() ? 0.0 : latencies.back()) << " late_frames=" << misses
+                  << std::endl;
+        return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    } catch (const std::exception& error) {
+        std::cerr << "a2m-loadtest: " << error.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+}
@@ -0,0 +1,102 @@
+#include <getopt.h>
+#include <njones/a2m/stream_server.h>
+#include <signal.h>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+
+namespace {
+void usage() {
+    std::cerr << "usage: a2m-server [options]\n"
+                 "  --address <ip>         address to listen on (default 127.0.0.1)\n"
+                 "  --port <n>             port to listen on (default 5150)\n"
+                 "  --threads <n>          conversion threads (default one per core)\n"
+                 "  --io-threads <n>       socket threads (default 1)\n"
+                 "  --buffered-hops <n>    hops of PCM buffered per connection (default 16)\n"
+                 "  --float                analyse in single precision\n";
+}
+
+template <class Server>
+void serve(const std::string& address,
+           const unsigned short port,
+           const unsigned int nthreads,
+           const unsigned int nio_threads,
+           const unsigned int buffered_hops,
+           const sigset_t& signals) {
+    auto server = std::make_unique<Server>(address, port, nthreads, nio_threads, buffered_hops);
+    std::cout << "listening on " << address << ":" << server->get_port() << std::endl;
+
+    int signal;
+    sigwait(&signals, &signal);
+
+    const auto stats = server->get_stats();
+    std::cout << "connections=" << stats.connections << " rejected=" << stats.rejected << " blocks=" << stats.blocks
+              << " bytes_received=" << stats.bytes_received << " bytes_sent=" << stats.bytes_sent << std::endl;
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+    static const option long_options[] = {{"address", required_argument, nullptr, 'a'},
+                                          {"port", required_argument, nullptr, 'p'},
+                                          {"threads", required_argument, nullptr, 't'},
+                                          {"io-threads", required_argument, nullptr, 'i'},
+                                          {"buffered-hops", required_argument, nullptr, 'b'},
+                                          {"float", no_argument, nullptr, 'f'},
+                                          {"help", no_argument, nullptr, '?'},
+                                          {nullptr, 0, nullptr, 0}};
+
+    std::string address = "127.0.0.1";
+    unsigned short port = 5150;
+    unsigned int nthreads = std::thread::hardware_concurrency();
+    unsigned int nio_threads = 1;
+    unsigned int buffered_hops = 16;
+    bool single_precision = false;
+
+    try {
+        int option;
+        while ((option = getopt_long(argc, argv, "", long_options, nullptr)) != -1) {
+            switch (option) {
+                case 'a':
+                    address = optarg;
+                    break;
+                case 'p':
+                    port = static_cast<unsigned short>(std::stoul(optarg));
+                    break;
+                case 't':
+                    nthreads = std::stoul(optarg);
+                    break;
+                case 'i':
+                    nio_threads = std::stoul(optarg);
+                    break;
+                case 'b':
+                    buffered_hops = std::stoul(optarg);
+                    break;
+                case 'f':
+                    single_precision = true;
+                    break;
+                default:
+                    usage();
+                    return EXIT_FAILURE;
+            }
+        }
+
+        // Blocked before the server starts its threads, which inherit the mask, so only sigwait sees them.
+        sigset_t signals;
+        sigemptyset(&signals);
+        sigaddset(&signals, SIGINT);
+        sigaddset(&signals, SIGTERM);
+        pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+        if (single_precision)
+            serve<njones::audio::a2m::FloatStreamServer>(address, port, nthreads, nio_threads, buffered_hops, signals);
+        else
+            serve<njones::audio::a2m::StreamServer>(address, port, nthreads, nio_threads, buffered_hops, signals);
+    } catch (const std::exception& error) {
+        std::cerr << "a2m-server: " << error.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
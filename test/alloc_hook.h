@@ -0,0 +1,12 @@
+#pragma once
+#include <stddef.h>
+
+namespace njones {
+namespace test {
+/**
+ * @brief The number of calls made to the global operator new, aligned or not, since the process started.
+ * Direct calls to malloc, such as fftw_malloc, are not counted.
+ */
+size_t allocation_count();
+}  // namespace test
+}  // namespace njones
@@ -1,7 +1,29 @@
+#include <math.h>
+#include <njones/a2m/async_converter.h>
 #include <njones/a2m/converter.h>
+#include <njones/a2m/converter_pool.h>
+#include <njones/a2m/file_converter.h>
+#include <njones/a2m/fixed_converter.h>
+#include <njones/a2m/magnitude.h>
+#include <njones/a2m/multi_channel_converter.h>
+#include <njones/a2m/note_tracker.h>
+#include <njones/a2m/plan_cache.h>
+#include <njones/a2m/shared_tables.h>
+#include <njones/a2m/stream_server.h>
+#include <njones/lib/ring_buffer.h>
+#include <njones/lib/udp_logger.h>
 #include <cxxtest/TestSuite.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
 #include <iostream>
+#include <random>
+#include <stdexcept>
+#include <thread>
 
+#include "alloc_hook.h"
 #include "data/stereo.h"
 
 using namespace std;
@@ -20,4 +42,1041 @@ class audio_to_midi_test_suite : public CxxTest::TestSuite {
         }
         TS_ASSERT(true);
     }
+
+    void test_span_conversion_does_not_allocate() {
+        const unsigned int samplerate = 48000;
+        const unsigned int block_size = 1024;
+        auto samples = std::vector<double>(block_size * 16);
+        for (size_t i = 0; i < samples.size(); ++i)
+            samples[i] = sin(2.0 * M_PI * 440.0 * i / samplerate);
+
+        auto converter =
+            njones::audio::a2m::Converter(samplerate, block_size, 0.0, {0, 2, 4, 5, 7, 9, 11}, {0, 127}, 4);
+        std::array<njones::audio::a2m::Note, 128> notes;
+
+        size_t detected = 0;
+        const size_t before = njones::test::allocation_count();
+        for (size_t i = 0; i < samples.size() / block_size; ++i)
+            detected += converter.convert(samples.data() + (i * block_size), notes);
+        const size_t after = njones::test::allocation_count();
+
+        TS_ASSERT_EQUALS(before, after);
+        TS_ASSERT(detected > 0);
+    }
+
+    void test_parameter_changes_take_effect_at_next_block() {
+        const unsigned int samplerate = 48000;
+        auto samples = std::vector<double>(4096);
+        for (size_t i = 0; i < samples.size(); ++i)
+            samples[i] = sin(2.0 * M_PI * 440.0 * i / samplerate);
+
+        auto converter = njones::audio::a2m::Converter(samplerate, 1024, 0.5);
+        TS_ASSERT(converter.convert(samples.data()).size() > 0);
+
+        converter.set_block_size(4096);
+        converter.set_pitch_range({0, 60});
+        TS_ASSERT_EQUALS(converter.convert(samples.data()).size(), 0u);
+
+        converter.set_pitch_range({69, 69});
+        auto notes = converter.convert(samples.data());
+        TS_ASSERT_EQUALS(notes.size(), 1u);
+        if (notes.size() == 1)
+            TS_ASSERT_EQUALS(notes[0].pitch, 69u);
+    }
+
+    void test_vector_magnitude_kernel_matches_scalar() {
+        auto generator = std::mt19937(42);
+        auto distribution = std::uniform_real_distribution<double>(-100.0, 100.0);
+        auto spectrum = std::vector<double>(2 * 1037);
+        for (auto& value : spectrum)
+            value = distribution(generator);
+        auto spectrumf = std::vector<float>(spectrum.begin(), spectrum.end());
+
+        for (size_t begin : {0, 1, 3, 17}) {
+            for (size_t end : {begin, begin + 1, begin + 7, size_t(1037)}) {
+                auto expected = njones::audio::a2m::sum_magnitudes_scalar(spectrum.data(), begin, end);
+                auto actual = njones::audio::a2m::magnitude_kernel<double>()(spectrum.data(), begin, end);
+                TS_ASSERT_EQUALS(expected.count, actual.count);
+                TS_ASSERT_DELTA(expected.amplitude, actual.amplitude, 1e-12 * (end - begin) * expected.amplitude);
+
+                auto expectedf = njones::audio::a2m::sum_magnitudes_scalar(spectrumf.data(), begin, end);
+                auto actualf = njones::audio::a2m::magnitude_kernel<float>()(spectrumf.data(), begin, end);
+                TS_ASSERT_EQUALS(expectedf.count, actualf.count);
+                TS_ASSERT_DELTA(expectedf.amplitude, actualf.amplitude, 1e-12 * (end - begin) * expectedf.amplitude);
+            }
+        }
+    }
+
+    void test_overlapping_windowed_analysis() {
+        const unsigned int samplerate = 48000;
+        const unsigned int block_size = 4096;
+        const unsigned int hop_size = 256;
+        auto samples = std::vector<double>(block_size * 2);
+        for (size_t i = 0; i < samples.size(); ++i)
+            samples[i] = sin(2.0 * M_PI * 440.0 * i / samplerate);
+
+        auto converter = njones::audio::a2m::Converter(samplerate, block_size, 0.5);
+        converter.set_hop_size(hop_size);
+        converter.set_window(njones::audio::a2m::Window::Hann);
+
+        std::vector<njones::audio::a2m::Note> notes;
+        for (size_t i = 0; i < samples.size() / hop_size; ++i)
+            notes = converter.convert(samples.data() + (i * hop_size));
+
+        TS_ASSERT_EQUALS(notes.size(), 1u);
+        if (notes.size() == 1)
+            TS_ASSERT_EQUALS(notes[0].pitch, 69u);
+    }
+
+    void test_multi_channel_conversion() {
+        const unsigned int samplerate = 48000;
+        const unsigned int block_size = 4096;
+        auto low = std::vector<double>(block_size);
+        auto high = std::vector<double>(block_size);
+        for (size_t i = 0; i < block_size; ++i) {
+            low[i] = sin(2.0 * M_PI * 440.0 * i / samplerate);
+            high[i] = sin(2.0 * M_PI * 880.0 * i / samplerate);
+        }
+        double* channels[] = {low.data(), high.data()};
+
+        auto independent = njones::audio::a2m::MultiChannelConverter(
+            2, samplerate, block_size, njones::audio::a2m::MultiChannelConverter::Mode::Independent, 0.2);
+        auto notes = independent.convert(channels);
+        TS_ASSERT_EQUALS(notes.size(), 2u);
+        if (notes.size() == 2) {
+            TS_ASSERT_EQUALS(notes[0].size(), 1u);
+            TS_ASSERT_EQUALS(notes[1].size(), 1u);
+            if (notes[0].size() == 1 && notes[1].size() == 1) {
+                TS_ASSERT_EQUALS(notes[0][0].pitch, 69u);
+                TS_ASSERT_EQUALS(notes[1][0].pitch, 81u);
+            }
+        }
+
+        auto mixed = njones::audio::a2m::MultiChannelConverter(
+            2, samplerate, block_size, njones::audio::a2m::MultiChannelConverter::Mode::MonoMix, 0.1);
+        notes = mixed.convert(channels);
+        TS_ASSERT_EQUALS(notes.size(), 1u);
+        if (notes.size() == 1)
+            TS_ASSERT_EQUALS(notes[0].size(), 2u);
+
+        for (const auto mode : {njones::audio::a2m::MultiChannelConverter::Mode::Independent,
+                                njones::audio::a2m::MultiChannelConverter::Mode::MonoMix})
+            TS_ASSERT_THROWS(njones::audio::a2m::MultiChannelConverter(0, samplerate, block_size, mode),
+                             const std::invalid_argument&);
+    }
+
+    void test_plan_cache_and_wisdom() {
+        auto& cache = njones::audio::a2m::PlanCache::instance();
+        auto in = static_cast<double*>(fftw_malloc(sizeof(double) * 1024));
+        auto out = static_cast<fftw_complex*>(fftw_malloc(sizeof(fftw_complex) * 513));
+
+        auto plan = cache.plan<double>(1024, 1, in, out);
+        TS_ASSERT_EQUALS(plan, cache.plan<double>(1024, 1, in, out));
+        TS_ASSERT_DIFFERS(plan, cache.plan<double>(1024, 2, in, out));
+
+        const std::string path = "a2m_test_wisdom";
+        TS_ASSERT(cache.export_wisdom<double>(path));
+        TS_ASSERT(cache.import_wisdom<double>(path));
+        std::remove(path.c_str());
+
+        fftw_free(in);
+        fftw_free(out);
+    }
+
+    void test_shared_tables() {
+        auto tables = njones::audio::a2m::SharedTables<int, std::vector<int>>();
+        size_t builds = 0;
+        auto build = [&]() {
+            ++builds;
+            return std::vector<int>(16);
+        };
+
+        auto table = tables.get(1, build);
+        TS_ASSERT_EQUALS(table, tables.get(1, build));
+        TS_ASSERT_DIFFERS(table, tables.get(2, build));
+        TS_ASSERT_EQUALS(builds, 2u);
+        TS_ASSERT_EQUALS(tables.size(), 1u);
+
+        // Released tables are rebuilt on the next request.
+        table.reset();
+        TS_ASSERT_EQUALS(tables.size(), 0u);
+        tables.get(1, build);
+        TS_ASSERT_EQUALS(builds, 3u);
+
+        const auto& notes = njones::audio::a2m::equal_temperament;
+        auto layout = njones::audio::a2m::BinLayout::shared(48000, 1024, notes);
+        TS_ASSERT_EQUALS(layout, njones::audio::a2m::BinLayout::shared(48000, 1024, notes));
+        TS_ASSERT_DIFFERS(layout, njones::audio::a2m::BinLayout::shared(48000, 2048, notes));
+        TS_ASSERT_EQUALS(layout->bin_freqs.size(), 512u);
+    }
+
+    void test_converter_pool_preserves_stream_order() {
+        const unsigned int samplerate = 48000;
+        const unsigned int block_size = 1024;
+        const size_t nstreams = 4;
+        const size_t nblocks = 16;
+        auto samples = std::vector<double>(block_size);
+        for (size_t i = 0; i < block_size; ++i)
+            samples[i] = sin(2.0 * M_PI * 440.0 * i / samplerate);
+
+        auto pool = njones::audio::a2m::ConverterPool(3, 2);
+        auto orders = std::vector<std::vector<size_t>>(nstreams);
+        auto ids = std::vector<njones::audio::a2m::ConverterPool::StreamId>();
+        for (size_t stream = 0; stream < nstreams; ++stream) {
+            // Each stream's callback only runs on one thread at a time, so no locking is needed here.
+            ids.push_back(pool.add_stream(
+                [&orders, stream](const size_t block_index, std::span<const njones::audio::a2m::Note>) {
+                    orders[stream].push_back(block_index);
+                },
+                samplerate, block_size));
+        }
+
+        for (size_t block = 0; block < nblocks; ++block)
+            for (auto id : ids)
+                pool.submit(id, samples.data(), samples.size());
+        pool.wait();
+
+        for (auto& order : orders) {
+            TS_ASSERT_EQUALS(order.size(), nblocks);
+            for (size_t block = 0; block < order.size(); ++block)
+                TS_ASSERT_EQUALS(order[block], block);
+        }
+
+        // With one worker and a batch of one, a stream submitted behind a long one runs after one block of
+        // it rather than after all of them.
+        auto single = njones::audio::a2m::ConverterPool(1, 1);
+        auto streams = std::vector<size_t>();
+        auto running = std::atomic<bool>(false);
+        auto released = std::atomic<bool>(false);
+        auto record = [&](const size_t stream) {
+            return [&, stream](const size_t, std::span<const njones::audio::a2m::Note>) {
+                // Holds the first block until everything else is queued behind the running drain task.
+                running.store(true);
+                while (!released.load())
+                    std::this_thread::yield();
+                streams.push_back(stream);
+            };
+        };
+        const auto busy = single.add_stream(record(0), samplerate, block_size);
+        const auto late = single.add_stream(record(1), samplerate, block_size);
+        single.submit(busy, samples.data(), samples.size());
+        while (!running.load())
+            std::this_thread::yield();
+        for (size_t block = 1; block < nblocks; ++block)
+            single.submit(busy, samples.data(), samples.size());
+        single.submit(late, samples.data(), samples.size());
+        released.store(true);
+        single.wait();
+        TS_ASSERT_EQUALS(streams.size(), nblocks + 1);
+        TS_ASSERT_EQUALS(std::find(streams.begin(), streams.end(), 1u) - streams.begin(), 1);
+    }
+
+    void test_wav_to_midi_file() {
+        const unsigned int samplerate = 44100;
+        const size_t nframes = samplerate;
+        const std::string wav_path = "a2m_test.wav";
+        const std::string midi_path = "a2m_test.mid";
+
+        // One second of a 440 Hz tone as 16 bit stereo, silent for the second half.
+        {
+            auto put = [](std::ofstream& file, uint32_t value, int bytes) {
+                for (int i = 0; i < bytes; ++i)
+                    file.put(static_cast<char>(value >> (8 * i)));
+            };
+            std::ofstream wav(wav_path, std::ios::binary);
+            wav.write("RIFF", 4);
+            put(wav, 36 + nframes * 4, 4);
+            wav.write("WAVEfmt ", 8);
+            put(wav, 16, 4);
+            put(wav, 1, 2);
+            put(wav, 2, 2);
+            put(wav, samplerate, 4);
+            put(wav, samplerate * 4, 4);
+            put(wav, 4, 2);
+            put(wav, 16, 2);
+            wav.write("data", 4);
+            put(wav, nframes * 4, 4);
+            for (size_t i = 0; i < nframes; ++i) {
+                const auto sample =
+                    i < nframes / 2 ? static_cast<int16_t>(16384 * sin(2.0 * M_PI * 440.0 * i / samplerate)) : 0;
+                put(wav, static_cast<uint16_t>(sample), 2);
+                put(wav, static_cast<uint16_t>(sample), 2);
+            }
+        }
+
+        njones::audio::a2m::FileConversionStats stats;
+        {
+            auto input = njones::audio::a2m::PcmFile(wav_path);
+            TS_ASSERT_EQUALS(input.get_format().nchannels, 2u);
+            TS_ASSERT_EQUALS(input.get_nframes(), nframes);
+
+            auto output = njones::audio::a2m::MidiFileWriter(midi_path);
+            auto options = njones::audio::a2m::FileConversionOptions();
+            options.activation_level = 0.1;
+            options.chunk_frames = 10000;
+            stats = njones::audio::a2m::convert_file<double>(input, output, options);
+        }
+        TS_ASSERT_EQUALS(stats.nframes, nframes);
+        TS_ASSERT_EQUALS(stats.nblocks, (nframes + 4095) / 4096);
+        TS_ASSERT_EQUALS(stats.nnotes, 1u);
+
+        std::ifstream midi(midi_path, std::ios::binary);
+        auto bytes = std::vector<unsigned char>(std::istreambuf_iterator<char>(midi), std::istreambuf_iterator<char>());
+        std::remove(wav_path.c_str());
+        std::remove(midi_path.c_str());
+
+        TS_ASSERT(bytes.size() > 22);
+        if (bytes.size() > 22) {
+            TS_ASSERT_EQUALS(std::string(bytes.begin(), bytes.begin() + 4), "MThd");
+            TS_ASSERT_EQUALS(std::string(bytes.begin() + 14, bytes.begin() + 18), "MTrk");
+            const size_t track_length = (bytes[18] << 24) | (bytes[19] << 16) | (bytes[20] << 8) | bytes[21];
+            TS_ASSERT_EQUALS(track_length, bytes.size() - 22);
+        }
+
+        // The tone becomes A4, switched on at the start and off once the tone stops.
+        const unsigned char note_on[] = {0x90, 69};
+        const unsigned char note_off[] = {0x80, 69};
+        auto on = std::search(bytes.begin(), bytes.end(), std::begin(note_on), std::end(note_on));
+        auto off = std::search(bytes.begin(), bytes.end(), std::begin(note_off), std::end(note_off));
+        TS_ASSERT(on != bytes.end());
+        TS_ASSERT(off != bytes.end());
+        TS_ASSERT(on < off);
+    }
+
+    void test_instrumentation_counters() {
+        const unsigned int samplerate = 48000;
+        const unsigned int block_size = 1024;
+        const size_t nblocks = 8;
+        auto samples = std::vector<double>(block_size);
+        for (size_t i = 0; i < block_size; ++i)
+            samples[i] = sin(2.0 * M_PI * 440.0 * i / samplerate) + sin(2.0 * M_PI * 880.0 * i / samplerate);
+
+        auto converter = njones::audio::a2m::Converter(samplerate, block_size, 0.0, {}, {0, 127}, 1);
+        std::array<njones::audio::a2m::Note, 128> notes;
+        size_t emitted = 0;
+        for (size_t i = 0; i < nblocks; ++i)
+            emitted += converter.convert(samples.data(), notes);
+
+        const auto snapshot = converter.get_instrumentation();
+        if constexpr (njones::audio::a2m::instrumentation_enabled) {
+            TS_ASSERT_EQUALS(snapshot.blocks, nblocks);
+            TS_ASSERT_EQUALS(snapshot[njones::audio::a2m::Stage::Fft].calls, nblocks);
+            TS_ASSERT_EQUALS(snapshot[njones::audio::a2m::Stage::Select].calls, nblocks);
+            TS_ASSERT_EQUALS(snapshot.notes_emitted, emitted);
+            // note_count keeps only the loudest of the two tones.
+            TS_ASSERT(snapshot.notes_dropped >= nblocks);
+
+            uint64_t histogram_blocks = 0;
+            for (auto count : snapshot.latency_histogram)
+                histogram_blocks += count;
+            TS_ASSERT_EQUALS(histogram_blocks, nblocks);
+            TS_ASSERT(snapshot.latency_quantile_ns(0.5) > 0);
+        } else {
+            TS_ASSERT_EQUALS(snapshot.blocks, 0u);
+            TS_ASSERT_EQUALS(snapshot.latency_quantile_ns(0.5), 0u);
+        }
+    }
+
+    void test_udp_logger_batches_and_flushes() {
+        using boost::asio::ip::udp;
+        boost::asio::io_service io_service;
+        auto receiver = udp::socket(io_service, udp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+        const auto port = receiver.local_endpoint().port();
+
+        const size_t nmessages = 200;
+        const size_t noverflow = 300;
+        uint64_t datagrams = 0;
+        uint64_t dropped = 0;
+        {
+            // A long flush interval leaves the messages queued until shutdown, which must send them all.
+            auto logger = njones::audio::UDPLogger("127.0.0.1", port, 256, std::chrono::seconds(10));
+            for (size_t i = 0; i < nmessages; ++i)
+                logger.log("message " + std::to_string(i));
+            logger.log(std::string(2 * njones::audio::UDPLogger::max_message_size, 'x'));
+            logger.flush();
+            TS_ASSERT_EQUALS(logger.get_sent(), nmessages + 1);
+            TS_ASSERT_EQUALS(logger.get_dropped(), 0u);
+
+            // More messages than the queue holds; every one is either sent at shutdown or counted as dropped.
+            for (size_t i = 0; i < noverflow; ++i)
+                logger.log("overflow");
+            dropped = logger.get_dropped();
+            datagrams = logger.get_datagrams();
+        }
+        TS_ASSERT(datagrams < nmessages);
+        TS_ASSERT(dropped > 0);
+
+        auto lines = std::vector<std::string>();
+        std::array<char, 65536> buffer;
+        receiver.non_blocking(true);
+        boost::system::error_code err;
+        while (true) {
+            const size_t length = receiver.receive(boost::asio::buffer(buffer), 0, err);
+            if (err)
+                break;
+            TS_ASSERT(length <= njones::audio::UDPLogger::max_datagram_size);
+            size_t begin = 0;
+            for (size_t i = 0; i <= length; ++i)
+                if (i == length || buffer[i] == '\n') {
+                    lines.emplace_back(buffer.data() + begin, i - begin);
+                    begin = i + 1;
+                }
+        }
+
+        // Every message before the overflow arrives in order and the long one is truncated.
+        TS_ASSERT_EQUALS(lines.size(), nmessages + 1 + noverflow - dropped);
+        if (lines.size() > nmessages) {
+            for (size_t i = 0; i < nmessages; ++i)
+                TS_ASSERT_EQUALS(lines[i], "message " + std::to_string(i));
+            TS_ASSERT_EQUALS(lines[nmessages].size(), njones::audio::UDPLogger::max_message_size);
+        }
+    }
+
+    void test_stream_server_matches_local_conversion() {
+        using namespace njones::audio::a2m;
+        using boost::asio::ip::tcp;
+        const unsigned int samplerate = 44100;
+        const unsigned int block_size = 1024;
+        const unsigned int nblocks = 24;
+        const int nstreams = 4;
+
+        const auto hello = StreamHello{PcmFormat{SampleFormat::Int16, 2, samplerate}, Window::Hann, 2, block_size,
+                                       block_size / 2, 0.1};
+        std::array<uint8_t, StreamHello::size> hello_bytes;
+        encode_hello(hello, hello_bytes.data());
+        auto decoded = StreamHello();
+        TS_ASSERT(decode_hello(hello_bytes.data(), decoded));
+        TS_ASSERT_EQUALS(decoded.format.nchannels, 2u);
+        TS_ASSERT_EQUALS(decoded.hop_size, block_size / 2);
+        TS_ASSERT((decoded.window == Window::Hann));
+
+        // Stereo 16 bit PCM of a 440 Hz tone which stops half way, followed by a partial hop the server drops.
+        const unsigned int hop = block_size / 2;
+        const size_t nframes = nblocks * hop + 100;
+        auto pcm = std::vector<uint8_t>();
+        for (size_t i = 0; i < nframes; ++i) {
+            const double level = i < nframes / 2 ? 0.5 : 0.0;
+            const auto sample = static_cast<int16_t>(32767 * level * sin(2.0 * M_PI * 440.0 * i / samplerate));
+            for (int channel = 0; channel < 2; ++channel) {
+                pcm.push_back(static_cast<uint8_t>(sample));
+                pcm.push_back(static_cast<uint8_t>(static_cast<uint16_t>(sample) >> 8));
+            }
+        }
+
+        // The frames a converter and note tracker produce for the same samples in process.
+        auto expected = std::vector<uint8_t>();
+        {
+            auto converter = Converter(samplerate, block_size, hello.activation_level);
+            converter.set_hop_size(hop);
+            converter.set_window(hello.window);
+            converter.set_octave_levels(hello.octave_levels);
+            auto tracker = NoteTracker();
+            auto samples = std::vector<double>(hop);
+            std::array<Note, 128> notes;
+            std::array<NoteEvent, 128> events;
+            std::array<uint8_t, frame_size(128)> frame;
+            for (unsigned int block = 0; block < nblocks; ++block) {
+                decode_mono(hello.format, pcm.data() + block * hop * 4, samples.data(), hop);
+                const size_t nnotes = converter.convert(samples.data(), std::span<Note>(notes));
+                const size_t nevents = tracker.update(std::span<const Note>(notes.data(), nnotes),
+                                                      uint64_t(block + 1) * hop, events);
+                const size_t length = encode_frame(block, std::span<const NoteEvent>(events.data(), nevents), 0,
+                                                   frame.data());
+                expected.insert(expected.end(), frame.begin(), frame.begin() + length);
+            }
+            const size_t nevents = tracker.flush(uint64_t(nblocks) * hop, events);
+            const size_t length = encode_frame(nblocks, std::span<const NoteEvent>(events.data(), nevents),
+                                               FrameHeader::final, frame.data());
+            expected.insert(expected.end(), frame.begin(), frame.begin() + length);
+        }
+
+        // One frame per hop and a final one; the tone's notes start and all stop before the stream ends.
+        unsigned int nframes_expected = 0;
+        int sounding = 0;
+        int started = 0;
+        for (size_t offset = 0; offset < expected.size(); ++nframes_expected) {
+            const auto header = decode_frame_header(expected.data() + offset);
+            TS_ASSERT_EQUALS(header.block, nframes_expected);
+            TS_ASSERT_EQUALS(header.flags, nframes_expected == nblocks ? FrameHeader::final : 0);
+            for (unsigned int i = 0; i < header.nevents; ++i) {
+                const auto event = decode_event(expected.data() + offset + frame_size(i), (header.block + 1) * hop);
+                started += event.type == NoteEvent::Type::On ? 1 : 0;
+                sounding += event.type == NoteEvent::Type::On ? 1 : event.type == NoteEvent::Type::Off ? -1 : 0;
+            }
+            offset += frame_size(header.nevents);
+            if (header.flags & FrameHeader::final)
+                TS_ASSERT_EQUALS(header.nevents, 0u);
+        }
+        TS_ASSERT_EQUALS(nframes_expected, nblocks + 1);
+        TS_ASSERT(started > 0);
+        TS_ASSERT_EQUALS(sounding, 0);
+
+        auto server = StreamServer("127.0.0.1", 0, 2);
+        const auto endpoint = tcp::endpoint(boost::asio::ip::address_v4::loopback(), server.get_port());
+        boost::asio::io_context io_context;
+
+        // Concurrent streams, each sent in full before any frame is read back.
+        auto sockets = std::vector<tcp::socket>();
+        for (int i = 0; i < nstreams; ++i) {
+            sockets.emplace_back(io_context);
+            sockets.back().connect(endpoint);
+            boost::asio::write(sockets.back(), boost::asio::buffer(hello_bytes));
+        }
+        for (auto& socket : sockets) {
+            boost::asio::write(socket, boost::asio::buffer(pcm));
+            socket.shutdown(tcp::socket::shutdown_send);
+        }
+        for (auto& socket : sockets) {
+            auto received = std::vector<uint8_t>();
+            boost::system::error_code err;
+            boost::asio::read(socket, boost::asio::dynamic_buffer(received), err);
+            TS_ASSERT((err == boost::asio::error::eof));
+            TS_ASSERT((received == expected));
+        }
+
+        // A stream with a bad magic is closed without a frame.
+        auto rejected = tcp::socket(io_context);
+        rejected.connect(endpoint);
+        hello_bytes[0] ^= 0xff;
+        boost::asio::write(rejected, boost::asio::buffer(hello_bytes));
+        auto received = std::vector<uint8_t>();
+        boost::system::error_code err;
+        boost::asio::read(rejected, boost::asio::dynamic_buffer(received), err);
+        TS_ASSERT(received.empty());
+
+        const auto stats = server.get_stats();
+        TS_ASSERT_EQUALS(stats.connections, uint64_t(nstreams + 1));
+        TS_ASSERT_EQUALS(stats.rejected, 1u);
+        TS_ASSERT_EQUALS(stats.blocks, uint64_t(nstreams) * nblocks);
+        TS_ASSERT_EQUALS(stats.bytes_sent, uint64_t(nstreams) * expected.size());
+    }
+
+    void test_note_tracker_events() {
+        typedef njones::audio::a2m::NoteEvent::Type Type;
+        const uint64_t block = 512;
+        std::array<njones::audio::a2m::NoteEvent, 128> events;
+        auto frame = [](const unsigned int velocity) {
+            return std::vector<njones::audio::a2m::Note>{njones::audio::a2m::Note(69, 69, velocity)};
+        };
+        const auto silence = std::vector<njones::audio::a2m::Note>();
+
+        // Hysteresis: starts above 50, keeps sounding down to 20, and a single missing block is bridged.
+        auto tracker = njones::audio::a2m::NoteTracker(50, 20, 1, 0, 10);
+        TS_ASSERT_EQUALS(tracker.update(frame(40), 0 * block, events), 0u);
+        TS_ASSERT_EQUALS(tracker.update(frame(60), 1 * block, events), 1u);
+        TS_ASSERT(events[0].type == Type::On);
+        TS_ASSERT_EQUALS(events[0].offset, 1 * block);
+        TS_ASSERT_EQUALS(tracker.update(frame(62), 2 * block, events), 0u);
+        TS_ASSERT_EQUALS(tracker.update(frame(30), 3 * block, events), 1u);
+        TS_ASSERT(events[0].type == Type::Velocity);
+        TS_ASSERT_EQUALS(events[0].velocity, 30u);
+        TS_ASSERT_EQUALS(tracker.update(silence, 4 * block, events), 0u);
+        TS_ASSERT_EQUALS(tracker.update(frame(30), 5 * block, events), 0u);
+        TS_ASSERT_EQUALS(tracker.update(frame(10), 6 * block, events), 0u);
+        TS_ASSERT_EQUALS(tracker.update(silence, 7 * block, events), 1u);
+        TS_ASSERT(events[0].type == Type::Off);
+        TS_ASSERT_EQUALS(events[0].offset, 7 * block);
+
+        // Minimum duration: a one block blip is ignored and a sustained note starts once confirmed.
+        auto debounced = njones::audio::a2m::NoteTracker(1, 1, 0, 2 * block);
+        TS_ASSERT_EQUALS(debounced.update(frame(60), 0 * block, events), 0u);
+        TS_ASSERT_EQUALS(debounced.update(silence, 1 * block, events), 0u);
+        size_t total = 0;
+        for (uint64_t i = 2; i < 100; ++i)
+            total += debounced.update(frame(60), i * block, events);
+        TS_ASSERT_EQUALS(total, 1u);
+        TS_ASSERT_EQUALS(debounced.flush(100 * block, events), 1u);
+        TS_ASSERT(events[0].type == Type::Off);
+    }
+
+    void test_note_count_keeps_loudest_notes() {
+        const unsigned int samplerate = 48000;
+        const unsigned int block_size = 2048;
+        auto engine = std::mt19937(7);
+        auto distribution = std::uniform_real_distribution<double>(-1.0, 1.0);
+        auto samples = std::vector<double>(block_size);
+        for (auto& sample : samples)
+            sample = distribution(engine);
+
+        auto unlimited = njones::audio::a2m::Converter(samplerate, block_size);
+        auto limited = njones::audio::a2m::Converter(samplerate, block_size, 0.0, {}, {0, 127}, 5);
+        auto truncated = njones::audio::a2m::Converter(samplerate, block_size);
+        auto all = unlimited.convert(samples.data());
+        auto loudest = limited.convert(samples.data());
+        auto output = std::array<njones::audio::a2m::Note, 3>();
+        const size_t kept = truncated.convert(samples.data(), output);
+
+        // Noise lights up most pitches; without a limit they come out in pitch order.
+        TS_ASSERT(all.size() > 5);
+        for (size_t i = 1; i < all.size(); ++i)
+            TS_ASSERT(all[i - 1].pitch < all[i].pitch);
+
+        std::sort(all.begin(), all.end(), std::greater<>());
+        TS_ASSERT_EQUALS(loudest.size(), 5u);
+        for (size_t i = 0; i < loudest.size() && i < all.size(); ++i)
+            TS_ASSERT_EQUALS(loudest[i].velocity, all[i].velocity);
+
+        // An output smaller than the detected notes keeps the loudest ones as well.
+        TS_ASSERT_EQUALS(kept, 3u);
+        for (size_t i = 0; i < kept; ++i)
+            TS_ASSERT_EQUALS(output[i].velocity, all[i].velocity);
+    }
+
+    void test_octave_levels_resolve_low_notes() {
+        const unsigned int samplerate = 48000;
+        const unsigned int block_size = 512;
+        auto samples = std::vector<double>(block_size * 48);
+        for (size_t i = 0; i < samples.size(); ++i)
+            samples[i] =
+                0.5 * sin(2.0 * M_PI * 55.0 * i / samplerate) + 0.5 * sin(2.0 * M_PI * 3520.0 * i / samplerate);
+
+        auto has_pitch = [](const std::vector<njones::audio::a2m::Note>& notes, const unsigned int pitch) {
+            return std::any_of(notes.begin(), notes.end(), [pitch](const auto& note) { return note.pitch == pitch; });
+        };
+
+        // 93.75 Hz bins cannot see A1 at 55 Hz, five decimations bring them down to 2.9 Hz.
+        auto single = njones::audio::a2m::Converter(samplerate, block_size, 0.3);
+        auto cascade = njones::audio::a2m::Converter(samplerate, block_size, 0.3);
+        cascade.set_octave_levels(6);
+
+        std::vector<njones::audio::a2m::Note> coarse;
+        std::vector<njones::audio::a2m::Note> fine;
+        for (size_t i = 0; i < samples.size() / block_size; ++i) {
+            coarse = single.convert(samples.data() + (i * block_size));
+            fine = cascade.convert(samples.data() + (i * block_size));
+        }
+
+        TS_ASSERT_EQUALS(coarse.size(), 1u);
+        TS_ASSERT(has_pitch(coarse, 105));
+        TS_ASSERT_EQUALS(fine.size(), 2u);
+        TS_ASSERT(has_pitch(fine, 105));
+        TS_ASSERT(has_pitch(fine, 33));
+    }
+
+    void test_peak_refinement_places_detuned_notes() {
+        const unsigned int samplerate = 48000;
+
+        // The loudest note of a tone detuned by up to 0.3 semitones, after enough blocks to fill every level.
+        auto loudest = [&](const unsigned int block_size, const unsigned int levels,
+                           const njones::audio::a2m::Window window, const njones::audio::a2m::Refinement refinement,
+                           const int pitch) {
+            const double detune = pow(2.0, 0.3 / 12 * (pitch % 3 - 1));
+            const double freq = njones::audio::a2m::equal_temperament[pitch].mid * detune;
+            auto converter = njones::audio::a2m::Converter(samplerate, block_size, 0.05, {}, {0, 127}, 1);
+            converter.set_window(window);
+            converter.set_octave_levels(levels);
+            converter.set_refinement(refinement);
+
+            auto samples = std::vector<double>(block_size);
+            std::vector<njones::audio::a2m::Note> notes;
+            for (size_t block = 0; block < (1u << levels) + 2; ++block) {
+                for (size_t i = 0; i < block_size; ++i)
+                    samples[i] = 0.5 * sin(2.0 * M_PI * freq * (block * block_size + i) / samplerate + 0.7);
+                notes = converter.convert(samples.data());
+            }
+            return notes.size() == 1 ? static_cast<int>(notes[0].pitch) : -1;
+        };
+
+        // 23.4 Hz bins are wider than every semitone below C5, so bin centres misplace detuned notes.
+        size_t misplaced = 0;
+        for (const auto window : {njones::audio::a2m::Window::Rectangular, njones::audio::a2m::Window::Hann})
+            for (int pitch = 48; pitch <= 96; ++pitch) {
+                TS_ASSERT_EQUALS(loudest(2048, 1, window, njones::audio::a2m::Refinement::Peaks, pitch), pitch);
+                misplaced += loudest(2048, 1, window, njones::audio::a2m::Refinement::None, pitch) != pitch;
+            }
+        TS_ASSERT(misplaced > 0);
+
+        // With octave levels a quarter of the block size reaches down to C2.
+        for (int pitch = 36; pitch <= 96; ++pitch)
+            TS_ASSERT_EQUALS(
+                loudest(512, 3, njones::audio::a2m::Window::Hann, njones::audio::a2m::Refinement::Peaks, pitch),
+                pitch);
+    }
+
+    void test_silence_and_stationarity_gates() {
+        // The vector kernels against a plain loop, for every remainder.
+        std::mt19937 engine(7);
+        std::uniform_real_distribution<double> distribution(-1.0, 1.0);
+        for (size_t n : {1, 2, 3, 4, 5, 6, 7, 9, 1023}) {
+            auto samples = std::vector<double>(n);
+            for (auto& sample : samples)
+                sample = distribution(engine);
+            auto narrowed = std::vector<float>(samples.begin(), samples.end());
+
+            double peak = 0.0, energy = 0.0, slope_energy = 0.0;
+            for (size_t i = 0; i < n; ++i) {
+                peak = std::max(peak, fabs(double(narrowed[i])));
+                energy += double(narrowed[i]) * narrowed[i];
+                if (i > 0)
+                    slope_energy += (double(narrowed[i]) - narrowed[i - 1]) * (double(narrowed[i]) - narrowed[i - 1]);
+            }
+            for (const auto levels : {njones::audio::a2m::measure_block(samples.data(), n),
+                                      njones::audio::a2m::measure_block(narrowed.data(), n)}) {
+                TS_ASSERT_DELTA(levels.peak, peak, 1e-6);
+                TS_ASSERT_DELTA(levels.energy, energy, 1e-4);
+                TS_ASSERT_DELTA(levels.slope_energy, slope_energy, 1e-4);
+            }
+            // The float kernels widen before they difference and square, so they only differ from the
+            // plain loop in the order of the sums.
+            const auto levels = njones::audio::a2m::measure_block(narrowed.data(), n);
+            TS_ASSERT_DELTA(levels.energy, energy, 1e-12 * n);
+            TS_ASSERT_DELTA(levels.slope_energy, slope_energy, 1e-12 * n);
+        }
+
+        // A tone, near silence long enough to fill every level, and the tone again, hopping through a
+        // window over three levels. The silence gate must not change a single note.
+        const unsigned int samplerate = 48000;
+        const unsigned int block_size = 1024;
+        const unsigned int hop_size = 256;
+        auto signal = std::vector<double>(hop_size * 160);
+        for (size_t i = 0; i < signal.size(); ++i) {
+            const bool quiet = i >= hop_size * 40 && i < hop_size * 120;
+            signal[i] = quiet ? 1e-5 * distribution(engine) : 0.5 * sin(2.0 * M_PI * 440.0 * i / samplerate);
+        }
+
+        auto plain = njones::audio::a2m::Converter(samplerate, block_size, 0.1);
+        auto gated = njones::audio::a2m::Converter(samplerate, block_size, 0.1);
+        for (auto converter : {&plain, &gated}) {
+            converter->set_hop_size(hop_size);
+            converter->set_window(njones::audio::a2m::Window::Hann);
+            converter->set_octave_levels(3);
+        }
+        gated.set_silence_gate(true);
+
+        size_t mismatches = 0;
+        for (size_t hop = 0; hop < signal.size() / hop_size; ++hop) {
+            const auto expected = plain.convert(signal.data() + hop * hop_size);
+            const auto notes = gated.convert(signal.data() + hop * hop_size);
+            mismatches += notes.size() != expected.size() ||
+                          !std::equal(notes.begin(), notes.end(), expected.begin(), [](const auto& a, const auto& b) {
+                              return a.pitch == b.pitch && a.velocity == b.velocity;
+                          });
+        }
+        auto counters = gated.get_gate_counters();
+        TS_ASSERT_EQUALS(mismatches, 0u);
+        TS_ASSERT_EQUALS(counters.blocks, 160u);
+        // The quiet stretch is 80 hops, of which the first (4 * 1024 + 3 * 31) / 256 fill the history.
+        TS_ASSERT_EQUALS(counters.silent, 80u - 16u);
+        TS_ASSERT_EQUALS(counters.stationary, 0u);
+
+        // A held tone repeats its notes for up to 4 blocks after each full analysis, and a new tone of the
+        // same loudness is analysed at once.
+        auto steady = njones::audio::a2m::Converter(samplerate, block_size, 0.1, {}, {0, 127}, 1);
+        steady.set_stationarity(0.05, 4);
+        auto samples = std::vector<double>(block_size);
+        std::vector<njones::audio::a2m::Note> notes;
+        for (size_t block = 0; block < 21; ++block) {
+            const double freq = block < 20 ? 440.0 : 660.0;
+            for (size_t i = 0; i < block_size; ++i)
+                samples[i] = 0.5 * sin(2.0 * M_PI * freq * (block * block_size + i) / samplerate);
+            notes = steady.convert(samples.data());
+            TS_ASSERT_EQUALS(notes.size(), 1u);
+        }
+        counters = steady.get_gate_counters();
+        TS_ASSERT_EQUALS(counters.stationary, 16u);
+        TS_ASSERT_EQUALS(counters.silent, 0u);
+        if (notes.size() == 1)
+            TS_ASSERT_EQUALS(notes[0].pitch, 76u);
+    }
+
+    void test_goertzel_detector_matches_fft() {
+        const unsigned int samplerate = 48000;
+        const unsigned int block_size = 4096;
+        const unsigned int hop_size = 1024;
+        auto samples = std::vector<double>(block_size * 4);
+        for (size_t i = 0; i < samples.size(); ++i)
+            samples[i] = 0.3 * (sin(2.0 * M_PI * 220.0 * i / samplerate) + sin(2.0 * M_PI * 261.6 * i / samplerate) +
+                                sin(2.0 * M_PI * 440.0 * i / samplerate));
+
+        // A3 and C4 fall inside the range, A4 does not.
+        auto fft = njones::audio::a2m::Converter(samplerate, block_size, 0.2, {}, {57, 62});
+        auto goertzel = njones::audio::a2m::Converter(samplerate, block_size, 0.2, {}, {57, 62});
+        fft.set_detector(njones::audio::a2m::Detector::Fft);
+        goertzel.set_detector(njones::audio::a2m::Detector::Goertzel);
+        for (auto converter : {&fft, &goertzel}) {
+            converter->set_hop_size(hop_size);
+            converter->set_window(njones::audio::a2m::Window::Hann);
+        }
+
+        for (size_t i = 0; i < samples.size() / hop_size; ++i) {
+            auto expected = fft.convert(samples.data() + (i * hop_size));
+            auto actual = goertzel.convert(samples.data() + (i * hop_size));
+            TS_ASSERT_EQUALS(expected.size(), actual.size());
+            for (size_t j = 0; j < expected.size() && j < actual.size(); ++j) {
+                TS_ASSERT_EQUALS(expected[j].pitch, actual[j].pitch);
+                TS_ASSERT_EQUALS(expected[j].velocity, actual[j].velocity);
+            }
+            if (i == samples.size() / hop_size - 1)
+                TS_ASSERT_EQUALS(actual.size(), 2u);
+        }
+    }
+
+    void test_fixed_converter_matches_converter() {
+        const unsigned int samplerate = 44100;
+        const unsigned int block_size = 1024;
+        auto samples = std::vector<double>(block_size * 8);
+        for (size_t i = 0; i < samples.size(); ++i)
+            samples[i] =
+                0.4 * sin(2.0 * M_PI * 220.0 * i / samplerate) + 0.4 * sin(2.0 * M_PI * 659.3 * i / samplerate);
+
+        static_assert(njones::audio::a2m::FixedLayout<samplerate, block_size>::mapping.count > 0);
+        auto fixed = std::make_unique<njones::audio::a2m::FixedConverter<samplerate, block_size>>(
+            0.1, std::vector<unsigned int>{0, 2, 4, 5, 7, 9, 11}, std::array<unsigned int, 2>{0, 120}, 3, 2);
+        auto dynamic =
+            njones::audio::a2m::Converter(samplerate, block_size, 0.1, {0, 2, 4, 5, 7, 9, 11}, {0, 120}, 3, 2);
+        dynamic.set_detector(njones::audio::a2m::Detector::Fft);
+
+        std::array<njones::audio::a2m::Note, 128> expected;
+        std::array<njones::audio::a2m::Note, 128> actual;
+        size_t allocations = 0;
+        for (size_t i = 0; i < samples.size() / block_size; ++i) {
+            const size_t expected_count = dynamic.convert(samples.data() + (i * block_size), expected);
+            const size_t before = njones::test::allocation_count();
+            const size_t actual_count = fixed->convert(samples.data() + (i * block_size), actual);
+            allocations += njones::test::allocation_count() - before;
+
+            TS_ASSERT(expected_count > 0);
+            TS_ASSERT_EQUALS(expected_count, actual_count);
+            for (size_t j = 0; j < expected_count && j < actual_count; ++j) {
+                TS_ASSERT_EQUALS(expected[j].pitch, actual[j].pitch);
+                TS_ASSERT_EQUALS(expected[j].raw_pitch, actual[j].raw_pitch);
+                TS_ASSERT_EQUALS(expected[j].velocity, actual[j].velocity);
+            }
+        }
+        TS_ASSERT_EQUALS(allocations, 0u);
+    }
+
+    void test_ring_buffer_formats_and_zero_copy() {
+        // Interleaved int16 stereo split across calls is de-interleaved and scaled to [-1.0, 1.0).
+        auto channels = std::vector<std::vector<double>>(2);
+        auto int16_buffer = njones::audio::RingBuffer<int16_t, double>(
+            [&](const int channel, double* samples, const int) {
+                channels[channel].insert(channels[channel].end(), samples, samples + 4);
+            },
+            2, 4);
+        const int16_t interleaved[] = {-32768, 16384, 0, -16384, 8192, 0, 16384, -8192, 0, 0};
+        int16_buffer.add_interleaved(interleaved, 3);
+        int16_buffer.add_interleaved(interleaved + 6, 2);
+        TS_ASSERT((channels[0] == std::vector<double>{-1.0, 0.0, 0.25, 0.5}));
+        TS_ASSERT((channels[1] == std::vector<double>{0.5, -0.5, 0.0, -0.25}));
+
+        // Packed 24 bit samples are sign extended.
+        auto int24 = std::vector<double>();
+        auto int24_buffer = njones::audio::RingBuffer<njones::audio::Int24, double>(
+            [&](const int, double* samples, const int) { int24.assign(samples, samples + 3); }, 1, 3);
+        njones::audio::Int24 packed[] = {{{0x00, 0x00, 0x80}}, {{0x00, 0x00, 0x40}}, {{0xff, 0xff, 0xff}}};
+        njones::audio::Int24* planar[] = {packed};
+        int24_buffer.add(planar, 3);
+        TS_ASSERT((int24 == std::vector<double>{-1.0, 0.5, -1.0 / (1 << 23)}));
+
+        // Interleaved float stereo widened to double, through the vector path and its scalar tail.
+        auto stereo = std::vector<float>(18);
+        for (size_t i = 0; i < stereo.size(); ++i)
+            stereo[i] = 0.1f * i;
+        channels = std::vector<std::vector<double>>(2);
+        auto float_buffer = njones::audio::RingBuffer<float, double>(
+            [&](const int channel, double* samples, const int) { channels[channel].assign(samples, samples + 9); },
+            2, 9);
+        float_buffer.add_interleaved(stereo.data(), 9);
+        for (size_t i = 0; i < 9; ++i) {
+            TS_ASSERT_EQUALS(channels[0][i], static_cast<double>(stereo[2 * i]));
+            TS_ASSERT_EQUALS(channels[1][i], static_cast<double>(stereo[2 * i + 1]));
+        }
+
+        // Whole blocks of same type planar input are processed in place, the remainder is buffered.
+        auto host = std::vector<float>(12);
+        for (size_t i = 0; i < host.size(); ++i)
+            host[i] = static_cast<float>(i);
+        auto pointers = std::vector<const float*>();
+        auto offsets = std::vector<int>();
+        auto firsts = std::vector<float>();
+        auto same_buffer = njones::audio::RingBuffer<float, float>(
+            [&](const int, float* samples, const int offset) {
+                pointers.push_back(samples);
+                offsets.push_back(offset);
+                firsts.push_back(samples[0]);
+            },
+            1, 4);
+        float* first[] = {host.data()};
+        float* second[] = {host.data() + 10};
+        same_buffer.add(first, 10);
+        same_buffer.add(second, 2);
+        TS_ASSERT_EQUALS(pointers.size(), 3u);
+        TS_ASSERT_EQUALS(pointers[0], host.data());
+        TS_ASSERT_EQUALS(pointers[1], host.data() + 4);
+        TS_ASSERT(pointers[2] != host.data() + 8);
+        TS_ASSERT((offsets == std::vector<int>{0, 4, -2}));
+        TS_ASSERT((firsts == std::vector<float>{0.0f, 4.0f, 8.0f}));
+    }
+
+    void test_async_converter_matches_converter() {
+        const unsigned int samplerate = 44100;
+        const unsigned int block_size = 1024;
+        const unsigned int hop_size = 256;
+        const size_t nhops = 32;
+        auto samples = std::vector<double>(hop_size * nhops);
+        for (size_t i = 0; i < samples.size(); ++i)
+            samples[i] =
+                0.5 * sin(2.0 * M_PI * 440.0 * i / samplerate) + 0.3 * sin(2.0 * M_PI * 1318.5 * i / samplerate);
+
+        auto expected = std::vector<std::vector<njones::audio::a2m::Note>>();
+        auto converter = njones::audio::a2m::Converter(samplerate, block_size, 0.1);
+        converter.set_hop_size(hop_size);
+        for (size_t i = 0; i < nhops; ++i)
+            expected.push_back(converter.convert(samples.data() + i * hop_size));
+
+        // Room for every hop, so nothing is dropped however slowly the analysis thread starts.
+        auto async = njones::audio::a2m::AsyncConverter(samplerate, block_size, hop_size, nhops, 0.1);
+        auto frames = std::vector<std::vector<njones::audio::a2m::Note>>();
+        auto positions = std::vector<uint64_t>();
+        size_t discontinuities = 0;
+        const auto drain = [&](const njones::audio::a2m::AsyncConverter::Frame& frame) {
+            positions.push_back(frame.position);
+            discontinuities += frame.discontinuous ? 1 : 0;
+            frames.emplace_back(frame.notes.begin(), frame.notes.begin() + frame.count);
+        };
+
+        // Host buffers which do not line up with the hops; the audio thread side never allocates.
+        const size_t host_size = 100;
+        size_t allocations = 0;
+        for (size_t offset = 0; offset < samples.size(); offset += host_size) {
+            const size_t before = njones::test::allocation_count();
+            async.push(samples.data() + offset, std::min(host_size, samples.size() - offset));
+            allocations += njones::test::allocation_count() - before;
+        }
+        TS_ASSERT_EQUALS(allocations, 0u);
+
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while (frames.size() < nhops && std::chrono::steady_clock::now() < deadline) {
+            if (async.poll(drain) == 0)
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        TS_ASSERT_EQUALS(async.get_overruns(), 0u);
+        TS_ASSERT_EQUALS(async.get_dropped_frames(), 0u);
+        TS_ASSERT_EQUALS(discontinuities, 0u);
+        TS_ASSERT_EQUALS(async.get_max_latency(), nhops * hop_size);
+        TS_ASSERT_EQUALS(frames.size(), nhops);
+        for (size_t i = 0; i < frames.size() && i < nhops; ++i) {
+            TS_ASSERT_EQUALS(positions[i], i * hop_size);
+            TS_ASSERT_EQUALS(frames[i].size(), expected[i].size());
+            for (size_t j = 0; j < frames[i].size() && j < expected[i].size(); ++j) {
+                TS_ASSERT_EQUALS(frames[i][j].pitch, expected[i][j].pitch);
+                TS_ASSERT_EQUALS(frames[i][j].velocity, expected[i][j].velocity);
+            }
+        }
+
+        // With a single slot blocks pushed faster than they are analysed overrun, and frames left
+        // waiting for poll() are dropped; every block is accounted for either way.
+        auto bounded = njones::audio::a2m::AsyncConverter(samplerate, block_size, hop_size, 1, 0.1);
+        bounded.push(samples.data(), samples.size());
+        size_t received = 0;
+        const auto accounted = [&]() { return received + bounded.get_overruns() + bounded.get_dropped_frames(); };
+        while (accounted() < nhops && std::chrono::steady_clock::now() < deadline) {
+            received += bounded.poll([](const njones::audio::a2m::AsyncConverter::Frame&) {});
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        TS_ASSERT_EQUALS(accounted(), nhops);
+        TS_ASSERT(bounded.get_overruns() > 0);
+
+        // Hops pushed one at a time from then on are all analysed. A frame is marked while its history
+        // still reaches back across a gap, and the mark clears once block_size contiguous samples follow.
+        auto marks = std::vector<bool>();
+        for (size_t i = 0; i < 2 * block_size / hop_size; ++i) {
+            bounded.push(samples.data() + i * hop_size, hop_size);
+            size_t polled = 0;
+            while (polled == 0 && std::chrono::steady_clock::now() < deadline)
+                polled = bounded.poll([&](const njones::audio::a2m::AsyncConverter::Frame& frame) {
+                    marks.push_back(frame.discontinuous);
+                });
+        }
+        TS_ASSERT_EQUALS(marks.size(), 2 * block_size / hop_size);
+        for (size_t i = 1; i < marks.size(); ++i)
+            TS_ASSERT(marks[i] <= marks[i - 1]);
+        for (size_t i = block_size / hop_size - 1; i < marks.size(); ++i)
+            TS_ASSERT(!marks[i]);
+    }
+
+    void test_convert_blocks_matches_convert() {
+        const unsigned int samplerate = 44100;
+        const unsigned int block_size = 1024;
+        const size_t nblocks = 70;
+        auto samples = std::vector<double>(block_size * nblocks);
+        for (size_t i = 0; i < samples.size(); ++i) {
+            const double freq = 220.0 + 660.0 * i / samples.size();
+            samples[i] =
+                0.5 * sin(2.0 * M_PI * freq * i / samplerate) + 0.2 * sin(2.0 * M_PI * 3 * freq * i / samplerate);
+        }
+
+        // Whole tiles, a partial tile left to convert(), a window, and a hop which bypasses batching.
+        for (const auto window : {njones::audio::a2m::Window::Rectangular, njones::audio::a2m::Window::Hann}) {
+            for (const unsigned int hop_size : {0u, 256u}) {
+                auto single = njones::audio::a2m::Converter(samplerate, block_size, 0.1);
+                auto batched = njones::audio::a2m::Converter(samplerate, block_size, 0.1);
+                for (auto converter : {&single, &batched}) {
+                    converter->set_window(window);
+                    converter->set_hop_size(hop_size);
+                }
+
+                const size_t step = hop_size == 0 ? block_size : hop_size;
+                const size_t count = samples.size() / step;
+                auto expected = njones::audio::a2m::NoteSink();
+                for (size_t block = 0; block < count; ++block)
+                    for (const auto& note : single.convert(samples.data() + block * step))
+                        expected.push_back(njones::audio::a2m::BlockNote{block, note});
+
+                auto sink = njones::audio::a2m::NoteSink{njones::audio::a2m::BlockNote{99, {}}};
+                TS_ASSERT_EQUALS(batched.convert_blocks(samples.data(), count, sink), expected.size());
+                TS_ASSERT_EQUALS(sink.size(), expected.size() + 1);
+                TS_ASSERT(expected.size() > count);
+                for (size_t i = 0; i < expected.size() && i + 1 < sink.size(); ++i) {
+                    TS_ASSERT_EQUALS(sink[i + 1].block, expected[i].block);
+                    TS_ASSERT_EQUALS(sink[i + 1].note.pitch, expected[i].note.pitch);
+                    TS_ASSERT_EQUALS(sink[i + 1].note.velocity, expected[i].note.velocity);
+                }
+                if constexpr (njones::audio::a2m::instrumentation_enabled) {
+                    const auto snapshot = batched.get_instrumentation();
+                    uint64_t histogram_blocks = 0;
+                    for (auto blocks : snapshot.latency_histogram)
+                        histogram_blocks += blocks;
+                    TS_ASSERT_EQUALS(snapshot.blocks, count);
+                    TS_ASSERT_EQUALS(histogram_blocks, count);
+                }
+            }
+        }
+
+        // Silence, a steady tone the stationarity gate repeats, and the sweep, gated block by block in the
+        // batched tiles just as convert() gates them.
+        auto gated = samples;
+        std::fill_n(gated.begin(), 20 * block_size, 0.0);
+        for (size_t i = 20 * block_size; i < 45 * block_size; ++i)
+            gated[i] = 0.5 * sin(2.0 * M_PI * 441.0 * i / samplerate);
+        auto single = njones::audio::a2m::Converter(samplerate, block_size, 0.1);
+        auto batched = njones::audio::a2m::Converter(samplerate, block_size, 0.1);
+        for (auto converter : {&single, &batched}) {
+            converter->set_silence_gate(true);
+            converter->set_stationarity(0.05);
+        }
+
+        auto expected = njones::audio::a2m::NoteSink();
+        for (size_t block = 0; block < nblocks; ++block)
+            for (const auto& note : single.convert(gated.data() + block * block_size))
+                expected.push_back(njones::audio::a2m::BlockNote{block, note});
+
+        auto sink = njones::audio::a2m::NoteSink();
+        TS_ASSERT_EQUALS(batched.convert_blocks(gated.data(), nblocks, sink), expected.size());
+        TS_ASSERT_EQUALS(sink.size(), expected.size());
+        for (size_t i = 0; i < expected.size() && i < sink.size(); ++i) {
+            TS_ASSERT_EQUALS(sink[i].block, expected[i].block);
+            TS_ASSERT_EQUALS(sink[i].note.pitch, expected[i].note.pitch);
+            TS_ASSERT_EQUALS(sink[i].note.velocity, expected[i].note.velocity);
+        }
+
+        const auto counters = single.get_gate_counters();
+        const auto batched_counters = batched.get_gate_counters();
+        TS_ASSERT_EQUALS(batched_counters.blocks, nblocks);
+        TS_ASSERT_EQUALS(batched_counters.silent, counters.silent);
+        TS_ASSERT_EQUALS(batched_counters.stationary, counters.stationary);
+        TS_ASSERT(counters.silent > 0);
+        TS_ASSERT(counters.stationary > 0);
+    }
 };